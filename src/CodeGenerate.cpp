@@ -91,6 +91,8 @@ namespace luna
         GenerateBlock *current_block_;
         // Current function for code generate
         Function *function_;
+        // Bytes of function_ when it is allocated
+        std::size_t bytes_;
         // Index of current function in parent
         int func_index_;
         // Register id generator
@@ -102,7 +104,7 @@ namespace luna
 
         GenerateFunction()
             : parent_(nullptr), current_block_(nullptr),
-              function_(nullptr), func_index_(0),
+              function_(nullptr), bytes_(0), func_index_(0),
               register_id_(0), register_max_(0) { }
     };
 
@@ -165,10 +167,12 @@ namespace luna
 
             // New function is default on GCGen2, so barrier it
             current_function_->function_ = state_->NewFunction();
+            current_function_->bytes_ = current_function_->function_->GetMemorySize();
             CHECK_BARRIER(state_->GetGC(), current_function_->function_);
 
             if (parent)
             {
+                function->function_->SetClosureSite(state_->GetGC().NewAllocSite());
                 auto index = parent->function_->AddChildFunction(function->function_);
                 function->func_index_ = index;
                 function->function_->SetSuperior(parent->function_);
@@ -179,6 +183,8 @@ namespace luna
         // Clean up when leave lexical function
         void LeaveFunction()
         {
+            auto function = current_function_;
+            function->function_->SetRegisterCount(function->register_max_);
             DeleteCurrentFunction();
         }
 
@@ -443,6 +449,8 @@ namespace luna
                 delete block;
             }
 
+            // Report memory of generated code to GC
+            state_->GetGC().ResizeObject(function->function_, function->bytes_);
             current_function_ = function->parent_;
             delete function;
         }
@@ -1506,9 +1514,13 @@ namespace luna
         if (end_register != EXP_VALUE_COUNT_ANY && register_id >= end_register)
             return ;
 
-        // New table
+        // New table, Bx is index of GC allocation site of the table,
+        // Bx has 16 bits, so tables after them share the first site
         auto function = GetCurrentFunction();
-        auto instruction = Instruction::ACode(OpType_NewTable, register_id);
+        int site = 0;
+        if (function->GetTableSiteCount() <= 0xFFFF)
+            site = function->AddTableSite(state_->GetGC().NewAllocSite());
+        auto instruction = Instruction::ABxCode(OpType_NewTable, register_id, site);
         function->AddInstruction(instruction, table->line_);
 
         if (!table->fields_.empty())
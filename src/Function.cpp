@@ -4,8 +4,8 @@
 namespace luna
 {
     Function::Function()
-        : module_(nullptr), line_(0), args_(0),
-          is_vararg_(false), superior_(nullptr)
+        : closure_site_(0), module_(nullptr), line_(0), args_(0),
+          registers_(0), is_vararg_(false), superior_(nullptr)
     {
     }
 
@@ -32,6 +32,18 @@ namespace luna
         }
     }
 
+    std::size_t Function::GetMemorySize() const
+    {
+        return sizeof(Function) +
+            opcodes_.capacity() * sizeof(Instruction) +
+            opcode_lines_.capacity() * sizeof(int) +
+            const_values_.capacity() * sizeof(Value) +
+            local_vars_.capacity() * sizeof(LocalVarInfo) +
+            child_funcs_.capacity() * sizeof(Function *) +
+            upvalues_.capacity() * sizeof(UpvalueInfo) +
+            table_sites_.capacity() * sizeof(unsigned int);
+    }
+
     const Instruction * Function::GetOpCodes() const
     {
         return opcodes_.empty() ? nullptr : &opcodes_[0];
@@ -74,6 +86,16 @@ namespace luna
         return args_;
     }
 
+    void Function::SetRegisterCount(int count)
+    {
+        registers_ = count;
+    }
+
+    int Function::GetRegisterCount() const
+    {
+        return registers_;
+    }
+
     void Function::SetModuleName(String *module)
     {
         module_ = module;
@@ -146,6 +168,19 @@ namespace luna
         return child_funcs_[index];
     }
 
+    int Function::AddTableSite(unsigned int site)
+    {
+        table_sites_.push_back(site);
+        return table_sites_.size() - 1;
+    }
+
+    unsigned int Function::GetTableSite(int index) const
+    {
+        if (index < 0 || static_cast<std::size_t>(index) >= table_sites_.size())
+            return 0;
+        return table_sites_[index];
+    }
+
     String * Function::SearchLocalVar(int register_id, int pc) const
     {
         String *name = nullptr;
@@ -195,6 +230,11 @@ namespace luna
         }
     }
 
+    std::size_t Closure::GetMemorySize() const
+    {
+        return sizeof(Closure) + upvalues_.capacity() * sizeof(Upvalue *);
+    }
+
     Function * Closure::GetPrototype() const
     {
         return prototype_;
@@ -15,6 +15,7 @@ namespace luna
     // parse.
     class Function : public GCObject
     {
+        friend class ObjectScanner;
     public:
         struct UpvalueInfo
         {
@@ -41,6 +42,8 @@ namespace luna
 
         virtual void Accept(GCObjectVisitor *v);
 
+        virtual std::size_t GetMemorySize() const;
+
         // Get function instructions and size
         const Instruction * GetOpCodes() const;
         std::size_t OpCodeSize() const;
@@ -59,6 +62,10 @@ namespace luna
         void AddFixedArgCount(int count);
         int FixedArgCount() const;
 
+        // Set and get max count of registers used by function
+        void SetRegisterCount(int count);
+        int GetRegisterCount() const;
+
         // Set module and function define start line
         void SetModuleName(String *module);
         void SetLine(int line);
@@ -91,6 +98,23 @@ namespace luna
         // Get child function by index
         Function * GetChildFunction(int index) const;
 
+        // Add allocation site of NewTable instruction, return index of
+        // the site, which is Bx of the instruction
+        int AddTableSite(unsigned int site);
+
+        // Get allocation site of NewTable instruction by index, return 0
+        // when the site is not existed
+        unsigned int GetTableSite(int index) const;
+
+        std::size_t GetTableSiteCount() const
+        { return table_sites_.size(); }
+
+        // Set and get allocation site of closures of this function
+        void SetClosureSite(unsigned int site)
+        { closure_site_ = site; }
+        unsigned int GetClosureSite() const
+        { return closure_site_; }
+
         // Search local variable name from local variable list
         String * SearchLocalVar(int register_id, int pc) const;
 
@@ -147,12 +171,18 @@ namespace luna
         std::vector<Function *> child_funcs_;
         // upvalues
         std::vector<UpvalueInfo> upvalues_;
+        // GC allocation sites of NewTable instructions
+        std::vector<unsigned int> table_sites_;
+        // GC allocation site of closures of this function
+        unsigned int closure_site_;
         // function define module name
         String *module_;
         // function define line at module
         int line_;
         // count of args
         int args_;
+        // max count of registers
+        int registers_;
         // has '...' param or not
         bool is_vararg_;
         // superior function pointer
@@ -163,11 +193,14 @@ namespace luna
     // prototype Function object and its upvalues.
     class Closure : public GCObject
     {
+        friend class ObjectScanner;
     public:
         Closure();
 
         virtual void Accept(GCObjectVisitor *v);
 
+        virtual std::size_t GetMemorySize() const;
+
         // Get and set closure prototype Function
         Function * GetPrototype() const;
         void SetPrototype(Function *prototype);
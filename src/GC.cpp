@@ -5,11 +5,17 @@
 #include "String.h"
 #include <assert.h>
 #include <time.h>
+#include <condition_variable>
+#include <deque>
+#include <new>
+#include <mutex>
+#include <thread>
 
 namespace luna
 {
     GCObject::GCObject()
-        : next_(nullptr), generation_(GCGen0), gc_(0), gc_obj_type_(0)
+        : next_(nullptr), generation_(GCGen0), gc_(0), gc_obj_type_(0),
+          remembered_(0), alloc_site_(0), sweep_epoch_(0), mark_(0)
     {
     }
 
@@ -17,7 +23,252 @@ namespace luna
     {
     }
 
-    class MinorMarkVisitor : public GCObjectVisitor
+namespace
+{
+    // Call destructor of object of 'type' without freeing its memory
+    void DestroyObject(GCObject *obj, unsigned int type)
+    {
+        switch (type)
+        {
+            case GCObjectType_Table:
+                static_cast<Table *>(obj)->~Table();
+                break;
+            case GCObjectType_Function:
+                static_cast<Function *>(obj)->~Function();
+                break;
+            case GCObjectType_Closure:
+                static_cast<Closure *>(obj)->~Closure();
+                break;
+            case GCObjectType_Upvalue:
+                static_cast<Upvalue *>(obj)->~Upvalue();
+                break;
+            case GCObjectType_String:
+                static_cast<String *>(obj)->~String();
+                break;
+            default:
+                assert(!"unknown GC object type");
+                break;
+        }
+    }
+} // namespace
+
+    // Destroys dead objects on a helper thread. Deleters are called and
+    // memory is freed by the GC thread, since they touch StringPool and
+    // slabs, so the helper thread only runs destructors, which free
+    // members of objects like arrays and hash tables of tables.
+    class BackgroundSweeper
+    {
+    public:
+        struct Block
+        {
+            GCObject *obj_;
+            unsigned int type_;
+            std::size_t size_;
+        };
+
+        BackgroundSweeper()
+            : stop_(false), thread_(&BackgroundSweeper::Run, this) { }
+
+        ~BackgroundSweeper()
+        {
+            Stop();
+        }
+
+        // Destroy object on helper thread, objects are handed over in
+        // batches
+        void Destroy(GCObject *obj, unsigned int type, std::size_t size)
+        {
+            Block block = { obj, type, size };
+            batch_.push_back(block);
+            if (batch_.size() >= kBatchSize)
+                Flush();
+        }
+
+        // Hand over objects of current batch
+        void Flush()
+        {
+            if (batch_.empty())
+                return ;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back(std::move(batch_));
+            batch_.clear();
+            cond_.notify_one();
+        }
+
+        // Take memory of destroyed objects
+        void TakeDestroyed(std::vector<Block> *blocks)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            blocks->swap(destroyed_);
+            destroyed_.clear();
+        }
+
+        // Destroy all objects handed over and stop helper thread
+        void Stop()
+        {
+            if (!thread_.joinable())
+                return ;
+
+            Flush();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+                cond_.notify_one();
+            }
+            thread_.join();
+        }
+
+    private:
+        static const std::size_t kBatchSize = 256;
+
+        void Run()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true)
+            {
+                cond_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+                if (pending_.empty())
+                    return ;
+
+                auto batch = std::move(pending_.front());
+                pending_.pop_front();
+
+                lock.unlock();
+                for (auto &block : batch)
+                    DestroyObject(block.obj_, block.type_);
+                lock.lock();
+
+                destroyed_.insert(destroyed_.end(), batch.begin(), batch.end());
+            }
+        }
+
+        std::vector<Block> batch_;
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::deque<std::vector<Block>> pending_;
+        std::vector<Block> destroyed_;
+        bool stop_;
+        std::thread thread_;
+    };
+
+    // Scanner of members of GC objects. It switches on type of object
+    // and marks members by Marker::MarkObject directly, so scanning an
+    // object makes no virtual calls. Members are the same as members
+    // visited by Accept of each type. Weak tables are not scanned, since
+    // their weak references are visited by Table::Accept.
+    class ObjectScanner
+    {
+    public:
+        // Return false when 'obj' is not scanned
+        template<typename Marker>
+        static bool Scan(GCObject *obj, Marker *m)
+        {
+            switch (obj->gc_obj_type_)
+            {
+                case GCObjectType_Table:
+                    return ScanTable(static_cast<Table *>(obj), m);
+                case GCObjectType_Function:
+                    ScanFunction(static_cast<Function *>(obj), m);
+                    return true;
+                case GCObjectType_Closure:
+                    ScanClosure(static_cast<Closure *>(obj), m);
+                    return true;
+                case GCObjectType_Upvalue:
+                    MarkValue(static_cast<Upvalue *>(obj)->value_, m);
+                    return true;
+                default:
+                    return true;
+            }
+        }
+
+    private:
+        template<typename Marker>
+        static void MarkValue(const Value &value, Marker *m)
+        {
+            switch (value.type_)
+            {
+                case ValueT_Obj: m->MarkObject(value.obj_); break;
+                case ValueT_String: m->MarkObject(value.str_); break;
+                case ValueT_Closure: m->MarkObject(value.closure_); break;
+                case ValueT_Upvalue: m->MarkObject(value.upvalue_); break;
+                case ValueT_Table: m->MarkObject(value.table_); break;
+                default: break;
+            }
+        }
+
+        template<typename Marker>
+        static bool ScanTable(Table *t, Marker *m)
+        {
+            if (t->weak_mode_ != WeakMode_None)
+                return false;
+
+            if (t->metatable_)
+                m->MarkObject(t->metatable_);
+
+            if (t->array_)
+            {
+                for (const auto &value : *t->array_)
+                    MarkValue(value, m);
+            }
+
+            if (t->hash_)
+            {
+                for (const auto &pair : *t->hash_)
+                {
+                    MarkValue(pair.first, m);
+                    MarkValue(pair.second, m);
+                }
+            }
+
+            if (t->frozen_hash_)
+            {
+                for (const auto &slot : t->frozen_hash_->slots_)
+                {
+                    MarkValue(slot.first, m);
+                    MarkValue(slot.second, m);
+                }
+            }
+            return true;
+        }
+
+        template<typename Marker>
+        static void ScanFunction(Function *f, Marker *m)
+        {
+            if (f->module_)
+                m->MarkObject(f->module_);
+            if (f->superior_)
+                m->MarkObject(f->superior_);
+
+            for (const auto &value : f->const_values_)
+                MarkValue(value, m);
+
+            for (const auto &var : f->local_vars_)
+                m->MarkObject(var.name_);
+
+            for (auto child : f->child_funcs_)
+                m->MarkObject(child);
+
+            for (const auto &upvalue : f->upvalues_)
+                m->MarkObject(upvalue.name_);
+        }
+
+        template<typename Marker>
+        static void ScanClosure(Closure *c, Marker *m)
+        {
+            m->MarkObject(c->prototype_);
+
+            for (auto upvalue : c->upvalues_)
+                m->MarkObject(upvalue);
+        }
+    };
+
+    // Base of markers which push marked objects to gray stack instead
+    // of visiting their members recursively, so deep object graphs
+    // never overflow C++ stack, members are scanned by Drain. Markers
+    // differ in mark mode, which is checked by MarkObject instead of
+    // virtual calls.
+    class GrayStackVisitor : public GCObjectVisitor
     {
     public:
         virtual bool Visit(Table *t) { return VisitObj(t); }
@@ -26,69 +277,420 @@ namespace luna
         virtual bool Visit(Upvalue *u) { return VisitObj(u); }
         virtual bool Visit(String *s) { return VisitObj(s); }
 
+        virtual void VisitWeakTable(Table *t) { weak_tables_->push_back(t); }
+
+        // Scan members of gray objects until gray stack is empty
+        void Drain()
+        {
+            while (!gray_->empty())
+            {
+                GCObject *obj = gray_->back();
+                gray_->pop_back();
+                if (!ObjectScanner::Scan(obj, this))
+                {
+                    scanning_ = obj;
+                    obj->Accept(this);
+                }
+            }
+        }
+
+        // Mark 'obj' and push it to gray stack when its members need
+        // to be visited, strings have no members, so they are not pushed
+        void MarkObject(GCObject *obj)
+        {
+            bool members = obj->gc_obj_type_ != GCObjectType_String;
+            switch (mode_)
+            {
+                case MarkMode_Minor:
+                    if (obj->generation_ == GCGen0 && obj->gc_ == GCFlag_White)
+                    {
+                        obj->gc_ = GCFlag_Black;
+                        if (members)
+                            gray_->push_back(obj);
+                    }
+                    break;
+                case MarkMode_Barriered:
+                    // Visit member GC objects of obj when it is
+                    // barriered object
+                    if (obj->generation_ != GCGen0 && obj->gc_ == GCFlag_Black)
+                    {
+                        obj->gc_ = GCFlag_White;
+                        if (members)
+                            gray_->push_back(obj);
+                    }
+                    else if (obj->generation_ == GCGen0 &&
+                             obj->gc_ == GCFlag_White)
+                    {
+                        obj->gc_ = GCFlag_Black;
+                        if (members)
+                            gray_->push_back(obj);
+                    }
+                    break;
+                case MarkMode_Major:
+                    if (obj->gc_ == GCFlag_White)
+                    {
+                        obj->gc_ = GCFlag_Black;
+                        if (members)
+                            gray_->push_back(obj);
+                    }
+                    break;
+            }
+        }
+
+    protected:
+        enum MarkMode
+        {
+            MarkMode_Minor,         // Mark GCGen0 objects
+            MarkMode_Barriered,     // Mark members of barriered objects
+            MarkMode_Major,         // Mark objects of all generations
+        };
+
+        GrayStackVisitor(MarkMode mode, std::vector<GCObject *> *gray,
+                         std::vector<Table *> *weak_tables)
+            : mode_(mode), gray_(gray), weak_tables_(weak_tables),
+              scanning_(nullptr) { }
+
     private:
         bool VisitObj(GCObject *obj)
         {
-            if (obj->generation_ == GCGen0 && obj->gc_ == GCFlag_White)
+            // Object is being scanned by Accept in Drain, its members
+            // are visited
+            if (obj == scanning_)
             {
-                obj->gc_ = GCFlag_Black;
+                scanning_ = nullptr;
                 return true;
             }
+
+            MarkObject(obj);
             return false;
         }
+
+        MarkMode mode_;
+        std::vector<GCObject *> *gray_;
+        std::vector<Table *> *weak_tables_;
+        GCObject *scanning_;
+    };
+
+    class MinorMarkVisitor : public GrayStackVisitor
+    {
+    public:
+        MinorMarkVisitor(std::vector<GCObject *> *gray,
+                         std::vector<Table *> *weak_tables)
+            : GrayStackVisitor(MarkMode_Minor, gray, weak_tables) { }
+
+        // Objects of older generations are alive in minor GC
+        virtual bool IsMarked(GCObject *obj)
+        {
+            return obj->generation_ != GCGen0 || obj->gc_ == GCFlag_Black;
+        }
+    };
+
+    class BarrieredMarkVisitor : public GrayStackVisitor
+    {
+    public:
+        BarrieredMarkVisitor(std::vector<GCObject *> *gray,
+                             std::vector<Table *> *weak_tables)
+            : GrayStackVisitor(MarkMode_Barriered, gray, weak_tables) { }
+
+        virtual bool IsMarked(GCObject *obj)
+        {
+            return obj->generation_ != GCGen0 || obj->gc_ == GCFlag_Black;
+        }
     };
 
-    class BarrieredMarkVisitor : public GCObjectVisitor
+    class MajorMarkVisitor : public GrayStackVisitor
     {
     public:
+        MajorMarkVisitor(std::vector<GCObject *> *gray,
+                         std::vector<Table *> *weak_tables)
+            : GrayStackVisitor(MarkMode_Major, gray, weak_tables) { }
+
+        virtual bool IsMarked(GCObject *obj)
+        {
+            return obj->gc_ == GCFlag_Black;
+        }
+    };
+
+    // Marker of incremental major GC, visited objects are grayed and
+    // pushed to gray stack, members of gray objects are visited by Scan
+    class IncrementalMarkVisitor : public GCObjectVisitor
+    {
+    public:
+        IncrementalMarkVisitor(std::vector<GCObject *> *gray,
+                               std::vector<Table *> *weak_tables)
+            : gray_(gray), weak_tables_(weak_tables),
+              scanning_(nullptr), work_(0), remark_upvalues_(false) { }
+
         virtual bool Visit(Table *t) { return VisitObj(t); }
         virtual bool Visit(Function *f) { return VisitObj(f); }
         virtual bool Visit(Closure *c) { return VisitObj(c); }
         virtual bool Visit(Upvalue *u) { return VisitObj(u); }
         virtual bool Visit(String *s) { return VisitObj(s); }
 
-    private:
-        bool VisitObj(GCObject *obj)
+        virtual void VisitWeakTable(Table *t) { weak_tables_->push_back(t); }
+
+        virtual bool IsMarked(GCObject *obj)
         {
-            // Visit member GC objects of obj when it is barriered object
-            if (obj->generation_ != GCGen0 && obj->gc_ == GCFlag_Black)
+            return obj->gc_ != GCFlag_White;
+        }
+
+        // Visit members of gray object 'obj', and make it black
+        void Scan(GCObject *obj)
+        {
+            ++work_;
+            obj->gc_ = GCFlag_Black;
+            if (!ObjectScanner::Scan(obj, this))
             {
-                obj->gc_ = GCFlag_White;
-                return true;
+                scanning_ = obj;
+                obj->Accept(this);
+            }
+        }
+
+        // Gray white object 'obj', strings have no members, so they are
+        // black directly
+        void MarkObject(GCObject *obj)
+        {
+            ++work_;
+            if (obj->gc_ == GCFlag_White)
+            {
+                if (obj->gc_obj_type_ == GCObjectType_String)
+                {
+                    obj->gc_ = GCFlag_Black;
+                }
+                else
+                {
+                    obj->gc_ = GCFlag_Gray;
+                    gray_->push_back(obj);
+                }
             }
+            else if (remark_upvalues_ && obj->gc_ == GCFlag_Black &&
+                     obj->gc_obj_type_ == GCObjectType_Upvalue)
+            {
+                // Values of open upvalues are changed through registers
+                // without barrier, so mark them again
+                obj->gc_ = GCFlag_Gray;
+                gray_->push_back(obj);
+            }
+        }
+
+        void SetRemarkUpvalues(bool remark)
+        {
+            remark_upvalues_ = remark;
+        }
+
+        // Count of visited references
+        unsigned int GetWork() const
+        {
+            return work_;
+        }
 
-            // Visit GCGen0 generation object
-            if (obj->generation_ == GCGen0 && obj->gc_ == GCFlag_White)
+    private:
+        bool VisitObj(GCObject *obj)
+        {
+            // Object is being scanned by Accept in Scan
+            if (obj == scanning_)
             {
-                obj->gc_ = GCFlag_Black;
+                scanning_ = nullptr;
                 return true;
             }
+
+            MarkObject(obj);
             return false;
         }
+
+        std::vector<GCObject *> *gray_;
+        std::vector<Table *> *weak_tables_;
+        GCObject *scanning_;
+        unsigned int work_;
+        bool remark_upvalues_;
     };
 
-    class MajorMarkVisitor : public GCObjectVisitor
+    // Worker of parallel mark. Objects are claimed by setting their mark
+    // epoch atomically, claimed objects are pushed to the local gray
+    // stack, and part of it is published to the shared queue when other
+    // workers are idle, idle workers steal objects from shared queues.
+    class ParallelMarker : public GCObjectVisitor
     {
     public:
+        typedef std::vector<std::unique_ptr<ParallelMarker>> Markers;
+
+        ParallelMarker(Markers *markers, std::atomic<std::size_t> *idle,
+                       unsigned char epoch)
+            : markers_(markers), idle_(idle), epoch_(epoch),
+              scanning_(nullptr), shared_size_(0) { }
+
         virtual bool Visit(Table *t) { return VisitObj(t); }
         virtual bool Visit(Function *f) { return VisitObj(f); }
         virtual bool Visit(Closure *c) { return VisitObj(c); }
         virtual bool Visit(Upvalue *u) { return VisitObj(u); }
         virtual bool Visit(String *s) { return VisitObj(s); }
 
+        virtual void VisitWeakTable(Table *t) { weak_tables_.push_back(t); }
+
+        // Publish all objects of local gray stack for stealing
+        void PublishAll()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shared_.insert(shared_.end(), local_.begin(), local_.end());
+            shared_size_.store(shared_.size(), std::memory_order_relaxed);
+            local_.clear();
+        }
+
+        // Mark objects until all workers have no gray objects
+        void Run()
+        {
+            GCObject *obj = nullptr;
+            while (true)
+            {
+                while (Pop(&obj))
+                {
+                    Scan(obj);
+                    if (local_.size() >= kPublishSize &&
+                        idle_->load(std::memory_order_relaxed) > 0)
+                        Publish();
+                }
+
+                if (Steal())
+                    continue;
+
+                // Gray objects only exist in shared queues or local
+                // stacks of busy workers, mark is finished when all
+                // workers are idle
+                idle_->fetch_add(1);
+                while (true)
+                {
+                    if (idle_->load() == markers_->size())
+                        return ;
+                    if (HasSharedObjects())
+                    {
+                        idle_->fetch_sub(1);
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        const std::vector<Table *>& GetWeakTables() const
+        { return weak_tables_; }
+
+        // Claim 'obj' and push it to local gray stack, strings have no
+        // members, so they are not pushed
+        void MarkObject(GCObject *obj)
+        {
+            if (Claim(obj) && obj->gc_obj_type_ != GCObjectType_String)
+                local_.push_back(obj);
+        }
+
     private:
+        // Local gray stack size which could be published
+        static const std::size_t kPublishSize = 64;
+
         bool VisitObj(GCObject *obj)
         {
-            if (obj->gc_ == GCFlag_White)
+            if (obj == scanning_)
             {
-                obj->gc_ = GCFlag_Black;
+                scanning_ = nullptr;
                 return true;
             }
-            else
+
+            MarkObject(obj);
+            return false;
+        }
+
+        // Only one worker claims an object in current mark epoch
+        bool Claim(GCObject *obj)
+        {
+            unsigned char mark = obj->mark_.load(std::memory_order_relaxed);
+            if (mark == epoch_ ||
+                !obj->mark_.compare_exchange_strong(mark, epoch_,
+                                                    std::memory_order_relaxed))
+                return false;
+
+            obj->gc_ = GCFlag_Black;
+            return true;
+        }
+
+        void Scan(GCObject *obj)
+        {
+            if (!ObjectScanner::Scan(obj, this))
             {
+                scanning_ = obj;
+                obj->Accept(this);
+            }
+        }
+
+        bool Pop(GCObject **obj)
+        {
+            if (local_.empty() && !TakeShared(this, &local_))
                 return false;
+
+            *obj = local_.back();
+            local_.pop_back();
+            return true;
+        }
+
+        // Publish half of local gray stack when shared queue is empty
+        void Publish()
+        {
+            if (shared_size_.load(std::memory_order_relaxed) != 0)
+                return ;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto half = local_.begin() + local_.size() / 2;
+            shared_.insert(shared_.end(), local_.begin(), half);
+            shared_size_.store(shared_.size(), std::memory_order_relaxed);
+            local_.erase(local_.begin(), half);
+        }
+
+        bool Steal()
+        {
+            for (auto &marker : *markers_)
+            {
+                if (marker.get() != this && TakeShared(marker.get(), &local_))
+                    return true;
             }
+            return false;
         }
+
+        // Take half of shared objects of 'from' to 'to'
+        static bool TakeShared(ParallelMarker *from, std::vector<GCObject *> *to)
+        {
+            if (from->shared_size_.load(std::memory_order_relaxed) == 0)
+                return false;
+
+            std::lock_guard<std::mutex> lock(from->mutex_);
+            auto &shared = from->shared_;
+            if (shared.empty())
+                return false;
+
+            auto count = (shared.size() + 1) / 2;
+            to->insert(to->end(), shared.begin(), shared.begin() + count);
+            shared.erase(shared.begin(), shared.begin() + count);
+            from->shared_size_.store(shared.size(), std::memory_order_relaxed);
+            return true;
+        }
+
+        bool HasSharedObjects() const
+        {
+            for (auto &marker : *markers_)
+            {
+                if (marker->shared_size_.load(std::memory_order_relaxed) != 0)
+                    return true;
+            }
+            return false;
+        }
+
+        Markers *markers_;
+        std::atomic<std::size_t> *idle_;
+        unsigned char epoch_;
+        GCObject *scanning_;
+        std::vector<GCObject *> local_;
+        std::vector<Table *> weak_tables_;
+
+        std::mutex mutex_;
+        std::deque<GCObject *> shared_;
+        std::atomic<std::size_t> shared_size_;
     };
 
 #define GC_LOG(log)                             \
@@ -101,10 +703,27 @@ namespace luna
     } while (0)
 
     GC::GC(const GCObjectDeleter &obj_deleter, bool log)
-        : obj_deleter_(obj_deleter)
+        : table_slab_(sizeof(Table)),
+          function_slab_(sizeof(Function)),
+          closure_slab_(sizeof(Closure)),
+          upvalue_slab_(sizeof(Upvalue)),
+          growth_factor_(kDefaultGrowthFactor), stopped_(false),
+          grown_bytes_(0),
+          incremental_(true), major_state_(MajorState_Pause),
+          step_work_(kDefaultStepWork), step_microseconds_(0),
+          sweep_mode_(SweepMode_Lazy), sweep_index_(3), sweep_major_(false),
+          sweep_promoted_bytes_(0), sweep_gen0_count_(0), sweep_bytes_(0),
+          sweep_rate_(0.0), young_epoch_(0), old_epoch_(0),
+          mark_threads_(1), mark_epoch_(0),
+          alloc_sites_(1), pretenuring_(true), obj_deleter_(obj_deleter)
     {
-        gen0_.threshold_count_ = kGen0InitThresholdCount;
-        gen1_.threshold_count_ = kGen1InitThresholdCount;
+        sweep_lists_[0] = sweep_lists_[1] = sweep_lists_[2] = nullptr;
+        for (auto size = kStringSizeStep; size <= kMaxSlabStringSize;
+             size += kStringSizeStep)
+            string_slabs_.emplace_back(new SlabAllocator(size));
+
+        gen0_.threshold_bytes_ = kGen0MinThresholdBytes;
+        gen1_.threshold_bytes_ = kGen1MinThresholdBytes;
 
         if (log)
         {
@@ -114,6 +733,18 @@ namespace luna
 
     GC::~GC()
     {
+        StopBackgroundSweeper();
+
+        for (auto &list : sweep_lists_)
+        {
+            while (list)
+            {
+                GCObject *obj = list;
+                list = list->next_;
+                DeleteObject(obj);
+            }
+        }
+
         DestroyGeneration(gen0_);
         DestroyGeneration(gen1_);
         DestroyGeneration(gen2_);
@@ -125,41 +756,55 @@ namespace luna
         major_traveller_ = major;
     }
 
-    Table * GC::NewTable(GCGeneration gen)
+    Table * GC::NewTable(GCGeneration gen, unsigned int site)
     {
-        auto t = new Table;
+        auto t = new (table_slab_.Alloc()) Table(this);
         t->gc_obj_type_ = GCObjectType_Table;
+        t->alloc_site_ = site;
         SetObjectGen(t, gen);
         return t;
     }
 
     Function * GC::NewFunction(GCGeneration gen)
     {
-        auto f = new Function;
+        auto f = new (function_slab_.Alloc()) Function;
         f->gc_obj_type_ = GCObjectType_Function;
         SetObjectGen(f, gen);
         return f;
     }
 
-    Closure * GC::NewClosure(GCGeneration gen)
+    Closure * GC::NewClosure(GCGeneration gen, unsigned int site)
     {
-        auto c = new Closure;
+        auto c = new (closure_slab_.Alloc()) Closure;
         c->gc_obj_type_ = GCObjectType_Closure;
+        c->alloc_site_ = site;
         SetObjectGen(c, gen);
         return c;
     }
 
     Upvalue * GC::NewUpvalue(GCGeneration gen)
     {
-        auto u = new Upvalue;
+        auto u = new (upvalue_slab_.Alloc()) Upvalue;
         u->gc_obj_type_ = GCObjectType_Upvalue;
         SetObjectGen(u, gen);
         return u;
     }
 
-    String * GC::NewString(GCGeneration gen)
+    String * GC::NewString(const char *str, std::size_t len,
+                           std::size_t hash, GCGeneration gen)
+    {
+        auto mem = AllocString(String::GetAllocSize(len));
+        auto s = String::Create(mem, str, len, hash);
+        s->gc_obj_type_ = GCObjectType_String;
+        SetObjectGen(s, gen);
+        return s;
+    }
+
+    String * GC::NewLongString(const char *str, std::size_t len,
+                               std::size_t seed, GCGeneration gen)
     {
-        auto s = new String;
+        auto mem = AllocString(String::GetAllocSize(len));
+        auto s = String::CreateLazyHash(mem, str, len, seed);
         s->gc_obj_type_ = GCObjectType_String;
         SetObjectGen(s, gen);
         return s;
@@ -167,106 +812,174 @@ namespace luna
 
     void GC::SetBarrier(GCObject *obj)
     {
-        assert(obj->generation_ != GCGen0);
-        barriered_.push_back(obj);
+        // Black object refers to white object after store, make it
+        // gray to visit its members again in atomic mark, so stores
+        // never make incremental mark longer
+        if (major_state_ == MajorState_Mark && obj->gc_ == GCFlag_Black)
+        {
+            obj->gc_ = GCFlag_Gray;
+            gray_again_.push_back(obj);
+            return ;
+        }
+
+        // Black GCGen0 objects are moved to GCGen1 by sweeping of
+        // incremental major GC, they are barriered for next minor GC
+        assert(obj->generation_ != GCGen0 || obj->gc_ == GCFlag_Black);
+        if (!obj->remembered_)
+        {
+            obj->remembered_ = 1;
+            barriered_.push_back(obj);
+        }
+    }
+
+    void GC::ResizeObject(GCObject *obj, std::size_t old_bytes)
+    {
+        auto bytes = obj->GetMemorySize();
+        if (bytes == old_bytes)
+            return ;
+
+        // Objects left in sweep lists are counted by sweep_bytes_
+        bool pending = IsSweeping() &&
+            obj->sweep_epoch_ != GetSweepEpoch(obj->generation_);
+        std::size_t &counter = pending ?
+            sweep_bytes_ : GetGenInfo(obj->generation_).bytes_;
+        assert(old_bytes <= counter);
+        counter = counter - old_bytes + bytes;
+        if (bytes < old_bytes)
+            return ;
+
+        // Growth sweeps and runs GC as allocation of new objects
+        auto grown = bytes - old_bytes;
+        if (&counter != &gen0_.bytes_)
+            grown_bytes_ += grown;
+        if (IsSweeping() && sweep_mode_ != SweepMode_Eager)
+            LazySweep(grown);
     }
 
     void GC::CheckGC()
     {
-        if (gen0_.count_ >= gen0_.threshold_count_)
-        {
-            unsigned int gen0_count = gen0_.count_;
-            unsigned int gen0_threshold = gen0_.threshold_count_;
-            unsigned int gen1_count = gen1_.count_;
-            unsigned int gen1_threshold = gen1_.threshold_count_;
-            unsigned int gen2_count = gen2_.count_;
-            unsigned int gen2_threshold = gen2_.threshold_count_;
+        if (!stopped_ && gen0_.bytes_ + grown_bytes_ >= gen0_.threshold_bytes_)
+            Step();
+    }
 
-            const char *gc_name = "";
-            clock_t start = clock();
-            if (gen1_.count_ >= gen1_.threshold_count_)
-            {
-                gc_name = "major";
-                MajorGC();
-            }
-            else
-            {
-                gc_name = "minor";
-                MinorGC();
-            }
+    bool GC::Step()
+    {
+        std::size_t gen0_bytes = gen0_.bytes_;
+        std::size_t gen0_threshold = gen0_.threshold_bytes_;
+        std::size_t gen1_bytes = gen1_.bytes_;
+        std::size_t gen1_threshold = gen1_.threshold_bytes_;
+        std::size_t gen2_bytes = gen2_.bytes_;
 
-            clock_t duration = clock() - start;
-            unsigned int microseconds = duration * 1000000 / CLOCKS_PER_SEC;
-            GC_LOG(gc_name << "[" << microseconds << " microseconds]: " <<
-                   gen0_count << " " << gen0_threshold << " | " <<
-                   gen1_count << " " << gen1_threshold << " | " <<
-                   gen2_count << " " << gen2_threshold << " - " <<
-                   gen0_.count_ << " " << gen0_.threshold_count_ << " | " <<
-                   gen1_.count_ << " " << gen1_.threshold_count_ << " | " <<
-                   gen2_.count_ << " " << gen2_.threshold_count_);
+        const char *gc_name = "";
+        clock_t start = clock();
+        grown_bytes_ = 0;
+        ReclaimObjects();
+
+        // Sweeping of last GC is finished before next GC, unless
+        // it is swept by steps of incremental major GC
+        if (IsSweeping() && major_state_ != MajorState_Sweep)
+            SweepAll();
+
+        if (major_state_ == MajorState_Mark)
+        {
+            gc_name = "major mark step";
+            MajorGCStep(step_work_, step_microseconds_);
+        }
+        else if (major_state_ == MajorState_Sweep)
+        {
+            gc_name = "major sweep step";
+            MajorGCStep(step_work_, step_microseconds_);
+        }
+        else if (gen1_.bytes_ >= gen1_.threshold_bytes_ && incremental_)
+        {
+            gc_name = "major start";
+            StartMajorGC();
         }
+        else if (gen1_.bytes_ >= gen1_.threshold_bytes_)
+        {
+            gc_name = "major";
+            MajorGC();
+        }
+        else
+        {
+            gc_name = "minor";
+            MinorGC();
+        }
+
+        clock_t duration = clock() - start;
+        unsigned int microseconds = duration * 1000000 / CLOCKS_PER_SEC;
+        GC_LOG(gc_name << "[" << microseconds << " microseconds]: " <<
+               gen0_bytes << " " << gen0_threshold << " | " <<
+               gen1_bytes << " " << gen1_threshold << " | " <<
+               gen2_bytes << " - " <<
+               gen0_.bytes_ << " " << gen0_.threshold_bytes_ << " | " <<
+               gen1_.bytes_ << " " << gen1_.threshold_bytes_ << " | " <<
+               gen2_.bytes_ << " bytes");
+        return major_state_ == MajorState_Pause;
     }
 
     void GC::SetObjectGen(GCObject *obj, GCGeneration gen)
     {
-        GenInfo *gen_info = nullptr;
+        GenInfo &gen_info = GetGenInfo(gen);
+
+        // Sweep objects of last GC on each allocation
+        auto bytes = obj->GetMemorySize();
+        if (IsSweeping() && sweep_mode_ != SweepMode_Eager)
+            LazySweep(bytes);
+
+        obj->generation_ = gen;
+        obj->sweep_epoch_ = GetSweepEpoch(gen);
+        obj->next_ = gen_info.gen_;
+        gen_info.gen_ = obj;
+        gen_info.count_++;
+        gen_info.bytes_ += bytes;
+    }
 
+    GC::GenInfo & GC::GetGenInfo(unsigned int gen)
+    {
         switch (gen)
         {
             case GCGen0:
-                gen_info = &gen0_;
-                break;
+                return gen0_;
             case GCGen1:
-                gen_info = &gen1_;
-                break;
-            case GCGen2:
-                gen_info = &gen2_;
-                break;
+                return gen1_;
+            default:
+                assert(gen == GCGen2);
+                return gen2_;
         }
-
-        assert(gen_info);
-
-        obj->generation_ = gen;
-        obj->next_ = gen_info->gen_;
-        gen_info->gen_ = obj;
-        gen_info->count_++;
     }
 
     void GC::MinorGC()
     {
-        unsigned int old_gen1_count = gen1_.count_;
-
+        assert(!IsSweeping());
         MinorGCMark();
-        MinorGCSweep();
-
-        barriered_.clear();
-
-        // Caculate objects count from gen0_ to gen1_, which is how
-        // many alived objects in gen0_ after mark-sweep, and adjust
-        // gen0_'s threshold count by the alived_gen0_count
-        unsigned int alived_gen0_count = gen1_.count_ - old_gen1_count;
-        AdjustThreshold(alived_gen0_count, gen0_, kGen0InitThresholdCount,
-                        kGen0MaxThresholdCount);
+        StartSweep(false);
+        if (sweep_mode_ == SweepMode_Eager)
+            SweepAll();
     }
 
     void GC::MajorGC()
     {
+        assert(!IsSweeping());
         MajorGCMark();
-        MajorGCSweep();
-
-        barriered_.clear();
+        StartSweep(true);
+        if (sweep_mode_ == SweepMode_Eager)
+            SweepAll();
     }
 
     void GC::MinorGCMark()
     {
         assert(minor_traveller_);
 
+        assert(gray_.empty());
+
         // Visit all minor GC root objects
-        MinorMarkVisitor marker;
+        MinorMarkVisitor marker(&gray_, &weak_tables_);
         minor_traveller_(&marker);
+        marker.Drain();
 
         // Visit all barriered GC objects
-        BarrieredMarkVisitor barriered_maker;
+        BarrieredMarkVisitor barriered_maker(&gray_, &weak_tables_);
         for (auto obj : barriered_)
         {
             // All barriered objects must be GCGen1 or GCGen2.
@@ -276,119 +989,473 @@ namespace luna
             // member GC objects of barriered objects.
             obj->gc_ = GCFlag_Black;
             obj->Accept(&barriered_maker);
+            barriered_maker.Drain();
         }
+
+        MarkEphemerons(&marker);
+        ClearWeakTables(&marker);
     }
 
-    void GC::MinorGCSweep()
+    void GC::MajorGCMark()
     {
-        // Sweep GCGen0
-        while (gen0_.gen_)
+        assert(major_traveller_);
+
+        assert(gray_.empty());
+
+        // Visit all major GC root objects
+        MajorMarkVisitor marker(&gray_, &weak_tables_);
+        if (mark_threads_ > 1)
         {
-            GCObject *obj = gen0_.gen_;
-            gen0_.gen_ = gen0_.gen_->next_;
+            ParallelMark();
+        }
+        else
+        {
+            major_traveller_(&marker);
+            marker.Drain();
+        }
 
-            // Move object to GCGen1 generation when object is black
-            if (obj->gc_ == GCFlag_Black)
-            {
-                obj->gc_ = GCFlag_White;
-                obj->generation_ = GCGen1;
-                obj->next_ = gen1_.gen_;
-                gen1_.gen_ = obj;
-                gen1_.count_++;
-            }
-            else
-            {
-                obj_deleter_(obj, obj->gc_obj_type_);
-            }
+        MarkEphemerons(&marker);
+        ClearWeakTables(&marker);
+    }
+
+    void GC::ParallelMark()
+    {
+        if (++mark_epoch_ == 0)
+        {
+            ResetMarkEpochs();
+            mark_epoch_ = 1;
         }
 
-        gen0_.count_ = 0;
+        std::atomic<std::size_t> idle(0);
+        ParallelMarker::Markers markers;
+        for (unsigned int i = 0; i < mark_threads_; ++i)
+            markers.emplace_back(new ParallelMarker(&markers, &idle, mark_epoch_));
+
+        // Roots are claimed by this thread and stolen by others
+        major_traveller_(markers[0].get());
+        markers[0]->PublishAll();
+
+        std::vector<std::thread> threads;
+        for (unsigned int i = 1; i < mark_threads_; ++i)
+            threads.emplace_back(&ParallelMarker::Run, markers[i].get());
+        markers[0]->Run();
+        for (auto &thread : threads)
+            thread.join();
+
+        for (auto &marker : markers)
+        {
+            auto &weak_tables = marker->GetWeakTables();
+            weak_tables_.insert(weak_tables_.end(),
+                                weak_tables.begin(), weak_tables.end());
+        }
     }
 
-    void GC::MajorGCMark()
+    void GC::ResetMarkEpochs()
+    {
+        GenInfo *gens[3] = { &gen0_, &gen1_, &gen2_ };
+        for (auto gen : gens)
+        {
+            for (auto obj = gen->gen_; obj; obj = obj->next_)
+                obj->mark_.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void GC::FullGC()
+    {
+        FinishMajorGC();
+        if (IsSweeping())
+            SweepAll();
+        MajorGC();
+        if (IsSweeping())
+            SweepAll();
+        ReclaimObjects();
+        GC_LOG("full: " << gen0_.count_ << " | " << gen1_.count_ <<
+               " | " << gen2_.count_ << " - " << GetTotalBytes() << " bytes");
+    }
+
+    void GC::KeepAlive(String *str)
+    {
+        if (IsSweeping() && str->gc_ == GCFlag_White &&
+            str->sweep_epoch_ != GetSweepEpoch(str->generation_))
+            str->gc_ = GCFlag_Black;
+    }
+
+    void GC::SetSweepMode(SweepMode mode)
+    {
+        sweep_mode_ = mode;
+        if (sweep_mode_ == SweepMode_Background && !sweeper_)
+            sweeper_.reset(new BackgroundSweeper);
+        else if (sweep_mode_ != SweepMode_Background)
+            StopBackgroundSweeper();
+
+        if (sweep_mode_ == SweepMode_Eager && IsSweeping() &&
+            major_state_ != MajorState_Sweep)
+            SweepAll();
+    }
+
+    void GC::SetIncremental(bool incremental)
     {
+        incremental_ = incremental;
+        if (!incremental_)
+            FinishMajorGC();
+    }
+
+    void GC::SetStepBudget(unsigned int work, unsigned int microseconds)
+    {
+        step_work_ = work > 0 ? work : 1;
+        step_microseconds_ = microseconds;
+    }
+
+    void GC::StartMajorGC()
+    {
+        assert(major_state_ == MajorState_Pause);
         assert(major_traveller_);
+        assert(gray_.empty());
 
-        // Visit all major GC root objects
-        MajorMarkVisitor marker;
+        // Gray all roots, members are visited by steps
+        IncrementalMarkVisitor marker(&gray_, &weak_tables_);
         major_traveller_(&marker);
+        major_state_ = MajorState_Mark;
+
+        // Allocate objects before next step
+        gen0_.threshold_bytes_ = gen0_.bytes_ + kStepAllocBytes;
+    }
+
+    void GC::MajorGCStep(unsigned int work, unsigned int microseconds)
+    {
+        clock_t deadline = 0;
+        if (microseconds != 0)
+            deadline = clock() + static_cast<clock_t>(
+                static_cast<double>(microseconds) * CLOCKS_PER_SEC / 1000000);
+
+        if (major_state_ == MajorState_Mark)
+        {
+            if (MarkStep(work, deadline))
+            {
+                AtomicMark();
+                StartSweep(true);
+                major_state_ = MajorState_Sweep;
+            }
+        }
+        else if (major_state_ == MajorState_Sweep)
+        {
+            if (SweepStep(work, deadline))
+                FinishSweep();
+        }
+
+        if (major_state_ != MajorState_Pause)
+            gen0_.threshold_bytes_ = gen0_.bytes_ + kStepAllocBytes;
     }
 
-    void GC::MajorGCSweep()
+    void GC::FinishMajorGC()
     {
-        // Sweep all generations
-        SweepGeneration(gen2_);
-        SweepGeneration(gen1_);
-        SweepGeneration(gen0_);
+        while (major_state_ != MajorState_Pause)
+            MajorGCStep(~0u, 0);
+    }
 
-        // Move all GCGen0 objects to GCGen1
-        while (gen0_.gen_)
+    bool GC::MarkStep(unsigned int work, clock_t deadline)
+    {
+        // Work of marking is count of visited references
+        IncrementalMarkVisitor marker(&gray_, &weak_tables_);
+        for (unsigned int i = 0; marker.GetWork() < work && !gray_.empty(); ++i)
         {
-            GCObject *obj = gen0_.gen_;
-            gen0_.gen_ = gen0_.gen_->next_;
+            // Check time every 64 objects
+            if (deadline != 0 && (i & 63) == 63 && clock() >= deadline)
+                break;
 
-            obj->generation_ = GCGen1;
-            obj->next_ = gen1_.gen_;
-            gen1_.gen_ = obj;
+            GCObject *obj = gray_.back();
+            gray_.pop_back();
+            marker.Scan(obj);
         }
 
-        // Adjust GCGen0 threshold count
-        AdjustThreshold(gen0_.count_, gen0_, kGen0InitThresholdCount,
-                        kGen0MaxThresholdCount);
+        return gray_.empty();
+    }
 
-        gen1_.count_ += gen0_.count_;
-        gen0_.count_ = 0;
+    void GC::AtomicMark()
+    {
+        // Roots are changed without barrier, mark them again
+        IncrementalMarkVisitor marker(&gray_, &weak_tables_);
+        marker.SetRemarkUpvalues(true);
+        major_traveller_(&marker);
+        marker.SetRemarkUpvalues(false);
+
+        gray_.insert(gray_.end(), gray_again_.begin(), gray_again_.end());
+        gray_again_.clear();
+
+        // Mark all gray objects and values of ephemerons until no
+        // more objects are marked
+        bool visited = true;
+        while (visited)
+        {
+            MarkStep(~0u, 0);
+
+            visited = false;
+            for (std::size_t i = 0; i < weak_tables_.size(); ++i)
+            {
+                if (weak_tables_[i]->VisitEphemeron(&marker))
+                    visited = true;
+            }
+        }
+
+        ClearWeakTables(&marker);
+    }
 
-        // Adjust GCGen1 threshold count
-        AdjustThreshold(gen1_.count_, gen1_, kGen1InitThresholdCount,
-                        kGen1MaxThresholdCount);
-        if (gen1_.count_ >= kGen1MaxThresholdCount)
+    void GC::StartSweep(bool major)
+    {
+        // All objects are swept from these lists, new objects are
+        // added to generations, and never swept in this GC
+        sweep_lists_[0] = major ? gen2_.gen_ : nullptr;
+        sweep_lists_[1] = major ? gen1_.gen_ : nullptr;
+        sweep_lists_[2] = gen0_.gen_;
+        if (major)
         {
-            gen1_.threshold_count_ = gen1_.count_ + kGen1MaxThresholdCount;
+            gen2_.gen_ = nullptr;
+            gen1_.gen_ = nullptr;
         }
+        gen0_.gen_ = nullptr;
+        sweep_index_ = 0;
+        sweep_major_ = major;
+        sweep_promoted_bytes_ = 0;
+
+        // Objects in sweep lists are from the last epoch now
+        young_epoch_ ^= 1;
+        if (major)
+            old_epoch_ ^= 1;
+
+        // GCGen0 objects in sweep list are not counted by gen0_, so
+        // new objects trigger next GC by their own bytes. Bytes of
+        // swept generations are counted again by sweeping.
+        unsigned int count = gen0_.count_;
+        sweep_gen0_count_ = gen0_.count_;
+        sweep_bytes_ = gen0_.bytes_;
+        gen0_.count_ = 0;
+        gen0_.bytes_ = 0;
+        if (major)
+        {
+            count += gen1_.count_ + gen2_.count_;
+            sweep_bytes_ += gen1_.bytes_ + gen2_.bytes_;
+            gen1_.bytes_ = 0;
+            gen2_.bytes_ = 0;
+        }
+
+        // Sweep enough objects for allocated bytes to finish sweeping
+        // before next GC
+        sweep_rate_ = 2.0 * count / gen0_.threshold_bytes_;
+
+        // Objects stored after this GC are barriered again
+        for (auto obj : barriered_)
+            obj->remembered_ = 0;
+        barriered_.clear();
     }
 
-    void GC::SweepGeneration(GenInfo &gen)
+    bool GC::SweepStep(unsigned int work, clock_t deadline)
     {
-        GCObject *alived = nullptr;
+        GenInfo *gens[3] = { &gen2_, &gen1_, &gen0_ };
 
-        while (gen.gen_)
+        unsigned int i = 0;
+        while (sweep_index_ < 3 && i < work)
         {
-            GCObject *obj = gen.gen_;
-            gen.gen_ = obj->next_;
+            GCObject *&list = sweep_lists_[sweep_index_];
+            if (!list)
+            {
+                ++sweep_index_;
+                continue;
+            }
+
+            if (deadline != 0 && (i & 63) == 63 && clock() >= deadline)
+                break;
+            ++i;
+
+            GCObject *obj = list;
+            list = obj->next_;
+            GenInfo &from = *gens[sweep_index_];
+
+            bool gen0 = &from == &gen0_;
+            if (gen0)
+                sweep_gen0_count_--;
+
+            auto bytes = obj->GetMemorySize();
+            assert(bytes <= sweep_bytes_);
+            sweep_bytes_ -= bytes;
+
+            if (gen0 && obj->alloc_site_ != 0)
+            {
+                auto &site = alloc_sites_[obj->alloc_site_];
+                if (obj->gc_ == GCFlag_Black)
+                    ++site.survived_;
+                else
+                    ++site.died_;
+            }
 
             if (obj->gc_ == GCFlag_Black)
             {
+                // Alived GCGen0 objects are moved to GCGen1
+                GenInfo &to = gen0 ? gen1_ : from;
+                if (gen0)
+                {
+                    obj->generation_ = GCGen1;
+                    to.count_++;
+                    sweep_promoted_bytes_ += bytes;
+                }
+
                 obj->gc_ = GCFlag_White;
-                obj->next_ = alived;
-                alived = obj;
+                obj->sweep_epoch_ = old_epoch_;
+                obj->next_ = to.gen_;
+                to.gen_ = obj;
+                to.bytes_ += bytes;
             }
             else
             {
-                obj_deleter_(obj, obj->gc_obj_type_);
-                gen.count_--;
+                DeleteObject(obj);
+                if (!gen0)
+                    from.count_--;
             }
         }
 
-        gen.gen_ = alived;
+        return sweep_index_ == 3;
+    }
+
+    void GC::FinishSweep()
+    {
+        if (sweeper_)
+            sweeper_->Flush();
+
+        sweep_bytes_ = 0;
+        UpdateAllocSites();
+
+        // Adjust GCGen0 threshold by bytes of alived GCGen0 objects
+        AdjustThreshold(sweep_promoted_bytes_, gen0_, kGen0MinThresholdBytes,
+                        kGen0MaxThresholdBytes);
+        if (!sweep_major_)
+            return ;
+
+        major_state_ = MajorState_Pause;
+
+        // Adjust GCGen1 threshold by bytes of alived GCGen1 objects
+        AdjustThreshold(gen1_.bytes_, gen1_, kGen1MinThresholdBytes,
+                        ~static_cast<std::size_t>(0));
     }
 
-    void GC::AdjustThreshold(unsigned int alived_count, GenInfo &gen,
-                             unsigned int min_threshold,
-                             unsigned int max_threshold)
+    void GC::SweepAll()
     {
-        if (alived_count != 0)
+        while (!SweepStep(~0u, 0))
+            ;
+        FinishSweep();
+    }
+
+    void GC::LazySweep(std::size_t bytes)
+    {
+        auto work = static_cast<unsigned int>(bytes * sweep_rate_);
+        if (work < kMinSweepChunk)
+            work = kMinSweepChunk;
+        if (SweepStep(work, 0))
+            FinishSweep();
+    }
+
+    void GC::MarkEphemerons(GrayStackVisitor *v)
+    {
+        // Visiting values may mark keys of other ephemeron tables, and
+        // new weak tables may be appended, so repeat until nothing changed
+        bool visited = true;
+        while (visited)
         {
-            while (gen.threshold_count_ < 2 * alived_count)
-                gen.threshold_count_ *= 2;
-            while (gen.threshold_count_ >= 4 * alived_count)
-                gen.threshold_count_ /= 2;
+            visited = false;
+            for (std::size_t i = 0; i < weak_tables_.size(); ++i)
+            {
+                if (weak_tables_[i]->VisitEphemeron(v))
+                {
+                    v->Drain();
+                    visited = true;
+                }
+            }
+        }
+    }
+
+    void GC::ClearWeakTables(GCObjectVisitor *v)
+    {
+        for (auto t : weak_tables_)
+            t->ClearWeakEntries(v);
+        weak_tables_.clear();
+    }
+
+    void GC::AdjustThreshold(std::size_t alived_bytes, GenInfo &gen,
+                             std::size_t min_threshold,
+                             std::size_t max_threshold)
+    {
+        auto threshold = alived_bytes / 100 * growth_factor_;
+        if (threshold < min_threshold)
+            threshold = min_threshold;
+        else if (threshold > max_threshold)
+            threshold = max_threshold;
+        gen.threshold_bytes_ = threshold;
+    }
+
+    unsigned int GC::NewAllocSite()
+    {
+        if (!free_alloc_sites_.empty())
+        {
+            auto site = free_alloc_sites_.back();
+            free_alloc_sites_.pop_back();
+            alloc_sites_[site] = AllocSite();
+            return site;
         }
 
-        if (gen.threshold_count_ < min_threshold)
-            gen.threshold_count_ = min_threshold;
-        else if (gen.threshold_count_ > max_threshold)
-            gen.threshold_count_ = max_threshold;
+        if (alloc_sites_.size() >= kMaxAllocSites)
+            return 0;
+        alloc_sites_.push_back(AllocSite());
+        return alloc_sites_.size() - 1;
+    }
+
+    void GC::FreeAllocSite(unsigned int site)
+    {
+        // Objects of the site may be alive, they are counted by the
+        // site which reuses it
+        if (site != 0)
+        {
+            alloc_sites_[site].pretenured_ = false;
+            free_alloc_sites_.push_back(site);
+        }
+    }
+
+    void GC::SetPretenuring(bool enable)
+    {
+        pretenuring_ = enable;
+        if (!enable)
+        {
+            for (auto &site : alloc_sites_)
+                site.pretenured_ = false;
+        }
+    }
+
+    void GC::UpdateAllocSites()
+    {
+        if (!pretenuring_)
+            return ;
+
+        for (std::size_t i = 1; i < alloc_sites_.size(); ++i)
+        {
+            auto &site = alloc_sites_[i];
+            std::size_t total = site.survived_ + site.died_;
+            if (total < kSiteMinSamples)
+                continue;
+
+            std::size_t rate = site.survived_ * 100 / total;
+            if (!site.pretenured_ && rate >= kPretenureSurvivalRate)
+            {
+                site.pretenured_ = true;
+                GC_LOG("pretenure site " << i << ": " << site.survived_ <<
+                       " of " << total << " survived");
+            }
+            else if (site.pretenured_ && rate < kTenureSurvivalRate)
+            {
+                site.pretenured_ = false;
+                GC_LOG("stop pretenuring site " << i << ": " <<
+                       site.survived_ << " of " << total << " survived");
+            }
+
+            site.survived_ = 0;
+            site.died_ = 0;
+        }
     }
 
     void GC::DestroyGeneration(GenInfo &gen)
@@ -397,8 +1464,99 @@ namespace luna
         {
             GCObject *obj = gen.gen_;
             gen.gen_ = gen.gen_->next_;
-            obj_deleter_(obj, obj->gc_obj_type_);
+            DeleteObject(obj);
         }
         gen.count_ = 0;
+        gen.bytes_ = 0;
+    }
+
+    void GC::DeleteObject(GCObject *obj)
+    {
+        unsigned int type = obj->gc_obj_type_;
+        obj_deleter_(obj, type);
+
+        // Allocation sites of deleted function are reused
+        if (type == GCObjectType_Function)
+        {
+            auto f = static_cast<Function *>(obj);
+            for (std::size_t i = 0; i < f->GetTableSiteCount(); ++i)
+                FreeAllocSite(f->GetTableSite(i));
+            FreeAllocSite(f->GetClosureSite());
+        }
+
+        std::size_t size = 0;
+        if (type == GCObjectType_String)
+            size = String::GetAllocSize(static_cast<String *>(obj)->GetLength());
+
+        if (sweeper_)
+        {
+            sweeper_->Destroy(obj, type, size);
+        }
+        else
+        {
+            DestroyObject(obj, type);
+            FreeObject(obj, type, size);
+        }
+    }
+
+    void GC::FreeObject(void *p, unsigned int type, std::size_t size)
+    {
+        switch (type)
+        {
+            case GCObjectType_Table:
+                table_slab_.Free(p);
+                break;
+            case GCObjectType_Function:
+                function_slab_.Free(p);
+                break;
+            case GCObjectType_Closure:
+                closure_slab_.Free(p);
+                break;
+            case GCObjectType_Upvalue:
+                upvalue_slab_.Free(p);
+                break;
+            case GCObjectType_String:
+                FreeString(p, size);
+                break;
+            default:
+                assert(!"unknown GC object type");
+                break;
+        }
+    }
+
+    void GC::ReclaimObjects()
+    {
+        if (!sweeper_)
+            return ;
+
+        std::vector<BackgroundSweeper::Block> blocks;
+        sweeper_->TakeDestroyed(&blocks);
+        for (auto &block : blocks)
+            FreeObject(block.obj_, block.type_, block.size_);
+    }
+
+    void GC::StopBackgroundSweeper()
+    {
+        if (!sweeper_)
+            return ;
+
+        sweeper_->Stop();
+        ReclaimObjects();
+        sweeper_.reset();
+    }
+
+    void * GC::AllocString(std::size_t size)
+    {
+        if (size > kMaxSlabStringSize)
+            return ::operator new(size);
+        return string_slabs_[(size - 1) / kStringSizeStep]->Alloc();
+    }
+
+    void GC::FreeString(void *p, std::size_t size)
+    {
+        if (size > kMaxSlabStringSize)
+            ::operator delete(p);
+        else
+            string_slabs_[(size - 1) / kStringSizeStep]->Free(p);
     }
 } // namespace luna
@@ -1,9 +1,13 @@
 #ifndef GC_OBJECT_H
 #define GC_OBJECT_H
 
+#include "SlabAllocator.h"
+#include <atomic>
 #include <functional>
-#include <deque>
+#include <vector>
 #include <fstream>
+#include <memory>
+#include <time.h>
 
 namespace luna
 {
@@ -20,6 +24,7 @@ namespace luna
     {
         GCFlag_White,
         GCFlag_Black,
+        GCFlag_Gray,        // Marked but members are not visited
     };
 
     // GC object type allocated by GC
@@ -32,6 +37,9 @@ namespace luna
         GCObjectType_String,
     };
 
+    class GCObject;
+    class BackgroundSweeper;
+    class GrayStackVisitor;
     class Table;
     class Function;
     class Closure;
@@ -48,6 +56,14 @@ namespace luna
         virtual bool Visit(Closure *) = 0;
         virtual bool Visit(Upvalue *) = 0;
         virtual bool Visit(String *) = 0;
+
+        // Visitor visits weak table, weak references of the table
+        // are not visited
+        virtual void VisitWeakTable(Table *) { }
+
+        // Return true when object is marked by visitor, weak tables
+        // remove references which are not marked after mark stage
+        virtual bool IsMarked(GCObject *) { return true; }
     };
 
     // Base class of GC objects, GC use this class to manipulate
@@ -55,9 +71,13 @@ namespace luna
     class GCObject
     {
         friend class GC;
+        friend class ObjectScanner;
+        friend class GrayStackVisitor;
         friend class MinorMarkVisitor;
         friend class BarrieredMarkVisitor;
         friend class MajorMarkVisitor;
+        friend class IncrementalMarkVisitor;
+        friend class ParallelMarker;
         friend bool CheckBarrier(GCObject *);
     public:
         GCObject();
@@ -65,6 +85,9 @@ namespace luna
 
         virtual void Accept(GCObjectVisitor *) = 0;
 
+        // Bytes allocated by object, including memory of its members
+        virtual std::size_t GetMemorySize() const = 0;
+
     private:
         // Pointing next GCObject in current generation
         GCObject *next_;
@@ -74,10 +97,26 @@ namespace luna
         unsigned int gc_ : 2;
         // GC object type
         unsigned int gc_obj_type_ : 4;
+        // Object is in barriered list of GC until next sweep
+        unsigned int remembered_ : 1;
+        // Allocation site of object, 0 is unknown site
+        unsigned int alloc_site_ : 22;
+        // Object is not left in sweep lists when it equals the sweep
+        // epoch of its generation
+        unsigned int sweep_epoch_ : 1;
+        // Mark epoch of parallel mark, objects are claimed by workers
+        // through it, and gc_ is only changed by the claiming worker
+        std::atomic<unsigned char> mark_;
     };
 
-    // GC object barrier checker
-    inline bool CheckBarrier(GCObject *obj) { return obj->generation_ != GCGen0; }
+    // GC object barrier checker, barrier is needed by old objects for
+    // minor GC, and by black objects for incremental major GC, old
+    // objects are remembered once until next sweep
+    inline bool CheckBarrier(GCObject *obj)
+    {
+        return (obj->generation_ != GCGen0 && !obj->remembered_) ||
+            obj->gc_ == GCFlag_Black;
+    }
     #define CHECK_BARRIER(gc, obj) \
         do { if (luna::CheckBarrier(obj)) gc.SetBarrier(obj); } while (0)
 
@@ -85,12 +124,13 @@ namespace luna
     {
     public:
         typedef std::function<void (GCObjectVisitor *)> RootTravelType;
+        // Deleter is called before GC destroys the object and returns
+        // its memory to slab
         typedef std::function<void (GCObject *, unsigned int)> GCObjectDeleter;
 
         struct DefaultDeleter
         {
-            inline void operator () (GCObject *obj, unsigned int) const
-            { delete obj; }
+            inline void operator () (GCObject *, unsigned int) const { }
         };
 
         explicit GC(const GCObjectDeleter &obj_deleter = DefaultDeleter(), bool log = false);
@@ -102,58 +142,289 @@ namespace luna
         // Set minor and major root travel functions
         void SetRootTraveller(const RootTravelType &minor, const RootTravelType &major);
 
-        // Alloc GC objects
-        Table * NewTable(GCGeneration gen = GCGen0);
+        // Alloc GC objects, tables and closures record their
+        // allocation sites
+        Table * NewTable(GCGeneration gen = GCGen0, unsigned int site = 0);
         Function * NewFunction(GCGeneration gen = GCGen2);
-        Closure * NewClosure(GCGeneration gen = GCGen0);
+        Closure * NewClosure(GCGeneration gen = GCGen0, unsigned int site = 0);
         Upvalue * NewUpvalue(GCGeneration gen = GCGen0);
-        String * NewString(GCGeneration gen = GCGen0);
+        String * NewString(const char *str, std::size_t len,
+                           std::size_t hash, GCGeneration gen = GCGen0);
+        // New string whose hash is computed with 'seed' on demand
+        String * NewLongString(const char *str, std::size_t len,
+                               std::size_t seed, GCGeneration gen = GCGen0);
 
         // Set GC object barrier
         void SetBarrier(GCObject *obj);
 
-        // Check run GC
+        // Memory of 'obj' changed from 'old_bytes' to its current size.
+        // Objects which grow or shrink after allocation report it, and
+        // growth counts as allocation for running GC.
+        void ResizeObject(GCObject *obj, std::size_t old_bytes);
+
+        // Keep string which is found by weak reference alive, when it
+        // is not marked and still left in sweep lists. Strings which
+        // are swept already or allocated after sweep started stay white.
+        void KeepAlive(String *str);
+
+        // Check run GC, GC does not run when it is stopped
         void CheckGC();
 
+        // Bytes of allocation which run next GC step in current state,
+        // each Step does the GC work of that much allocation
+        std::size_t GetStepBytes() const
+        {
+            return major_state_ != MajorState_Pause ?
+                kStepAllocBytes : gen0_.threshold_bytes_;
+        }
+
+        // Run a GC step as if allocated bytes reached the threshold,
+        // even if GC is stopped. Returns true when the step finished a
+        // minor GC or a major GC.
+        bool Step();
+
+        // Stop or restart running GC by CheckGC, objects are still
+        // collected by Step and FullGC explicitly
+        void SetStopped(bool stopped)
+        { stopped_ = stopped; }
+        bool IsStopped() const
+        { return stopped_; }
+
+        // Run major GC in steps interleaved with allocation or not,
+        // current incremental major GC is finished when disabled
+        void SetIncremental(bool incremental);
+        bool IsIncremental() const
+        { return incremental_; }
+
+        // Each step of incremental major GC visits about 'work'
+        // references when marking or 'work' objects when sweeping,
+        // and stops after 'microseconds' when it is not 0
+        void SetStepBudget(unsigned int work, unsigned int microseconds = 0);
+
+        // Incremental major GC is running or not
+        bool IsMajorGCRunning() const
+        { return major_state_ != MajorState_Pause; }
+
+        // Modes of sweeping dead objects after marking
+        enum SweepMode
+        {
+            SweepMode_Eager,        // Sweep all objects in GC pause
+            SweepMode_Lazy,         // Sweep a chunk of objects on each allocation
+            SweepMode_Background,   // Sweep lazily, and destroy dead objects
+                                    // on a helper thread
+        };
+
+        void SetSweepMode(SweepMode mode);
+        SweepMode GetSweepMode() const
+        { return sweep_mode_; }
+
+        // Objects of last GC are being swept or not
+        bool IsSweeping() const
+        { return sweep_index_ < 3; }
+
+        // Threads of marking in major GC which is not incremental,
+        // objects are marked by one thread when 'threads' <= 1
+        void SetMarkThreads(unsigned int threads)
+        { mark_threads_ = threads > 0 ? threads : 1; }
+        unsigned int GetMarkThreads() const
+        { return mark_threads_; }
+
+        // Finish current incremental major GC and run a full major GC
+        void FullGC();
+
+        // Count of GC objects in all generations
+        std::size_t GetObjectCount() const
+        {
+            return gen0_.count_ + gen1_.count_ + gen2_.count_ +
+                sweep_gen0_count_;
+        }
+
+        // Bytes of GC objects in all generations, objects which are not
+        // swept yet are counted until they are swept
+        std::size_t GetTotalBytes() const
+        { return gen0_.bytes_ + gen1_.bytes_ + gen2_.bytes_ + sweep_bytes_; }
+
+        // Major GC runs when bytes of GCGen1 grow to 'percent' percent
+        // of its bytes after last major GC, and GCGen0 threshold is
+        // 'percent' percent of bytes of GCGen0 objects survived last GC
+        void SetGrowthFactor(unsigned int percent)
+        { growth_factor_ = percent > 100 ? percent : 100; }
+        unsigned int GetGrowthFactor() const
+        { return growth_factor_; }
+
+        // Allocation sites count how many GCGen0 objects allocated at
+        // them survive minor GC. Objects of sites which mostly survive
+        // are pretenured, they are allocated in GCGen1 directly. Some
+        // objects of pretenured sites are still allocated in GCGen0 to
+        // keep counting, the site is not pretenured any more when they
+        // mostly die. New site returns 0 when sites are used up.
+        unsigned int NewAllocSite();
+        void FreeAllocSite(unsigned int site);
+
+        // Get generation of next object allocated at 'site'
+        GCGeneration GetAllocSiteGen(unsigned int site)
+        {
+            if (site == 0 || !alloc_sites_[site].pretenured_)
+                return GCGen0;
+            return ++alloc_sites_[site].allocated_ % kSiteSampleInterval == 0 ?
+                GCGen0 : GCGen1;
+        }
+
+        bool IsPretenured(unsigned int site) const
+        { return site != 0 && alloc_sites_[site].pretenured_; }
+
+        // Enable or disable pretenuring, all sites are not pretenured
+        // when it is disabled
+        void SetPretenuring(bool enable);
+        bool IsPretenuring() const
+        { return pretenuring_; }
+
     private:
+        // States of incremental major GC
+        enum MajorState
+        {
+            MajorState_Pause,
+            MajorState_Mark,
+            MajorState_Sweep,
+        };
+
+        // Survival statistics of allocation site since last decision
+        struct AllocSite
+        {
+            unsigned int survived_;
+            unsigned int died_;
+            // Count of objects allocated when site is pretenured
+            unsigned int allocated_;
+            bool pretenured_;
+
+            AllocSite()
+                : survived_(0), died_(0), allocated_(0), pretenured_(false) { }
+        };
+
         struct GenInfo
         {
             // Pointing to GC object list
             GCObject *gen_;
             // Count of GC objects
             unsigned int count_;
-            // Current threshold count of GC objects
-            unsigned int threshold_count_;
-
-            GenInfo() : gen_(nullptr), count_(0), threshold_count_(0) { }
+            // Bytes of GC objects, sizes of objects are measured when
+            // they are allocated, resized and swept
+            std::size_t bytes_;
+            // GC runs when bytes_ reach threshold
+            std::size_t threshold_bytes_;
+
+            GenInfo()
+                : gen_(nullptr), count_(0), bytes_(0), threshold_bytes_(0) { }
         };
 
         void SetObjectGen(GCObject *obj, GCGeneration gen);
+        GenInfo & GetGenInfo(unsigned int gen);
 
         // Run minor and major GC
         void MinorGC();
         void MajorGC();
 
         void MinorGCMark();
-        void MinorGCSweep();
-
         void MajorGCMark();
-        void MajorGCSweep();
-
-        void SweepGeneration(GenInfo &gen);
 
-        // Adjust GenInfo's threshold_count_ by alived_count
-        void AdjustThreshold(unsigned int alived_count, GenInfo &gen,
-                             unsigned int min_threshold,
-                             unsigned int max_threshold);
+        // Mark objects from major roots by mark_threads_ workers
+        void ParallelMark();
+        // Reset mark epochs of all objects when epoch wraps around
+        void ResetMarkEpochs();
+
+        // Incremental major GC, start marks roots, then each step
+        // marks or sweeps objects in budget
+        void StartMajorGC();
+        void MajorGCStep(unsigned int work, unsigned int microseconds);
+        void FinishMajorGC();
+
+        // Mark gray objects in budget, return true when no gray
+        // objects left
+        bool MarkStep(unsigned int work, clock_t deadline);
+        // Mark roots again and all objects in one step
+        void AtomicMark();
+
+        // Sweep GCGen0 after minor GC, or all generations after major
+        // GC, black GCGen0 objects are moved to GCGen1
+        void StartSweep(bool major);
+        // Sweep objects in budget, return true when sweep finished
+        bool SweepStep(unsigned int work, clock_t deadline);
+        void FinishSweep();
+        // Sweep all objects left
+        void SweepAll();
+        // Sweep objects in proportion to 'bytes' allocated
+        void LazySweep(std::size_t bytes);
+        // Sweep epoch of objects in generation 'gen'
+        unsigned int GetSweepEpoch(unsigned int gen) const
+        { return gen == GCGen0 ? young_epoch_ : old_epoch_; }
+
+        // Visit values of weak keys tables until no more value of
+        // alived key could be visited
+        void MarkEphemerons(GrayStackVisitor *v);
+
+        // Remove not marked keys and values from weak tables
+        void ClearWeakTables(GCObjectVisitor *v);
+
+        // Set threshold_bytes_ of GenInfo to alived_bytes grown by
+        // growth factor, in range of min_threshold and max_threshold
+        void AdjustThreshold(std::size_t alived_bytes, GenInfo &gen,
+                             std::size_t min_threshold,
+                             std::size_t max_threshold);
+
+        // Pretenure sites or stop pretenuring them by their survival
+        // rates after sweeping
+        void UpdateAllocSites();
 
         // Delete generation all objects
         void DestroyGeneration(GenInfo &gen);
 
-        static const unsigned int kGen0InitThresholdCount = 512;
-        static const unsigned int kGen1InitThresholdCount = 512;
-        static const unsigned int kGen0MaxThresholdCount = 2048;
-        static const unsigned int kGen1MaxThresholdCount = 102400;
+        // Call deleter, destroy object and free its memory, object is
+        // destroyed by background sweeper when it is running
+        void DeleteObject(GCObject *obj);
+        // Free memory of destroyed object of 'type'
+        void FreeObject(void *p, unsigned int type, std::size_t size);
+        // Free memory of objects destroyed by background sweeper
+        void ReclaimObjects();
+        void StopBackgroundSweeper();
+
+        // Alloc and free memory of string of 'size' bytes
+        void * AllocString(std::size_t size);
+        void FreeString(void *p, std::size_t size);
+
+        static const std::size_t kGen0MinThresholdBytes = 64 * 1024;
+        static const std::size_t kGen0MaxThresholdBytes = 256 * 1024;
+        static const std::size_t kGen1MinThresholdBytes = 64 * 1024;
+        static const unsigned int kDefaultGrowthFactor = 200;
+
+        // Strings are allocated from slabs of size classes by step of
+        // kStringSizeStep bytes, larger strings are allocated by new
+        static const std::size_t kStringSizeStep = 16;
+        static const std::size_t kMaxSlabStringSize = 256;
+
+        // Default budget of incremental major GC step
+        static const unsigned int kDefaultStepWork = 4096;
+        // Bytes allocated between incremental major GC steps
+        static const std::size_t kStepAllocBytes = 64 * 1024;
+        // Minimum objects swept on each allocation
+        static const unsigned int kMinSweepChunk = 4;
+
+        // Count of allocation sites which fit GCObject::alloc_site_
+        static const unsigned int kMaxAllocSites = 1 << 22;
+        // Swept GCGen0 objects of site before deciding its generation
+        static const unsigned int kSiteMinSamples = 64;
+        // Percent of survived objects to pretenure site, and to stop
+        // pretenuring it
+        static const unsigned int kPretenureSurvivalRate = 90;
+        static const unsigned int kTenureSurvivalRate = 50;
+        // One of objects of pretenured site is allocated in GCGen0
+        static const unsigned int kSiteSampleInterval = 16;
+
+        // Slabs of GC objects, slabs are destroyed after all objects
+        SlabAllocator table_slab_;
+        SlabAllocator function_slab_;
+        SlabAllocator closure_slab_;
+        SlabAllocator upvalue_slab_;
+        std::vector<std::unique_ptr<SlabAllocator>> string_slabs_;
 
         // Youngest generation
         GenInfo gen0_;
@@ -167,8 +438,63 @@ namespace luna
         // Major root traveller
         RootTravelType major_traveller_;
 
-        // Barriered GC objects
-        std::deque<GCObject *> barriered_;
+        // Barriered GC objects, each object is in it at most once
+        std::vector<GCObject *> barriered_;
+
+        // Weak tables visited in mark stage
+        std::vector<Table *> weak_tables_;
+
+        // Percent of growth of bytes before next GC
+        unsigned int growth_factor_;
+        // CheckGC does not run GC when it is true
+        bool stopped_;
+        // Growth of objects out of GCGen0 since last step, it runs GC
+        // with bytes of GCGen0
+        std::size_t grown_bytes_;
+
+        // Incremental major GC
+        bool incremental_;
+        MajorState major_state_;
+        unsigned int step_work_;
+        unsigned int step_microseconds_;
+        // Gray objects of marking, minor and major GC drain it in one
+        // pause, and incremental major GC drains it by steps, it is
+        // reused across collections
+        std::vector<GCObject *> gray_;
+        // Objects grayed by barrier, they are marked in atomic mark
+        std::vector<GCObject *> gray_again_;
+
+        // Sweep
+        SweepMode sweep_mode_;
+        // Lists of GCGen2, GCGen1 and GCGen0 objects to be swept
+        GCObject *sweep_lists_[3];
+        // Index of list in sweep_lists_ which is sweeping, it is 3
+        // when no objects to be swept
+        unsigned int sweep_index_;
+        // Sweeping after major GC or minor GC
+        bool sweep_major_;
+        // Bytes of GCGen0 objects moved to GCGen1 by sweep
+        std::size_t sweep_promoted_bytes_;
+        // Count of GCGen0 objects left in sweep list
+        unsigned int sweep_gen0_count_;
+        // Bytes of objects left in sweep lists
+        std::size_t sweep_bytes_;
+        // Objects swept for each allocated byte
+        double sweep_rate_;
+        // Sweep epochs of GCGen0 and of GCGen1 and GCGen2, they flip
+        // when sweeping of the generations starts
+        unsigned int young_epoch_;
+        unsigned int old_epoch_;
+        std::unique_ptr<BackgroundSweeper> sweeper_;
+
+        // Parallel mark
+        unsigned int mark_threads_;
+        unsigned char mark_epoch_;
+
+        // Allocation sites, index 0 is unknown site
+        std::vector<AllocSite> alloc_sites_;
+        std::vector<unsigned int> free_alloc_sites_;
+        bool pretenuring_;
 
         // GC object Deleter
         GCObjectDeleter obj_deleter_;
@@ -1,6 +1,7 @@
 #include "Lex.h"
 #include "State.h"
 #include "Exception.h"
+#include "Number.h"
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -36,6 +37,16 @@ namespace
                (c >= 'a' && c <= 'f') ||
                (c >= 'A' && c <= 'F');
     }
+
+    inline bool IsNumberChar(int c, bool hex)
+    {
+        return hex ? IsHexChar(c) : (c >= '0' && c <= '9');
+    }
+
+    inline bool IsExponent(int c, bool hex)
+    {
+        return hex ? (c == 'p' || c == 'P') : (c == 'e' || c == 'E');
+    }
 } // namespace
 
 namespace luna
@@ -57,7 +68,8 @@ namespace luna
 
 #define RETURN_TOKEN_DETAIL(detail, string, token)              \
     do {                                                        \
-        detail->str_ = state_->GetString(string);               \
+        detail->str_ = state_->InternString(string.c_str(),     \
+                                            string.size());     \
         RETURN_NORMAL_TOKEN_DETAIL(detail, token);              \
     } while (0)
 
@@ -133,9 +145,7 @@ namespace luna
                         token_buffer_.clear();
                         token_buffer_.push_back(current_);
                         current_ = next;
-                        return LexNumberXFractional(detail, false, true,
-                                                    [](int c) { return isdigit(c) != 0; },
-                                                    [](int c) { return c == 'e' || c == 'E'; });
+                        return LexNumberXFractional(detail, false, true, false);
                     }
                     else
                     {
@@ -253,8 +263,7 @@ namespace luna
                 token_buffer_.push_back(next);
                 current_ = Next();
 
-                return LexNumberX(detail, false, IsHexChar,
-                                  [](int c) { return c == 'p' || c == 'P'; });
+                return LexNumberX(detail, false, true);
             }
             else
             {
@@ -264,16 +273,12 @@ namespace luna
             }
         }
 
-        return LexNumberX(detail, integer_part,
-                          [](int c) { return isdigit(c) != 0; },
-                          [](int c) { return c == 'e' || c == 'E'; });
+        return LexNumberX(detail, integer_part, false);
     }
 
-    int Lexer::LexNumberX(TokenDetail *detail, bool integer_part,
-                          std::function<bool (int)> is_number_char,
-                          std::function<bool (int)> is_exponent)
+    int Lexer::LexNumberX(TokenDetail *detail, bool integer_part, bool hex)
     {
-        while (is_number_char(current_))
+        while (IsNumberChar(current_, hex))
         {
             token_buffer_.push_back(current_);
             current_ = Next();
@@ -288,17 +293,14 @@ namespace luna
             point = true;
         }
 
-        return LexNumberXFractional(detail, integer_part, point,
-                                    is_number_char, is_exponent);
+        return LexNumberXFractional(detail, integer_part, point, hex);
     }
 
-    int Lexer::LexNumberXFractional(TokenDetail *detail,
-                                    bool integer_part, bool point,
-                                    std::function<bool (int)> is_number_char,
-                                    std::function<bool (int)> is_exponent)
+    int Lexer::LexNumberXFractional(TokenDetail *detail, bool integer_part,
+                                    bool point, bool hex)
     {
         bool fractional_part = false;
-        while (is_number_char(current_))
+        while (IsNumberChar(current_, hex))
         {
             token_buffer_.push_back(current_);
             current_ = Next();
@@ -310,7 +312,7 @@ namespace luna
         else if (!point && !integer_part && !fractional_part)
             throw LexException(line_, column_, "unexpect incomplete number '%s'", token_buffer_.c_str());
 
-        if (is_exponent(current_))
+        if (IsExponent(current_, hex))
         {
             token_buffer_.push_back(current_);
             current_ = Next();
@@ -330,7 +332,8 @@ namespace luna
             }
         }
 
-        double number = strtod(token_buffer_.c_str(), nullptr);
+        double number = 0.0;
+        StringToNumber(token_buffer_.data(), token_buffer_.size(), &number);
         RETURN_NUMBER_TOKEN_DETAIL(detail, number);
     }
 
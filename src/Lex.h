@@ -43,13 +43,9 @@ namespace luna
         void LexSingleLineComment();
 
         int LexNumber(TokenDetail *detail);
-        int LexNumberX(TokenDetail *detail, bool integer_part,
-                       std::function<bool (int)> is_number_char,
-                       std::function<bool (int)> is_exponent);
-        int LexNumberXFractional(TokenDetail *detail,
-                                 bool integer_part, bool point,
-                                 std::function<bool (int)> is_number_char,
-                                 std::function<bool (int)> is_exponent);
+        int LexNumberX(TokenDetail *detail, bool integer_part, bool hex);
+        int LexNumberXFractional(TokenDetail *detail, bool integer_part,
+                                 bool point, bool hex);
 
         int LexXEqual(TokenDetail *detail, int equal_token);
 
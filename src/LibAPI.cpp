@@ -2,7 +2,9 @@
 #include "State.h"
 #include "Runtime.h"
 #include "Table.h"
+#include "VM.h"
 #include <assert.h>
+#include <math.h>
 
 namespace luna
 {
@@ -104,6 +106,23 @@ namespace luna
             return v;
     }
 
+    bool StackAPI::CheckStack(int count) const
+    {
+        auto end = &stack_->stack_[0] + stack_->stack_.size();
+        return end - stack_->top_ >= count;
+    }
+
+    void StackAPI::PopValue(int count)
+    {
+        stack_->SetNewTop(stack_->top_ - count);
+    }
+
+    void StackAPI::Call(int arg_count, int expect_result)
+    {
+        VM vm(state_);
+        vm.CallFunction(stack_->top_ - arg_count - 1, arg_count, expect_result);
+    }
+
     void StackAPI::PushNil()
     {
         PushValue()->type_ = ValueT_Nil;
@@ -130,6 +149,13 @@ namespace luna
         v->str_ = state_->GetString(str);
     }
 
+    void StackAPI::PushString(const char *str, std::size_t len)
+    {
+        Value *v = PushValue();
+        v->type_ = ValueT_String;
+        v->str_ = state_->GetString(str, len);
+    }
+
     void StackAPI::PushBool(bool value)
     {
         Value *v = PushValue();
@@ -171,11 +197,63 @@ namespace luna
         cfunc_error->expect_type_ = expect_type;
     }
 
+    void StackAPI::ArgValueError(int arg_index, const std::string &desc)
+    {
+        auto cfunc_error = state_->GetCFunctionErrorData();
+        cfunc_error->type_ = CFuntionErrorType_ArgValue;
+        cfunc_error->arg_index_ = arg_index;
+        cfunc_error->arg_desc_ = desc;
+    }
+
     Value * StackAPI::PushValue()
     {
         return stack_->top_++;
     }
 
+    bool GetIntegerArg(StackAPI &api, int index, long long *num)
+    {
+        const double kMaxInteger = 9007199254740992.0;
+
+        if (!api.IsNumber(index))
+        {
+            api.ArgTypeError(index, ValueT_Number);
+            return false;
+        }
+
+        double value = api.GetNumber(index);
+        if (floor(value) != value || value < -kMaxInteger || value > kMaxInteger)
+        {
+            api.ArgValueError(index, "has no integer representation");
+            return false;
+        }
+
+        *num = static_cast<long long>(value);
+        return true;
+    }
+
+    bool GetOptInteger(StackAPI &api, int index, long long def, long long *num)
+    {
+        if (api.GetStackSize() <= index ||
+            api.GetValueType(index) == ValueT_Nil)
+        {
+            *num = def;
+            return true;
+        }
+
+        return GetIntegerArg(api, index, num);
+    }
+
+    long long RelativePosition(long long pos, std::size_t len)
+    {
+        auto size = static_cast<long long>(len);
+        if (pos >= 0)
+            return pos;
+        else if (-pos > size)
+            return 0;
+        else
+            return size + pos + 1;
+    }
+
     Library::Library(State *state)
         : state_(state),
           global_(state->global_.table_)
@@ -199,6 +277,7 @@ namespace luna
         v.type_ = ValueT_Table;
         v.table_ = t;
         global_->SetValue(k, v);
+        CHECK_BARRIER(state_->GetGC(), global_);
 
         for (std::size_t i = 0; i < size; ++i)
         {
@@ -216,5 +295,6 @@ namespace luna
         v.type_ = ValueT_CFunction;
         v.cfunc_ = func;
         table->SetValue(k, v);
+        CHECK_BARRIER(state_->GetGC(), table);
     }
 } // namespace luna
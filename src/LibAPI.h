@@ -44,11 +44,22 @@ namespace luna
         CFunctionType GetCFunction(int index);
         Value * GetValue(int index);
 
+        // Check stack has enough space for 'count' values
+        bool CheckStack(int count) const;
+
+        // Pop 'count' values from stack top
+        void PopValue(int count);
+
+        // Call the function which is below 'arg_count' args on stack top,
+        // results replace the function and args on stack
+        void Call(int arg_count, int expect_result);
+
         // Push value to stack
         void PushNil();
         void PushNumber(double num);
         void PushString(const char *string);
         void PushString(const std::string &str);
+        void PushString(const char *str, std::size_t len);
         void PushBool(bool value);
         void PushTable(Table *table);
         void PushCFunction(CFunctionType function);
@@ -57,6 +68,7 @@ namespace luna
         // For report argument error
         void ArgCountError(int expect_count);
         void ArgTypeError(int arg_index, ValueT expect_type);
+        void ArgValueError(int arg_index, const std::string &desc);
 
     private:
         // Push value to stack, and return the value
@@ -66,6 +78,19 @@ namespace luna
         Stack *stack_;
     };
 
+    // Get integer argument, numbers are integers exactly up to 2^53,
+    // report error and return false when the argument is not a number
+    // or has no integer representation.
+    bool GetIntegerArg(StackAPI &api, int index, long long *num);
+
+    // Get optional integer argument, 'num' is 'def' when the argument is
+    // absent or nil, return false when the argument is not an integer.
+    bool GetOptInteger(StackAPI &api, int index, long long def, long long *num);
+
+    // Convert relative string position, negative position counts
+    // from the end of string
+    long long RelativePosition(long long pos, std::size_t len);
+
     // For register table functions
     struct TableFuncReg
     {
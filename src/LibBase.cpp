@@ -1,9 +1,14 @@
 #include "LibBase.h"
+#include "State.h"
 #include "Table.h"
+#include "String.h"
+#include "Number.h"
 #include "Upvalue.h"
 #include <string>
+#include <algorithm>
 #include <iostream>
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
 
 namespace lib {
@@ -26,8 +31,12 @@ namespace base {
                     printf("%s", api.GetBool(i) ? "true" : "false");
                     break;
                 case luna::ValueT_Number:
-                    printf("%.14g", api.GetNumber(i));
+                {
+                    char buffer[luna::kNumberBufferSize];
+                    auto len = luna::NumberToString(api.GetNumber(i), buffer);
+                    fwrite(buffer, 1, len, stdout);
                     break;
+                }
                 case luna::ValueT_String:
                     printf("%s", api.GetCString(i));
                     break;
@@ -228,6 +237,294 @@ namespace base {
         return 3;
     }
 
+    // Get weak mode from '__mode' field of metatable
+    unsigned int GetWeakMode(luna::State *state, luna::Table *metatable)
+    {
+        luna::Value key;
+        key.type_ = luna::ValueT_String;
+        key.str_ = state->GetString("__mode");
+
+        luna::Value mode = metatable->GetValue(key);
+        if (mode.type_ != luna::ValueT_String)
+            return luna::WeakMode_None;
+
+        unsigned int weak_mode = luna::WeakMode_None;
+        const char *s = mode.str_->GetCStr();
+        for (std::size_t i = 0; i < mode.str_->GetLength(); ++i)
+        {
+            if (s[i] == 'k')
+                weak_mode |= luna::WeakMode_Key;
+            else if (s[i] == 'v')
+                weak_mode |= luna::WeakMode_Value;
+        }
+        return weak_mode;
+    }
+
+    int SetMetatable(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 2)
+        {
+            api.ArgCountError(2);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        luna::Table *t = api.GetTable(0);
+        if (t->IsFrozen())
+        {
+            api.ArgValueError(0, "is a frozen table");
+            return 0;
+        }
+
+        if (api.GetValueType(1) == luna::ValueT_Nil)
+        {
+            t->SetMetatable(nullptr);
+            t->SetWeakMode(luna::WeakMode_None);
+        }
+        else if (api.IsTable(1))
+        {
+            // Weak mode is decided when metatable is set
+            luna::Table *metatable = api.GetTable(1);
+            t->SetMetatable(metatable);
+            t->SetWeakMode(GetWeakMode(state, metatable));
+            CHECK_BARRIER(state->GetGC(), t);
+        }
+        else
+        {
+            api.ArgTypeError(1, luna::ValueT_Table);
+            return 0;
+        }
+
+        api.PushTable(t);
+        return 1;
+    }
+
+    int GetMetatable(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        luna::Table *metatable = nullptr;
+        if (api.IsTable(0))
+            metatable = api.GetTable(0)->GetMetatable();
+
+        if (metatable)
+            api.PushTable(metatable);
+        else
+            api.PushNil();
+        return 1;
+    }
+
+    int ToString(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        char buffer[64];
+        switch (api.GetValueType(0)) {
+            case luna::ValueT_Nil:
+                api.PushString("nil");
+                break;
+            case luna::ValueT_Bool:
+                api.PushString(api.GetBool(0) ? "true" : "false");
+                break;
+            case luna::ValueT_Number:
+            {
+                auto len = luna::NumberToString(api.GetNumber(0), buffer);
+                api.PushString(buffer, len);
+                break;
+            }
+            case luna::ValueT_String:
+                api.PushValue(*api.GetValue(0));
+                break;
+            case luna::ValueT_Closure:
+                snprintf(buffer, sizeof(buffer), "function:\t%p",
+                         static_cast<void *>(api.GetClosure(0)));
+                api.PushString(buffer);
+                break;
+            case luna::ValueT_Table:
+                snprintf(buffer, sizeof(buffer), "table:\t%p",
+                         static_cast<void *>(api.GetTable(0)));
+                api.PushString(buffer);
+                break;
+            case luna::ValueT_CFunction:
+                snprintf(buffer, sizeof(buffer), "function:\t%p",
+                         reinterpret_cast<void *>(api.GetCFunction(0)));
+                api.PushString(buffer);
+                break;
+            default:
+                assert(0);
+                return 0;
+        }
+        return 1;
+    }
+
+    int ToNumber(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        double num = 0.0;
+        if (params < 2 || api.GetValueType(1) == luna::ValueT_Nil)
+        {
+            if (api.IsNumber(0))
+            {
+                api.PushNumber(api.GetNumber(0));
+                return 1;
+            }
+
+            auto str = api.IsString(0) ? api.GetString(0) : nullptr;
+            if (str && luna::StringToNumber(str->GetCStr(), str->GetLength(), &num))
+                api.PushNumber(num);
+            else
+                api.PushNil();
+            return 1;
+        }
+
+        if (!api.IsNumber(1))
+        {
+            api.ArgTypeError(1, luna::ValueT_Number);
+            return 0;
+        }
+
+        double base = api.GetNumber(1);
+        if (base < 2 || base > 36 || floor(base) != base)
+        {
+            api.ArgValueError(1, "is base out of range");
+            return 0;
+        }
+
+        if (!api.IsString(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_String);
+            return 0;
+        }
+
+        auto str = api.GetString(0);
+        if (luna::StringToInteger(str->GetCStr(), str->GetLength(),
+                                  static_cast<int>(base), &num))
+            api.PushNumber(num);
+        else
+            api.PushNil();
+        return 1;
+    }
+
+    // collectgarbage([opt [, arg]]), 'opt' is "collect" by default
+    int CollectGarbage(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+
+        std::string opt = "collect";
+        if (params >= 1 && api.GetValueType(0) != luna::ValueT_Nil)
+        {
+            if (!api.IsString(0))
+            {
+                api.ArgTypeError(0, luna::ValueT_String);
+                return 0;
+            }
+            opt = api.GetCString(0);
+        }
+
+        double arg = 0.0;
+        if (params >= 2 && api.GetValueType(1) != luna::ValueT_Nil)
+        {
+            if (!api.IsNumber(1))
+            {
+                api.ArgTypeError(1, luna::ValueT_Number);
+                return 0;
+            }
+            arg = api.GetNumber(1);
+            if (arg < 0)
+            {
+                api.ArgValueError(1, "is negative");
+                return 0;
+            }
+        }
+
+        auto &gc = state->GetGC();
+        if (opt == "collect")
+        {
+            gc.FullGC();
+            api.PushNumber(0);
+        }
+        else if (opt == "step")
+        {
+            // Each step does the GC work of the allocation which runs
+            // it, steps run until they cover 'arg' KB of allocation or
+            // a cycle is finished, at least one step runs
+            bool finished = false;
+            double kb = 0.0;
+            do
+            {
+                kb += gc.GetStepBytes() / 1024.0;
+                finished = gc.Step();
+            } while (kb < arg && !finished);
+            api.PushBool(finished);
+        }
+        else if (opt == "stop" || opt == "restart")
+        {
+            gc.SetStopped(opt == "stop");
+            api.PushNumber(0);
+        }
+        else if (opt == "isrunning")
+        {
+            api.PushBool(!gc.IsStopped());
+        }
+        else if (opt == "count")
+        {
+            api.PushNumber(gc.GetTotalBytes() / 1024.0);
+        }
+        else if (opt == "incremental" || opt == "generational")
+        {
+            // Minor GC is always generational, the mode decides major
+            // GC runs in incremental steps or in one pause. 'arg' is
+            // step work of incremental mode, or growth percent of
+            // generational mode.
+            api.PushString(gc.IsIncremental() ? "incremental" : "generational");
+            auto value = static_cast<unsigned int>(std::min(arg, 1e9));
+            if (opt == "incremental")
+            {
+                gc.SetIncremental(true);
+                if (value > 0)
+                    gc.SetStepBudget(value);
+            }
+            else
+            {
+                gc.SetIncremental(false);
+                if (value > 0)
+                    gc.SetGrowthFactor(value);
+            }
+        }
+        else
+        {
+            api.ArgValueError(0, "is an invalid option");
+            return 0;
+        }
+        return 1;
+    }
+
     int GetLine(luna::State *state)
     {
         luna::StackAPI api(state);
@@ -245,7 +542,12 @@ namespace base {
         lib.RegisterFunc("ipairs", IPairs);
         lib.RegisterFunc("pairs", Pairs);
         lib.RegisterFunc("type", Type);
+        lib.RegisterFunc("tostring", ToString);
+        lib.RegisterFunc("tonumber", ToNumber);
+        lib.RegisterFunc("setmetatable", SetMetatable);
+        lib.RegisterFunc("getmetatable", GetMetatable);
         lib.RegisterFunc("getline", GetLine);
+        lib.RegisterFunc("collectgarbage", CollectGarbage);
     }
 
 } // namespace base
@@ -1,5 +1,7 @@
 #include "LibMath.h"
+#include "Table.h"
 #include <random>
+#include <string>
 #include <math.h>
 #include <stdlib.h>
 
@@ -93,12 +95,206 @@ namespace math {
         return 0;
     }
 
+    // Kernels of packed number arrays, independent accumulators let
+    // compiler vectorize these loops.
+    double SumKernel(const double *p, std::size_t n)
+    {
+        double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            s0 += p[i];
+            s1 += p[i + 1];
+            s2 += p[i + 2];
+            s3 += p[i + 3];
+        }
+
+        for (; i < n; ++i)
+            s0 += p[i];
+        return (s0 + s1) + (s2 + s3);
+    }
+
+    double DotKernel(const double *a, const double *b, std::size_t n)
+    {
+        double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            s0 += a[i] * b[i];
+            s1 += a[i + 1] * b[i + 1];
+            s2 += a[i + 2] * b[i + 2];
+            s3 += a[i + 3] * b[i + 3];
+        }
+
+        for (; i < n; ++i)
+            s0 += a[i] * b[i];
+        return (s0 + s1) + (s2 + s3);
+    }
+
+    void ScaleKernel(double *p, std::size_t n, double k)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            p[i] *= k;
+    }
+
+    // Get number array of table argument 'index', boxed array part is
+    // copied into 'buffer', return false if there is a non-number value.
+    bool GetNumbers(luna::StackAPI &api, int index,
+                    std::vector<double> &buffer,
+                    const double **nums, std::size_t *size)
+    {
+        luna::Table *t = api.GetTable(index);
+        *size = t->ArraySize();
+        *nums = t->GetNumberArray();
+        if (*nums || *size == 0)
+            return true;
+
+        buffer.resize(*size);
+        luna::Value key;
+        key.type_ = luna::ValueT_Number;
+        for (std::size_t i = 0; i < *size; ++i)
+        {
+            key.num_ = i + 1;
+            luna::Value value = t->GetValue(key);
+            if (value.type_ != luna::ValueT_Number)
+            {
+                api.ArgValueError(index, "has non-number value at index " +
+                                  std::to_string(i + 1));
+                return false;
+            }
+            buffer[i] = value.num_;
+        }
+
+        *nums = &buffer[0];
+        return true;
+    }
+
+    int Sum(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        std::vector<double> buffer;
+        const double *nums = nullptr;
+        std::size_t size = 0;
+        if (!GetNumbers(api, 0, buffer, &nums, &size))
+            return 0;
+
+        api.PushNumber(SumKernel(nums, size));
+        return 1;
+    }
+
+    int Dot(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 2)
+        {
+            api.ArgCountError(2);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        if (!api.IsTable(1))
+        {
+            api.ArgTypeError(1, luna::ValueT_Table);
+            return 0;
+        }
+
+        std::vector<double> buffer1;
+        std::vector<double> buffer2;
+        const double *nums1 = nullptr;
+        const double *nums2 = nullptr;
+        std::size_t size1 = 0;
+        std::size_t size2 = 0;
+        if (!GetNumbers(api, 0, buffer1, &nums1, &size1) ||
+            !GetNumbers(api, 1, buffer2, &nums2, &size2))
+            return 0;
+
+        if (size1 != size2)
+        {
+            api.ArgValueError(1, "has different length with argument #1");
+            return 0;
+        }
+
+        api.PushNumber(DotKernel(nums1, nums2, size1));
+        return 1;
+    }
+
+    int Scale(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 2)
+        {
+            api.ArgCountError(2);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        if (!api.IsNumber(1))
+        {
+            api.ArgTypeError(1, luna::ValueT_Number);
+            return 0;
+        }
+
+        luna::Table *t = api.GetTable(0);
+        double k = api.GetNumber(1);
+        if (t->GetNumberArray())
+        {
+            ScaleKernel(t->GetNumberArray(), t->ArraySize(), k);
+        }
+        else
+        {
+            std::vector<double> buffer;
+            const double *nums = nullptr;
+            std::size_t size = 0;
+            if (!GetNumbers(api, 0, buffer, &nums, &size))
+                return 0;
+
+            luna::Value value;
+            value.type_ = luna::ValueT_Number;
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                value.num_ = nums[i] * k;
+                t->SetArrayValue(i + 1, value);
+            }
+        }
+
+        api.PushTable(t);
+        return 1;
+    }
+
     void RegisterLibMath(luna::State *state)
     {
         luna::Library lib(state);
         luna::TableFuncReg math[] = {
             { "random", Random },
-            { "randomseed", RandomSeed }
+            { "randomseed", RandomSeed },
+            { "sum", Sum },
+            { "dot", Dot },
+            { "scale", Scale }
         };
 
         lib.RegisterTableFunction("math", math);
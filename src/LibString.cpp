@@ -1,10 +1,129 @@
 #include "LibString.h"
+#include "Number.h"
+#include "Pattern.h"
+#include "State.h"
 #include "String.h"
+#include "Table.h"
 #include <string>
+#include <algorithm>
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 namespace lib {
 namespace string {
 
+    // Get string argument, report error and return nullptr when the
+    // argument is not a string
+    const luna::String * GetStringArg(luna::StackAPI &api, int index)
+    {
+        if (!api.IsString(index))
+        {
+            api.ArgTypeError(index, luna::ValueT_String);
+            return nullptr;
+        }
+        return api.GetString(index);
+    }
+
+    // Convert ASCII letters in range ['from', 'from' + 26) by xor 0x20,
+    // eight bytes are converted at a time.
+    void ConvertCase(const char *src, std::size_t len, char *dst, char from)
+    {
+        typedef unsigned long long Word;
+        const Word ones = 0x0101010101010101ULL;
+        const Word high = 0x8080808080808080ULL;
+
+        std::size_t i = 0;
+        for (; i + sizeof(Word) <= len; i += sizeof(Word))
+        {
+            Word w;
+            memcpy(&w, src + i, sizeof(w));
+            // Set high bit of bytes which in [from, from + 26) without
+            // carry between bytes, bytes not ASCII are excluded.
+            Word low7 = w & ~high;
+            Word ge = low7 + (0x80 - from) * ones;
+            Word gt = low7 + (0x80 - from - 26) * ones;
+            Word mask = ge & ~gt & ~w & high;
+            w ^= mask >> 2;
+            memcpy(dst + i, &w, sizeof(w));
+        }
+
+        for (; i < len; ++i)
+        {
+            char c = src[i];
+            dst[i] = c >= from && c < from + 26 ? c ^ 0x20 : c;
+        }
+    }
+
+    // Error of replacement argument of string.gsub
+    struct ReplacementError
+    {
+        std::string desc_;
+
+        explicit ReplacementError(const std::string &desc) : desc_(desc) { }
+    };
+
+    // Push capture 'i' of match [s, e)
+    void PushCapture(luna::StackAPI &api, const luna::PatternMatcher &matcher,
+                     int i, const char *s, const char *e)
+    {
+        const char *str = nullptr;
+        std::size_t len = 0;
+        if (matcher.GetCapture(i, s, e, &str, &len))
+            api.PushString(str, len);
+        else
+            api.PushNumber(static_cast<double>(str - matcher.GetSource() + 1));
+    }
+
+    // Push all captures of match [s, e), push the whole match
+    // when there is no capture, return count of pushed values
+    int PushCaptures(luna::StackAPI &api, const luna::PatternMatcher &matcher,
+                     const char *s, const char *e)
+    {
+        int level = matcher.GetCaptureCount();
+        int count = (level == 0 && s) ? 1 : level;
+        if (!api.CheckStack(count))
+            throw luna::PatternError("has too many captures");
+
+        for (int i = 0; i < count; ++i)
+            PushCapture(api, matcher, i, s, e);
+        return count;
+    }
+
+    // Append capture 'i' of match [s, e) to 'out'
+    void AppendCapture(std::string &out, const luna::PatternMatcher &matcher,
+                       int i, const char *s, const char *e)
+    {
+        const char *str = nullptr;
+        std::size_t len = 0;
+        if (matcher.GetCapture(i, s, e, &str, &len))
+        {
+            out.append(str, len);
+        }
+        else
+        {
+            char buffer[luna::kNumberBufferSize];
+            auto n = luna::NumberToString(
+                static_cast<double>(str - matcher.GetSource() + 1), buffer);
+            out.append(buffer, n);
+        }
+    }
+
+    // Pattern has no special characters, it can be found plainly
+    bool IsPlainPattern(const luna::String *p)
+    {
+        const char *s = p->GetCStr();
+        std::size_t len = p->GetLength();
+        for (std::size_t i = 0; i < len; ++i)
+        {
+            if (strchr("^$*+?.([%-", s[i]) && s[i] != 0)
+                return false;
+        }
+        return true;
+    }
+
     int Byte(luna::State *state)
     {
         luna::StackAPI api(state);
@@ -85,12 +204,804 @@ namespace string {
         return 1;
     }
 
+    int Len(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        auto str = GetStringArg(api, 0);
+        if (!str)
+            return 0;
+
+        api.PushNumber(static_cast<double>(str->GetLength()));
+        return 1;
+    }
+
+    int Sub(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        auto str = GetStringArg(api, 0);
+        if (!str)
+            return 0;
+
+        long long i = 0;
+        long long j = 0;
+        std::size_t len = str->GetLength();
+        if (!luna::GetOptInteger(api, 1, 1, &i) ||
+            !luna::GetOptInteger(api, 2, -1, &j))
+            return 0;
+
+        // Clamp positions into [1, len] before indexing
+        auto size = static_cast<long long>(len);
+        i = luna::RelativePosition(i, len);
+        j = luna::RelativePosition(j, len);
+        if (i < 1)
+            i = 1;
+        if (j > size)
+            j = size;
+
+        if (i > j)
+        {
+            api.PushString("", 0);
+        }
+        else if (i == 1 && j == size)
+        {
+            api.PushValue(*api.GetValue(0));
+        }
+        else
+        {
+            auto start = static_cast<std::size_t>(i) - 1;
+            auto count = static_cast<std::size_t>(j - i) + 1;
+            api.PushString(str->GetCStr() + start, count);
+        }
+        return 1;
+    }
+
+    int ConvertCaseOf(luna::State *state, char from)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        auto str = GetStringArg(api, 0);
+        if (!str)
+            return 0;
+
+        std::string result(str->GetLength(), 0);
+        if (!result.empty())
+            ConvertCase(str->GetCStr(), str->GetLength(), &result[0], from);
+        api.PushString(result.data(), result.size());
+        return 1;
+    }
+
+    int Upper(luna::State *state)
+    {
+        return ConvertCaseOf(state, 'a');
+    }
+
+    int Lower(luna::State *state)
+    {
+        return ConvertCaseOf(state, 'A');
+    }
+
+    int Rep(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 2)
+        {
+            api.ArgCountError(2);
+            return 0;
+        }
+
+        auto str = GetStringArg(api, 0);
+        if (!str)
+            return 0;
+
+        long long n = 0;
+        if (!luna::GetIntegerArg(api, 1, &n))
+            return 0;
+
+        const luna::String *sep = nullptr;
+        if (api.GetStackSize() > 2 &&
+            api.GetValueType(2) != luna::ValueT_Nil)
+        {
+            sep = GetStringArg(api, 2);
+            if (!sep)
+                return 0;
+        }
+
+        std::size_t len = str->GetLength();
+        std::size_t sep_len = sep ? sep->GetLength() : 0;
+        if (n <= 0 || len + sep_len == 0)
+        {
+            api.PushString("", 0);
+            return 1;
+        }
+
+        // Total length is n * len + (n - 1) * sep_len
+        double total = static_cast<double>(n) * (len + sep_len) - sep_len;
+        if (total >= INT_MAX)
+        {
+            api.ArgValueError(1, "makes resulting string too large");
+            return 0;
+        }
+
+        std::string result(static_cast<std::size_t>(total), 0);
+        char *dst = &result[0];
+        memcpy(dst, str->GetCStr(), len);
+        if (sep_len > 0 && total > len)
+            memcpy(dst + len, sep->GetCStr(), sep_len);
+
+        // Double the filled part, which is whole units of
+        // string and separator, until the result is filled
+        std::size_t filled = std::min(len + sep_len, result.size());
+        while (filled < result.size())
+        {
+            std::size_t count = std::min(filled, result.size() - filled);
+            memcpy(dst + filled, dst, count);
+            filled += count;
+        }
+
+        api.PushString(result.data(), result.size());
+        return 1;
+    }
+
+    int Reverse(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        auto str = GetStringArg(api, 0);
+        if (!str)
+            return 0;
+
+        const char *s = str->GetCStr();
+        std::string result(s, str->GetLength());
+        std::reverse(result.begin(), result.end());
+        api.PushString(result.data(), result.size());
+        return 1;
+    }
+
+    // Implement string.find and string.match
+    int FindAux(luna::State *state, bool find)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 2)
+        {
+            api.ArgCountError(2);
+            return 0;
+        }
+
+        auto str = GetStringArg(api, 0);
+        if (!str)
+            return 0;
+
+        auto pattern = GetStringArg(api, 1);
+        if (!pattern)
+            return 0;
+
+        long long init = 0;
+        if (!luna::GetOptInteger(api, 2, 1, &init))
+            return 0;
+
+        std::size_t len = str->GetLength();
+        init = luna::RelativePosition(init, len);
+        if (init < 1)
+            init = 1;
+        if (init > static_cast<long long>(len) + 1)
+        {
+            api.PushNil();
+            return 1;
+        }
+
+        const char *s = str->GetCStr();
+        const char *p = pattern->GetCStr();
+        std::size_t plen = pattern->GetLength();
+        std::size_t start = static_cast<std::size_t>(init) - 1;
+
+        bool plain = find && api.GetStackSize() > 3 && !api.GetValue(3)->IsFalse();
+        if (find && (plain || IsPlainPattern(pattern)))
+        {
+            auto pos = luna::FindString(s + start, len - start, p, plen);
+            if (!pos)
+            {
+                api.PushNil();
+                return 1;
+            }
+
+            api.PushNumber(static_cast<double>(pos - s + 1));
+            api.PushNumber(static_cast<double>(pos - s + plen));
+            return 2;
+        }
+
+        try
+        {
+            auto compiled = state->GetPatternCache().GetPattern(pattern);
+            luna::PatternMatcher matcher(compiled.get(), s, len);
+
+            const char *s1 = nullptr;
+            auto e = matcher.Find(s + start, &s1);
+            if (e)
+            {
+                if (!find)
+                    return PushCaptures(api, matcher, s1, e);
+
+                api.PushNumber(static_cast<double>(s1 - s + 1));
+                api.PushNumber(static_cast<double>(e - s));
+                if (matcher.GetCaptureCount() == 0)
+                    return 2;
+                return 2 + PushCaptures(api, matcher, nullptr, nullptr);
+            }
+        }
+        catch (const luna::PatternError &error)
+        {
+            api.ArgValueError(1, error.desc_);
+            return 0;
+        }
+
+        api.PushNil();
+        return 1;
+    }
+
+    int Find(luna::State *state)
+    {
+        return FindAux(state, true);
+    }
+
+    int Match(luna::State *state)
+    {
+        return FindAux(state, false);
+    }
+
+    // Iterator function of string.gmatch, the state table holds
+    // the string, the pattern and the position of next match
+    int DoGMatch(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        auto t = api.GetTable(0);
+        luna::Value key;
+        key.type_ = luna::ValueT_Number;
+        key.num_ = 1;
+        auto str = t->GetValue(key);
+        key.num_ = 2;
+        auto pattern = t->GetValue(key);
+        key.num_ = 3;
+        auto pos = t->GetValue(key);
+        if (str.type_ != luna::ValueT_String ||
+            pattern.type_ != luna::ValueT_String ||
+            pos.type_ != luna::ValueT_Number ||
+            pos.num_ < 0 || pos.num_ > str.str_->GetLength() + 1)
+        {
+            api.ArgValueError(0, "is not a state of gmatch");
+            return 0;
+        }
+
+        const char *s = str.str_->GetCStr();
+        std::size_t len = str.str_->GetLength();
+        luna::Value next;
+        next.type_ = luna::ValueT_Number;
+
+        try
+        {
+            // '^' is not an anchor in gmatch, as it would prevent the
+            // iteration
+            auto compiled = state->GetPatternCache().GetPattern(pattern.str_, false);
+            luna::PatternMatcher matcher(compiled.get(), s, len);
+            auto start = static_cast<std::size_t>(pos.num_);
+            const char *src = nullptr;
+            auto e = start > len ? nullptr : matcher.Find(s + start, &src);
+            if (e)
+            {
+                // Empty match advances one char
+                next.num_ = static_cast<double>(e == src ? e - s + 1 : e - s);
+                t->SetValue(key, next);
+                return PushCaptures(api, matcher, src, e);
+            }
+        }
+        catch (const luna::PatternError &error)
+        {
+            api.ArgValueError(1, error.desc_);
+            return 0;
+        }
+
+        next.num_ = static_cast<double>(len + 1);
+        t->SetValue(key, next);
+        return 0;
+    }
+
+    // string.gmatch returns the iterator function and its state table,
+    // since C functions have no upvalues to keep the state.
+    int GMatch(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 2)
+        {
+            api.ArgCountError(2);
+            return 0;
+        }
+
+        if (!GetStringArg(api, 0) || !GetStringArg(api, 1))
+            return 0;
+
+        auto t = state->NewTable();
+        t->SetArrayValue(1, *api.GetValue(0));
+        t->SetArrayValue(2, *api.GetValue(1));
+        luna::Value pos;
+        pos.type_ = luna::ValueT_Number;
+        pos.num_ = 0;
+        t->SetArrayValue(3, pos);
+
+        api.PushCFunction(DoGMatch);
+        api.PushTable(t);
+        return 2;
+    }
+
+    // Append replacement of match [s, e) to 'result', return false
+    // when there is an error
+    bool AddReplacement(luna::StackAPI &api, const luna::PatternMatcher &matcher,
+                        const char *s, const char *e, std::string &result)
+    {
+        auto repl = api.GetValue(2);
+        if (repl->type_ == luna::ValueT_String)
+        {
+            const char *r = repl->str_->GetCStr();
+            std::size_t len = repl->str_->GetLength();
+            for (std::size_t i = 0; i < len; ++i)
+            {
+                if (r[i] != '%')
+                {
+                    result.push_back(r[i]);
+                    continue;
+                }
+
+                ++i;
+                if (i < len && r[i] == '%')
+                    result.push_back('%');
+                else if (i < len && r[i] == '0')
+                    result.append(s, e - s);
+                else if (i < len && isdigit(static_cast<unsigned char>(r[i])))
+                {
+                    int l = r[i] - '1';
+                    if (l >= std::max(matcher.GetCaptureCount(), 1))
+                        throw ReplacementError(std::string("has invalid capture "
+                                               "index %") + r[i]);
+                    AppendCapture(result, matcher, l, s, e);
+                }
+                else
+                    throw ReplacementError("has invalid use of '%' in "
+                                           "replacement string");
+            }
+            return true;
+        }
+
+        if (repl->type_ == luna::ValueT_Number)
+        {
+            char buffer[luna::kNumberBufferSize];
+            auto n = luna::NumberToString(repl->num_, buffer);
+            result.append(buffer, n);
+            return true;
+        }
+
+        luna::Value value;
+        if (repl->type_ == luna::ValueT_Table)
+        {
+            PushCapture(api, matcher, 0, s, e);
+            value = repl->table_->GetValue(*api.GetValue(-1));
+            api.PopValue(1);
+        }
+        else
+        {
+            if (!api.CheckStack(1))
+                throw ReplacementError("has too many captures");
+            api.PushValue(*repl);
+            int count = PushCaptures(api, matcher, s, e);
+            api.Call(count, 1);
+            value = *api.GetValue(-1);
+            api.PopValue(1);
+        }
+
+        // Keep the original match when value is false or nil
+        if (value.IsFalse())
+        {
+            result.append(s, e - s);
+        }
+        else if (value.type_ == luna::ValueT_String)
+        {
+            result.append(value.str_->GetCStr(), value.str_->GetLength());
+        }
+        else if (value.type_ == luna::ValueT_Number)
+        {
+            char buffer[luna::kNumberBufferSize];
+            auto n = luna::NumberToString(value.num_, buffer);
+            result.append(buffer, n);
+        }
+        else
+        {
+            throw ReplacementError(std::string("has invalid replacement "
+                                               "value (a ") +
+                                   value.TypeName() + ")");
+        }
+        return true;
+    }
+
+    int GSub(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 3)
+        {
+            api.ArgCountError(3);
+            return 0;
+        }
+
+        auto str = GetStringArg(api, 0);
+        if (!str)
+            return 0;
+
+        auto pattern = GetStringArg(api, 1);
+        if (!pattern)
+            return 0;
+
+        auto repl_type = api.GetValueType(2);
+        if (repl_type != luna::ValueT_String &&
+            repl_type != luna::ValueT_Number &&
+            repl_type != luna::ValueT_Table &&
+            repl_type != luna::ValueT_Closure &&
+            repl_type != luna::ValueT_CFunction)
+        {
+            api.ArgValueError(2, "should be string, table or function");
+            return 0;
+        }
+
+        std::size_t len = str->GetLength();
+        long long max_n = 0;
+        if (!luna::GetOptInteger(api, 3, static_cast<long long>(len) + 1, &max_n))
+            return 0;
+
+        const char *s = str->GetCStr();
+        std::string result;
+        long long n = 0;
+        const char *src = s;
+        const char *end = s + len;
+
+        try
+        {
+            auto compiled = state->GetPatternCache().GetPattern(pattern);
+            luna::PatternMatcher matcher(compiled.get(), s, len);
+            while (n < max_n)
+            {
+                const char *m = nullptr;
+                auto e = matcher.Find(src, &m);
+                if (!e)
+                    break;
+
+                // Copy the skipped chars in bulk
+                result.append(src, m - src);
+                ++n;
+                AddReplacement(api, matcher, m, e, result);
+
+                // Empty match advances one char
+                if (e > m)
+                    src = e;
+                else if (m < end)
+                {
+                    result.push_back(*m);
+                    src = m + 1;
+                }
+                else
+                {
+                    src = m;
+                    break;
+                }
+
+                if (compiled->IsAnchored())
+                    break;
+            }
+        }
+        catch (const luna::PatternError &error)
+        {
+            api.ArgValueError(1, error.desc_);
+            return 0;
+        }
+        catch (const ReplacementError &error)
+        {
+            api.ArgValueError(2, error.desc_);
+            return 0;
+        }
+
+        if (n == 0)
+        {
+            api.PushValue(*api.GetValue(0));
+        }
+        else
+        {
+            result.append(src, end - src);
+            api.PushString(result.data(), result.size());
+        }
+        api.PushNumber(static_cast<double>(n));
+        return 2;
+    }
+
+    // Append quoted string 's' to 'result' which can be read back
+    void AddQuoted(const luna::String *str, std::string &result)
+    {
+        const char *s = str->GetCStr();
+        std::size_t len = str->GetLength();
+
+        result.push_back('"');
+        for (std::size_t i = 0; i < len; ++i)
+        {
+            unsigned char c = s[i];
+            if (c == '"' || c == '\\' || c == '\n')
+            {
+                result.push_back('\\');
+                result.push_back(c);
+            }
+            else if (c == '\r')
+            {
+                result.append("\\r");
+            }
+            else if (iscntrl(c))
+            {
+                char buffer[8];
+                bool digit_next = i + 1 < len &&
+                    isdigit(static_cast<unsigned char>(s[i + 1]));
+                auto n = snprintf(buffer, sizeof(buffer),
+                                  digit_next ? "\\%03d" : "\\%d", c);
+                result.append(buffer, n);
+            }
+            else
+            {
+                result.push_back(c);
+            }
+        }
+        result.push_back('"');
+    }
+
+    int Format(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        auto fmt = GetStringArg(api, 0);
+        if (!fmt)
+            return 0;
+
+        const char *f = fmt->GetCStr();
+        const char *f_end = f + fmt->GetLength();
+        std::string result;
+        int arg = 0;
+
+        while (f < f_end)
+        {
+            if (*f != '%')
+            {
+                // Append plain text until next '%'
+                auto next = static_cast<const char *>(memchr(f, '%', f_end - f));
+                if (!next)
+                    next = f_end;
+                result.append(f, next - f);
+                f = next;
+                continue;
+            }
+
+            if (++f < f_end && *f == '%')
+            {
+                result.push_back('%');
+                ++f;
+                continue;
+            }
+
+            // Scan flags, width and precision of the spec
+            const char *spec_begin = f;
+            while (f < f_end && strchr("-+ #0", *f) && *f)
+                ++f;
+            if (f - spec_begin > 5)
+            {
+                api.ArgValueError(0, "has invalid format (repeated flags)");
+                return 0;
+            }
+
+            int digits = 0;
+            while (f < f_end && isdigit(static_cast<unsigned char>(*f)))
+                ++f, ++digits;
+            if (f < f_end && *f == '.')
+            {
+                ++f;
+                if (digits <= 2)
+                    digits = 0;
+                while (f < f_end && isdigit(static_cast<unsigned char>(*f)))
+                    ++f, ++digits;
+            }
+            if (digits > 2)
+            {
+                api.ArgValueError(0, "has invalid format "
+                                  "(width or precision too long)");
+                return 0;
+            }
+
+            if (f >= f_end)
+            {
+                api.ArgValueError(0, "has invalid conversion at the end");
+                return 0;
+            }
+
+            std::string spec("%");
+            spec.append(spec_begin, f - spec_begin);
+            char conversion = *f++;
+            ++arg;
+
+            char buffer[512];
+            int n = 0;
+            switch (conversion)
+            {
+                case 'c':
+                case 'd': case 'i':
+                case 'o': case 'u': case 'x': case 'X':
+                {
+                    if (!api.IsNumber(arg))
+                    {
+                        api.ArgTypeError(arg, luna::ValueT_Number);
+                        return 0;
+                    }
+
+                    double num = api.GetNumber(arg);
+                    if (conversion == 'c')
+                    {
+                        spec.push_back('c');
+                        n = snprintf(buffer, sizeof(buffer), spec.c_str(),
+                                     static_cast<int>(num));
+                        break;
+                    }
+
+                    if (!(num >= -9223372036854775808.0 &&
+                          num < 9223372036854775808.0))
+                    {
+                        api.ArgValueError(arg, "has no integer representation");
+                        return 0;
+                    }
+
+                    spec.append("ll");
+                    spec.push_back(conversion);
+                    n = snprintf(buffer, sizeof(buffer), spec.c_str(),
+                                 static_cast<long long>(num));
+                    break;
+                }
+                case 'a': case 'A':
+                case 'e': case 'E':
+                case 'f': case 'F':
+                case 'g': case 'G':
+                {
+                    if (!api.IsNumber(arg))
+                    {
+                        api.ArgTypeError(arg, luna::ValueT_Number);
+                        return 0;
+                    }
+
+                    spec.push_back(conversion);
+                    n = snprintf(buffer, sizeof(buffer), spec.c_str(),
+                                 api.GetNumber(arg));
+                    break;
+                }
+                case 'q':
+                {
+                    auto str = GetStringArg(api, arg);
+                    if (!str)
+                        return 0;
+                    AddQuoted(str, result);
+                    continue;
+                }
+                case 's':
+                {
+                    if (api.IsNumber(arg))
+                    {
+                        char num[luna::kNumberBufferSize];
+                        auto len = luna::NumberToString(api.GetNumber(arg), num);
+                        if (spec.size() == 1)
+                        {
+                            result.append(num, len);
+                            continue;
+                        }
+
+                        spec.push_back('s');
+                        n = snprintf(buffer, sizeof(buffer), spec.c_str(), num);
+                        break;
+                    }
+
+                    auto str = GetStringArg(api, arg);
+                    if (!str)
+                        return 0;
+
+                    // Append directly when no modifiers, or no precision
+                    // and the string is longer than the width
+                    if (spec.size() == 1 ||
+                        (spec.find('.') == std::string::npos &&
+                         str->GetLength() >= 100))
+                    {
+                        result.append(str->GetCStr(), str->GetLength());
+                        continue;
+                    }
+
+                    // snprintf stops at the first zero
+                    if (strlen(str->GetCStr()) != str->GetLength())
+                    {
+                        api.ArgValueError(arg, "contains zeros");
+                        return 0;
+                    }
+
+                    spec.push_back('s');
+                    n = snprintf(buffer, sizeof(buffer), spec.c_str(),
+                                 str->GetCStr());
+                    break;
+                }
+                default:
+                {
+                    std::string desc("has invalid option '%");
+                    desc.push_back(conversion);
+                    desc.append("' to 'format'");
+                    api.ArgValueError(0, desc);
+                    return 0;
+                }
+            }
+
+            if (n > 0)
+                result.append(buffer, std::min<std::size_t>(n, sizeof(buffer) - 1));
+        }
+
+        api.PushString(result.data(), result.size());
+        return 1;
+    }
+
     void RegisterLibString(luna::State *state)
     {
         luna::Library lib(state);
         luna::TableFuncReg string[] = {
             { "byte", Byte },
-            { "char", Char }
+            { "char", Char },
+            { "len", Len },
+            { "sub", Sub },
+            { "upper", Upper },
+            { "lower", Lower },
+            { "rep", Rep },
+            { "reverse", Reverse },
+            { "find", Find },
+            { "match", Match },
+            { "gmatch", GMatch },
+            { "gsub", GSub },
+            { "format", Format }
         };
         lib.RegisterTableFunction("string", string);
     }
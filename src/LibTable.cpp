@@ -0,0 +1,761 @@
+#include "LibTable.h"
+#include "State.h"
+#include "Table.h"
+#include "String.h"
+#include "Number.h"
+#include <string>
+#include <utility>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+
+namespace lib {
+namespace table {
+
+    // Max integer which numbers represent exactly
+    const long long kMaxInteger = 9007199254740992LL;
+
+    luna::Value GetIndexValue(luna::Table *t, double index)
+    {
+        luna::Value key;
+        key.type_ = luna::ValueT_Number;
+        key.num_ = index;
+        return t->GetValue(key);
+    }
+
+    void SetIndexValue(luna::Table *t, double index, const luna::Value &value)
+    {
+        luna::Value key;
+        key.type_ = luna::ValueT_Number;
+        key.num_ = index;
+        t->SetValue(key, value);
+    }
+
+    // Get optional number argument, 'num' is 'def' when the argument is
+    // absent or nil, return false when the argument is not a number.
+    bool GetOptNumber(luna::StackAPI &api, int index, double def, double *num)
+    {
+        if (api.GetStackSize() <= index ||
+            api.GetValueType(index) == luna::ValueT_Nil)
+        {
+            *num = def;
+            return true;
+        }
+
+        if (!api.IsNumber(index))
+        {
+            api.ArgTypeError(index, luna::ValueT_Number);
+            return false;
+        }
+
+        *num = api.GetNumber(index);
+        return true;
+    }
+
+    // Report error and return false when table of argument is frozen
+    bool CheckWritable(luna::StackAPI &api, int index, luna::Table *t)
+    {
+        if (t->IsFrozen())
+        {
+            api.ArgValueError(index, "is a frozen table");
+            return false;
+        }
+        return true;
+    }
+
+    int Insert(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 2)
+        {
+            api.ArgCountError(2);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        luna::Table *t = api.GetTable(0);
+        if (!CheckWritable(api, 0, t))
+            return 0;
+
+        std::size_t size = t->ArraySize();
+        if (params == 2)
+        {
+            t->SetArrayValue(size + 1, *api.GetValue(1));
+            CHECK_BARRIER(state->GetGC(), t);
+            return 0;
+        }
+
+        if (!api.IsNumber(1))
+        {
+            api.ArgTypeError(1, luna::ValueT_Number);
+            return 0;
+        }
+
+        double pos = api.GetNumber(1);
+        if (pos < 1 || pos > size + 1 || floor(pos) != pos)
+        {
+            api.ArgValueError(1, "is position out of bounds");
+            return 0;
+        }
+
+        t->InsertArrayValue(static_cast<std::size_t>(pos), *api.GetValue(2));
+        CHECK_BARRIER(state->GetGC(), t);
+        return 0;
+    }
+
+    int Remove(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        luna::Table *t = api.GetTable(0);
+        if (!CheckWritable(api, 0, t))
+            return 0;
+
+        std::size_t size = t->ArraySize();
+
+        double pos = 0.0;
+        if (!GetOptNumber(api, 1, size, &pos))
+            return 0;
+
+        // Nothing to remove from empty array
+        if (size == 0 && (pos == 0 || pos == 1))
+        {
+            api.PushNil();
+            return 1;
+        }
+
+        if (pos < 1 || pos > size || floor(pos) != pos)
+        {
+            api.ArgValueError(1, "is position out of bounds");
+            return 0;
+        }
+
+        api.PushValue(GetIndexValue(t, pos));
+        t->RemoveArrayValue(static_cast<std::size_t>(pos));
+        return 1;
+    }
+
+    int Concat(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        const luna::String *sep = nullptr;
+        if (params >= 2 && api.GetValueType(1) != luna::ValueT_Nil)
+        {
+            if (!api.IsString(1))
+            {
+                api.ArgTypeError(1, luna::ValueT_String);
+                return 0;
+            }
+            sep = api.GetString(1);
+        }
+
+        luna::Table *t = api.GetTable(0);
+        long long i = 0;
+        long long j = 0;
+        auto size = static_cast<long long>(t->ArraySize());
+        if (!luna::GetOptInteger(api, 2, 1, &i) ||
+            !luna::GetOptInteger(api, 3, size, &j))
+            return 0;
+
+        if (i > j)
+        {
+            api.PushString("");
+            return 1;
+        }
+
+        // Calculate total length of result first, numbers are counted
+        // as their max length, then build the result with only one
+        // allocation
+        char buffer[64];
+        std::size_t total = 0;
+        for (long long k = i; k <= j; ++k)
+        {
+            luna::Value value = GetIndexValue(t, static_cast<double>(k));
+            if (value.type_ == luna::ValueT_String)
+            {
+                total += value.str_->GetLength();
+            }
+            else if (value.type_ == luna::ValueT_Number)
+            {
+                total += luna::kNumberBufferSize;
+            }
+            else
+            {
+                snprintf(buffer, sizeof(buffer),
+                         "has invalid value (a %s value) at index %.14g",
+                         value.TypeName(), static_cast<double>(k));
+                api.ArgValueError(0, buffer);
+                return 0;
+            }
+        }
+
+        // All values exist, so the count of separators is bounded
+        std::size_t sep_len = sep ? sep->GetLength() : 0;
+        total += sep_len * static_cast<std::size_t>(j - i);
+
+        std::string result;
+        result.reserve(total);
+        for (long long k = i; k <= j; ++k)
+        {
+            luna::Value value = GetIndexValue(t, static_cast<double>(k));
+            if (value.type_ == luna::ValueT_String)
+            {
+                result.append(value.str_->GetCStr(), value.str_->GetLength());
+            }
+            else
+            {
+                auto len = luna::NumberToString(value.num_, buffer);
+                result.append(buffer, len);
+            }
+
+            if (sep && k < j)
+                result.append(sep->GetCStr(), sep_len);
+        }
+
+        api.PushString(result);
+        return 1;
+    }
+
+    int Unpack(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        luna::Table *t = api.GetTable(0);
+        long long i = 0;
+        long long j = 0;
+        auto size = static_cast<long long>(t->ArraySize());
+        if (!luna::GetOptInteger(api, 1, 1, &i) ||
+            !luna::GetOptInteger(api, 2, size, &j))
+            return 0;
+
+        if (i > j)
+            return 0;
+
+        long long count = j - i + 1;
+        if (count >= INT_MAX || !api.CheckStack(static_cast<int>(count)))
+        {
+            api.ArgValueError(0, "has too many results to unpack");
+            return 0;
+        }
+
+        for (long long k = i; k <= j; ++k)
+            api.PushValue(GetIndexValue(t, static_cast<double>(k)));
+        return static_cast<int>(count);
+    }
+
+    int Move(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 4)
+        {
+            api.ArgCountError(4);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        long long f = 0;
+        long long e = 0;
+        long long t = 0;
+        if (!luna::GetIntegerArg(api, 1, &f) ||
+            !luna::GetIntegerArg(api, 2, &e) ||
+            !luna::GetIntegerArg(api, 3, &t))
+            return 0;
+
+        luna::Table *a1 = api.GetTable(0);
+        luna::Table *a2 = a1;
+        if (params >= 5 && api.GetValueType(4) != luna::ValueT_Nil)
+        {
+            if (!api.IsTable(4))
+            {
+                api.ArgTypeError(4, luna::ValueT_Table);
+                return 0;
+            }
+            a2 = api.GetTable(4);
+        }
+
+        if (!CheckWritable(api, a1 == a2 ? 0 : 4, a2))
+            return 0;
+
+        if (e >= f)
+        {
+            if (f <= 0 && e >= f + kMaxInteger)
+            {
+                api.ArgValueError(2, "has too many elements to move");
+                return 0;
+            }
+
+            long long n = e - f + 1;
+            if (t > kMaxInteger - n + 1)
+            {
+                api.ArgValueError(3, "makes destination wrap around");
+                return 0;
+            }
+
+            // Move backward when ranges are overlapped
+            if (t > e || t <= f || a1 != a2)
+            {
+                for (long long k = 0; k < n; ++k)
+                    SetIndexValue(a2, static_cast<double>(t + k),
+                                  GetIndexValue(a1, static_cast<double>(f + k)));
+            }
+            else
+            {
+                for (long long k = n - 1; k >= 0; --k)
+                    SetIndexValue(a2, static_cast<double>(t + k),
+                                  GetIndexValue(a1, static_cast<double>(f + k)));
+            }
+            CHECK_BARRIER(state->GetGC(), a2);
+        }
+
+        api.PushTable(a2);
+        return 1;
+    }
+
+    // Sorter for continuous array, compares elements by 'less'.
+    template<typename T, typename LessType>
+    class ArraySorter
+    {
+    public:
+        ArraySorter(T *array, LessType less)
+            : array_(array), less_(less) { }
+
+        bool Less(std::size_t i, std::size_t j)
+        { return less_(array_[i], array_[j]); }
+
+        void Swap(std::size_t i, std::size_t j)
+        { std::swap(array_[i], array_[j]); }
+
+    private:
+        T *array_;
+        LessType less_;
+    };
+
+    template<typename T, typename LessType>
+    ArraySorter<T, LessType> MakeArraySorter(T *array, LessType less)
+    {
+        return ArraySorter<T, LessType>(array, less);
+    }
+
+    // Sorter for table array part, the table is accessed by index
+    // every time, so comparison which calls functions can not break
+    // the sorter.
+    class TableSorter
+    {
+    public:
+        TableSorter(luna::StackAPI &api, luna::Table *t)
+            : api_(api), table_(t) { }
+
+        void Swap(std::size_t i, std::size_t j)
+        {
+            luna::Value vi = GetIndexValue(table_, i + 1);
+            luna::Value vj = GetIndexValue(table_, j + 1);
+            SetIndexValue(table_, i + 1, vj);
+            SetIndexValue(table_, j + 1, vi);
+        }
+
+    protected:
+        // Call 'f' with 'l' and 'r', return the result is true or not
+        bool CallLess(const luna::Value &f, const luna::Value &l,
+                      const luna::Value &r)
+        {
+            api_.PushValue(f);
+            api_.PushValue(l);
+            api_.PushValue(r);
+            api_.Call(2, 1);
+
+            bool less = !api_.GetValue(-1)->IsFalse();
+            api_.PopValue(1);
+            return less;
+        }
+
+        luna::StackAPI &api_;
+        luna::Table *table_;
+    };
+
+    // Sorter compares elements by calling comparator function.
+    class FunctionSorter : public TableSorter
+    {
+    public:
+        FunctionSorter(luna::StackAPI &api, luna::Table *t,
+                       const luna::Value &comp)
+            : TableSorter(api, t), comp_(comp) { }
+
+        bool Less(std::size_t i, std::size_t j)
+        {
+            return CallLess(comp_, GetIndexValue(table_, i + 1),
+                            GetIndexValue(table_, j + 1));
+        }
+
+    private:
+        luna::Value comp_;
+    };
+
+    // Sorter compares elements like '<' operator, values which are not
+    // both numbers or both strings are compared by '__lt' metamethod.
+    // Values which can not be compared are less than nothing, and it is
+    // reported after sorting.
+    class MetaSorter : public TableSorter
+    {
+    public:
+        MetaSorter(luna::StackAPI &api, luna::State *state, luna::Table *t)
+            : TableSorter(api, t), state_(state), failed_(false) { }
+
+        bool Less(std::size_t i, std::size_t j)
+        {
+            luna::Value l = GetIndexValue(table_, i + 1);
+            luna::Value r = GetIndexValue(table_, j + 1);
+            if (l.type_ == luna::ValueT_Number && r.type_ == luna::ValueT_Number)
+                return l.num_ < r.num_;
+            if (l.type_ == luna::ValueT_String && r.type_ == luna::ValueT_String)
+                return *l.str_ < *r.str_;
+
+            luna::Value method;
+            if (!GetLessMethod(l, &method) && !GetLessMethod(r, &method))
+            {
+                failed_ = true;
+                return false;
+            }
+            return CallLess(method, l, r);
+        }
+
+        bool IsFailed() const
+        { return failed_; }
+
+    private:
+        bool GetLessMethod(const luna::Value &v, luna::Value *method)
+        {
+            if (v.type_ != luna::ValueT_Table || !v.table_->GetMetatable())
+                return false;
+
+            auto metatable = v.table_->GetMetatable();
+            if (metatable->IsMetaEventAbsent(luna::MetaEvent_Lt))
+                return false;
+
+            auto name = state_->GetMetaEventName(luna::MetaEvent_Lt);
+            *method = metatable->GetMetamethod(luna::MetaEvent_Lt, name);
+            return method->type_ != luna::ValueT_Nil;
+        }
+
+        luna::State *state_;
+        bool failed_;
+    };
+
+    const std::size_t kInsertionSortThreshold = 16;
+
+    template<typename Sorter>
+    void InsertionSort(Sorter &sorter, std::size_t lo, std::size_t hi)
+    {
+        for (std::size_t i = lo + 1; i <= hi; ++i)
+        {
+            for (std::size_t j = i; j > lo && sorter.Less(j, j - 1); --j)
+                sorter.Swap(j, j - 1);
+        }
+    }
+
+    template<typename Sorter>
+    void SiftDown(Sorter &sorter, std::size_t lo, std::size_t root, std::size_t size)
+    {
+        while (true)
+        {
+            std::size_t child = 2 * root + 1;
+            if (child >= size)
+                break;
+            if (child + 1 < size && sorter.Less(lo + child, lo + child + 1))
+                ++child;
+            if (!sorter.Less(lo + root, lo + child))
+                break;
+            sorter.Swap(lo + root, lo + child);
+            root = child;
+        }
+    }
+
+    template<typename Sorter>
+    void HeapSort(Sorter &sorter, std::size_t lo, std::size_t hi)
+    {
+        std::size_t size = hi - lo + 1;
+        for (std::size_t i = size / 2; i > 0; --i)
+            SiftDown(sorter, lo, i - 1, size);
+
+        for (std::size_t end = size - 1; end > 0; --end)
+        {
+            sorter.Swap(lo, lo + end);
+            SiftDown(sorter, lo, 0, end);
+        }
+    }
+
+    // Partition [lo, hi] by median of three pivot, return the final
+    // position of pivot. All scans are bounded, so an inconsistent
+    // comparator can not make them out of range.
+    template<typename Sorter>
+    std::size_t Partition(Sorter &sorter, std::size_t lo, std::size_t hi)
+    {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (sorter.Less(mid, lo))
+            sorter.Swap(mid, lo);
+        if (sorter.Less(hi, lo))
+            sorter.Swap(hi, lo);
+        if (sorter.Less(hi, mid))
+            sorter.Swap(hi, mid);
+        sorter.Swap(lo, mid);
+
+        std::size_t i = lo;
+        std::size_t j = hi + 1;
+        while (true)
+        {
+            while (sorter.Less(++i, lo))
+                if (i == hi) break;
+            while (sorter.Less(lo, --j))
+                if (j == lo) break;
+            if (i >= j)
+                break;
+            sorter.Swap(i, j);
+        }
+
+        sorter.Swap(lo, j);
+        return j;
+    }
+
+    // Introsort: quick sort which switches to heap sort when the
+    // recursion is too deep, and insertion sort for small ranges.
+    template<typename Sorter>
+    void IntroSort(Sorter &sorter, std::size_t lo, std::size_t hi, int depth)
+    {
+        while (lo < hi && hi - lo > kInsertionSortThreshold)
+        {
+            if (depth-- == 0)
+            {
+                HeapSort(sorter, lo, hi);
+                return ;
+            }
+
+            // Recurse into smaller part and loop on larger part
+            std::size_t p = Partition(sorter, lo, hi);
+            if (p - lo < hi - p)
+            {
+                if (p > lo)
+                    IntroSort(sorter, lo, p - 1, depth);
+                lo = p + 1;
+            }
+            else
+            {
+                IntroSort(sorter, p + 1, hi, depth);
+                hi = p - 1;
+            }
+        }
+
+        if (lo < hi)
+            InsertionSort(sorter, lo, hi);
+    }
+
+    template<typename Sorter>
+    void IntroSort(Sorter &sorter, std::size_t size)
+    {
+        int depth = 0;
+        for (std::size_t n = size; n > 1; n >>= 1)
+            depth += 2;
+        IntroSort(sorter, 0, size - 1, depth);
+    }
+
+    int Sort(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        bool has_comp = params >= 2 && api.GetValueType(1) != luna::ValueT_Nil;
+        if (has_comp && !api.IsClosure(1) && !api.IsCFunction(1))
+        {
+            api.ArgTypeError(1, luna::ValueT_Closure);
+            return 0;
+        }
+
+        luna::Table *t = api.GetTable(0);
+        if (!CheckWritable(api, 0, t))
+            return 0;
+
+        std::size_t size = t->ArraySize();
+        if (size < 2)
+            return 0;
+
+        if (has_comp)
+        {
+            FunctionSorter sorter(api, t, *api.GetValue(1));
+            IntroSort(sorter, size);
+        }
+        else if (double *nums = t->GetNumberArray())
+        {
+            // Fast path of packed number array
+            auto sorter = MakeArraySorter(nums, [](double l, double r) {
+                return l < r;
+            });
+            IntroSort(sorter, size);
+        }
+        else
+        {
+            // Fast path of boxed array, all values must be numbers or
+            // all values must be strings
+            luna::Value *values = t->GetValueArray();
+            luna::ValueT type = values[0].type_;
+            for (std::size_t i = 1; i < size; ++i)
+            {
+                if (values[i].type_ != type)
+                {
+                    type = luna::ValueT_Nil;
+                    break;
+                }
+            }
+
+            if (type == luna::ValueT_Number)
+            {
+                auto sorter = MakeArraySorter(values, [](const luna::Value &l,
+                                                         const luna::Value &r) {
+                    return l.num_ < r.num_;
+                });
+                IntroSort(sorter, size);
+            }
+            else if (type == luna::ValueT_String)
+            {
+                auto sorter = MakeArraySorter(values, [](const luna::Value &l,
+                                                         const luna::Value &r) {
+                    return *l.str_ < *r.str_;
+                });
+                IntroSort(sorter, size);
+            }
+            else
+            {
+                MetaSorter sorter(api, state, t);
+                IntroSort(sorter, size);
+                if (sorter.IsFailed())
+                    api.ArgValueError(0, "has values which can not be compared");
+            }
+        }
+
+        return 0;
+    }
+
+    int Freeze(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        // Entries of weak table are removed by GC
+        luna::Table *t = api.GetTable(0);
+        if (t->GetWeakMode() != luna::WeakMode_None)
+        {
+            api.ArgValueError(0, "is a weak table");
+            return 0;
+        }
+
+        t->Freeze();
+        api.PushTable(t);
+        return 1;
+    }
+
+    int IsFrozen(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+        if (params < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsTable(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_Table);
+            return 0;
+        }
+
+        api.PushBool(api.GetTable(0)->IsFrozen());
+        return 1;
+    }
+
+    void RegisterLibTable(luna::State *state)
+    {
+        luna::Library lib(state);
+        luna::TableFuncReg table[] = {
+            { "insert", Insert },
+            { "remove", Remove },
+            { "concat", Concat },
+            { "sort", Sort },
+            { "unpack", Unpack },
+            { "move", Move },
+            { "freeze", Freeze },
+            { "isfrozen", IsFrozen }
+        };
+        lib.RegisterTableFunction("table", table);
+    }
+
+} // namespace table
+} // namespace lib
@@ -0,0 +1,14 @@
+#ifndef LIB_TABLE_H
+#define LIB_TABLE_H
+
+#include "LibAPI.h"
+
+namespace lib {
+namespace table {
+
+    void RegisterLibTable(luna::State *state);
+
+} // namespace table
+} // namespace lib
+
+#endif // LIB_TABLE_H
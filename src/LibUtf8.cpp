@@ -0,0 +1,502 @@
+#include "LibUtf8.h"
+#include "State.h"
+#include "String.h"
+#include <string>
+#include <math.h>
+#include <string.h>
+
+namespace lib {
+namespace utf8 {
+
+    const unsigned int kMaxCodePoint = 0x10FFFF;
+
+    inline bool IsContinuation(const char *s)
+    {
+        return (static_cast<unsigned char>(*s) & 0xC0) == 0x80;
+    }
+
+    // Decode one character at 's' which is before 'end', return the
+    // end of the character, or nullptr when it is invalid. Overlong
+    // forms, surrogates and code points beyond 0x10FFFF are invalid.
+    const char * Decode(const char *s, const char *end, unsigned int *code)
+    {
+        auto c = static_cast<unsigned char>(s[0]);
+        if (c < 0x80)
+        {
+            *code = c;
+            return s + 1;
+        }
+
+        int count = 0;
+        unsigned int min = 0;
+        if (c >= 0xC2 && c < 0xE0)
+        {
+            count = 1;
+            *code = c & 0x1F;
+            min = 0x80;
+        }
+        else if (c >= 0xE0 && c < 0xF0)
+        {
+            count = 2;
+            *code = c & 0x0F;
+            min = 0x800;
+        }
+        else if (c >= 0xF0 && c < 0xF5)
+        {
+            count = 3;
+            *code = c & 0x07;
+            min = 0x10000;
+        }
+        else
+        {
+            return nullptr;
+        }
+
+        if (end - s <= count)
+            return nullptr;
+
+        for (int i = 1; i <= count; ++i)
+        {
+            if (!IsContinuation(s + i))
+                return nullptr;
+            *code = (*code << 6) | (static_cast<unsigned char>(s[i]) & 0x3F);
+        }
+
+        if (*code < min || *code > kMaxCodePoint ||
+            (*code >= 0xD800 && *code <= 0xDFFF))
+            return nullptr;
+        return s + count + 1;
+    }
+
+    // Encode 'code' to 'buffer', return count of bytes
+    std::size_t Encode(unsigned int code, char *buffer)
+    {
+        if (code < 0x80)
+        {
+            buffer[0] = static_cast<char>(code);
+            return 1;
+        }
+
+        if (code < 0x800)
+        {
+            buffer[0] = static_cast<char>(0xC0 | (code >> 6));
+            buffer[1] = static_cast<char>(0x80 | (code & 0x3F));
+            return 2;
+        }
+
+        if (code < 0x10000)
+        {
+            buffer[0] = static_cast<char>(0xE0 | (code >> 12));
+            buffer[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            buffer[2] = static_cast<char>(0x80 | (code & 0x3F));
+            return 3;
+        }
+
+        buffer[0] = static_cast<char>(0xF0 | (code >> 18));
+        buffer[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        buffer[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        buffer[3] = static_cast<char>(0x80 | (code & 0x3F));
+        return 4;
+    }
+
+    // Get length of the character at 's' which is before 'end', return
+    // 0 when it is invalid. It accepts the same characters as Decode.
+    inline std::size_t CharLength(const char *s, const char *end)
+    {
+        auto c = static_cast<unsigned char>(s[0]);
+        if (c < 0x80)
+            return 1;
+
+        auto avail = end - s;
+        if (c < 0xC2 || c > 0xF4 || avail < 2)
+            return 0;
+
+        auto c1 = static_cast<unsigned char>(s[1]);
+        if (c < 0xE0)
+            return (c1 & 0xC0) == 0x80 ? 2 : 0;
+
+        // Second byte range excludes overlong forms, surrogates and
+        // code points beyond 0x10FFFF
+        if (c < 0xF0)
+        {
+            unsigned char low = c == 0xE0 ? 0xA0 : 0x80;
+            unsigned char high = c == 0xED ? 0x9F : 0xBF;
+            return avail >= 3 && c1 >= low && c1 <= high &&
+                IsContinuation(s + 2) ? 3 : 0;
+        }
+
+        unsigned char low = c == 0xF0 ? 0x90 : 0x80;
+        unsigned char high = c == 0xF4 ? 0x8F : 0xBF;
+        return avail >= 4 && c1 >= low && c1 <= high &&
+            IsContinuation(s + 2) && IsContinuation(s + 3) ? 4 : 0;
+    }
+
+    // Words of eight ASCII bytes are counted with one test. In other
+    // words, ASCII bytes before the first non ASCII byte are skipped,
+    // then the run of non ASCII characters is validated by their
+    // lengths.
+    const char * CountChars(const char *s, const char *limit,
+                            const char *end, std::size_t *count)
+    {
+        typedef unsigned long long Word;
+        const Word high = 0x8080808080808080ULL;
+
+        std::size_t n = 0;
+        while (s < limit)
+        {
+            if (limit - s >= static_cast<std::ptrdiff_t>(sizeof(Word)))
+            {
+                Word w;
+                memcpy(&w, s, sizeof(w));
+                if (!(w & high))
+                {
+                    s += sizeof(Word);
+                    n += sizeof(Word);
+                    continue;
+                }
+
+                while (!(static_cast<unsigned char>(*s) & 0x80))
+                {
+                    ++s;
+                    ++n;
+                }
+            }
+
+            do
+            {
+                auto len = CharLength(s, end);
+                if (len == 0)
+                {
+                    *count = n;
+                    return s;
+                }
+                s += len;
+                ++n;
+            } while (s < limit && (static_cast<unsigned char>(*s) & 0x80));
+        }
+
+        *count = n;
+        return nullptr;
+    }
+
+    int Char(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        int params = api.GetStackSize();
+
+        std::string result;
+        for (int i = 0; i < params; ++i)
+        {
+            long long code = 0;
+            if (!luna::GetIntegerArg(api, i, &code))
+                return 0;
+
+            if (code < 0 || code > kMaxCodePoint)
+            {
+                api.ArgValueError(i, "is value out of range");
+                return 0;
+            }
+
+            char buffer[4];
+            auto len = Encode(static_cast<unsigned int>(code), buffer);
+            result.append(buffer, len);
+        }
+
+        api.PushString(result.data(), result.size());
+        return 1;
+    }
+
+    int CodePoint(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsString(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_String);
+            return 0;
+        }
+
+        auto str = api.GetString(0);
+        std::size_t len = str->GetLength();
+        long long i = 0;
+        long long j = 0;
+        if (!luna::GetOptInteger(api, 1, 1, &i))
+            return 0;
+        i = luna::RelativePosition(i, len);
+        if (!luna::GetOptInteger(api, 2, i, &j))
+            return 0;
+        j = luna::RelativePosition(j, len);
+
+        if (i < 1)
+        {
+            api.ArgValueError(1, "is out of range");
+            return 0;
+        }
+        if (j > static_cast<long long>(len))
+        {
+            api.ArgValueError(2, "is out of range");
+            return 0;
+        }
+        if (i > j)
+            return 0;
+
+        const char *s = str->GetCStr();
+        const char *end = s + len;
+        const char *p = s + static_cast<std::size_t>(i) - 1;
+        const char *limit = s + static_cast<std::size_t>(j);
+
+        int count = 0;
+        while (p < limit)
+        {
+            unsigned int code = 0;
+            p = Decode(p, end, &code);
+            if (!p)
+            {
+                api.ArgValueError(0, "has invalid UTF-8 code");
+                return 0;
+            }
+
+            if (!api.CheckStack(1))
+            {
+                api.ArgValueError(0, "has too many characters");
+                return 0;
+            }
+            api.PushNumber(code);
+            ++count;
+        }
+        return count;
+    }
+
+    int Len(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsString(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_String);
+            return 0;
+        }
+
+        auto str = api.GetString(0);
+        std::size_t len = str->GetLength();
+        long long i = 0;
+        long long j = 0;
+        if (!luna::GetOptInteger(api, 1, 1, &i) ||
+            !luna::GetOptInteger(api, 2, -1, &j))
+            return 0;
+        i = luna::RelativePosition(i, len);
+        j = luna::RelativePosition(j, len);
+
+        auto size = static_cast<long long>(len);
+        if (i < 1 || i > size + 1)
+        {
+            api.ArgValueError(1, "is initial position out of string");
+            return 0;
+        }
+        if (j > size)
+        {
+            api.ArgValueError(2, "is final position out of string");
+            return 0;
+        }
+
+        const char *s = str->GetCStr();
+        const char *begin = s + static_cast<std::size_t>(i) - 1;
+        const char *limit = j < i ? begin : s + static_cast<std::size_t>(j);
+
+        std::size_t count = 0;
+        auto invalid = CountChars(begin, limit, s + len, &count);
+        if (invalid)
+        {
+            // Return nil and position of the first invalid byte
+            api.PushNil();
+            api.PushNumber(static_cast<double>(invalid - s + 1));
+            return 2;
+        }
+
+        api.PushNumber(static_cast<double>(count));
+        return 1;
+    }
+
+    int Offset(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 2)
+        {
+            api.ArgCountError(2);
+            return 0;
+        }
+
+        if (!api.IsString(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_String);
+            return 0;
+        }
+
+        long long n = 0;
+        if (!luna::GetIntegerArg(api, 1, &n))
+            return 0;
+
+        auto str = api.GetString(0);
+        std::size_t len = str->GetLength();
+        auto size = static_cast<long long>(len);
+        long long i = 0;
+        if (!luna::GetOptInteger(api, 2, n >= 0 ? 1 : size + 1, &i))
+            return 0;
+        i = luna::RelativePosition(i, len);
+        if (i < 1 || i > size + 1)
+        {
+            api.ArgValueError(2, "is position out of range");
+            return 0;
+        }
+
+        // String is terminated by zero, so s[len] is not a continuation
+        const char *s = str->GetCStr();
+        std::size_t pos = static_cast<std::size_t>(i) - 1;
+        if (n == 0)
+        {
+            // Find the beginning of the character which contains 'pos'
+            while (pos > 0 && IsContinuation(s + pos))
+                --pos;
+            api.PushNumber(static_cast<double>(pos + 1));
+            return 1;
+        }
+
+        if (IsContinuation(s + pos))
+        {
+            api.ArgValueError(2, "is a continuation byte");
+            return 0;
+        }
+
+        if (n < 0)
+        {
+            for (; n < 0 && pos > 0; ++n)
+            {
+                do
+                {
+                    --pos;
+                } while (pos > 0 && IsContinuation(s + pos));
+            }
+        }
+        else
+        {
+            for (--n; n > 0 && pos < len; --n)
+            {
+                do
+                {
+                    ++pos;
+                } while (IsContinuation(s + pos));
+            }
+        }
+
+        if (n == 0)
+            api.PushNumber(static_cast<double>(pos + 1));
+        else
+            api.PushNil();
+        return 1;
+    }
+
+    // Iterator function of utf8.codes, which returns position and code
+    // of the character after the one at position of argument 2
+    int DoCodes(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 2)
+        {
+            api.ArgCountError(2);
+            return 0;
+        }
+
+        if (!api.IsString(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_String);
+            return 0;
+        }
+
+        if (!api.IsNumber(1))
+        {
+            api.ArgTypeError(1, luna::ValueT_Number);
+            return 0;
+        }
+
+        auto str = api.GetString(0);
+        const char *s = str->GetCStr();
+        std::size_t len = str->GetLength();
+        double n = floor(api.GetNumber(1));
+
+        // Skip the current character
+        std::size_t pos = 0;
+        if (n > 0 && n <= len)
+        {
+            pos = static_cast<std::size_t>(n);
+            while (IsContinuation(s + pos))
+                ++pos;
+        }
+        else if (n > len)
+        {
+            pos = len;
+        }
+
+        if (pos >= len)
+            return 0;
+
+        unsigned int code = 0;
+        auto next = Decode(s + pos, s + len, &code);
+        if (!next)
+        {
+            api.ArgValueError(0, "has invalid UTF-8 code");
+            return 0;
+        }
+
+        api.PushNumber(static_cast<double>(pos + 1));
+        api.PushNumber(code);
+        return 2;
+    }
+
+    // utf8.codes returns the iterator function, the string and 0,
+    // for generic for
+    int Codes(luna::State *state)
+    {
+        luna::StackAPI api(state);
+        if (api.GetStackSize() < 1)
+        {
+            api.ArgCountError(1);
+            return 0;
+        }
+
+        if (!api.IsString(0))
+        {
+            api.ArgTypeError(0, luna::ValueT_String);
+            return 0;
+        }
+
+        api.PushCFunction(DoCodes);
+        api.PushValue(*api.GetValue(0));
+        api.PushNumber(0);
+        return 3;
+    }
+
+    void RegisterLibUtf8(luna::State *state)
+    {
+        luna::Library lib(state);
+        luna::TableFuncReg utf8[] = {
+            { "char", Char },
+            { "codepoint", CodePoint },
+            { "len", Len },
+            { "offset", Offset },
+            { "codes", Codes }
+        };
+        lib.RegisterTableFunction("utf8", utf8);
+    }
+
+} // namespace utf8
+} // namespace lib
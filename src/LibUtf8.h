@@ -0,0 +1,20 @@
+#ifndef LIB_UTF8_H
+#define LIB_UTF8_H
+
+#include "LibAPI.h"
+
+namespace lib {
+namespace utf8 {
+
+    void RegisterLibUtf8(luna::State *state);
+
+    // Count UTF-8 characters which start in [s, limit), characters
+    // may end in [limit, end). Return nullptr when all of them are
+    // valid, otherwise return the first invalid byte.
+    const char * CountChars(const char *s, const char *limit,
+                            const char *end, std::size_t *count);
+
+} // namespace utf8
+} // namespace lib
+
+#endif // LIB_UTF8_H
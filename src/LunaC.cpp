@@ -5,6 +5,8 @@
 #include "LibBase.h"
 #include "LibMath.h"
 #include "LibString.h"
+#include "LibTable.h"
+#include "LibUtf8.h"
 #include <stdio.h>
 
 int main(int argc, const char **argv)
@@ -24,6 +26,8 @@ int main(int argc, const char **argv)
         lib::base::RegisterLibBase(&state);
         lib::math::RegisterLibMath(&state);
         lib::string::RegisterLibString(&state);
+        lib::table::RegisterLibTable(&state);
+        lib::utf8::RegisterLibUtf8(&state);
 
         state.LoadModule(argv[1]);
         bootstrap.Prepare();
@@ -23,10 +23,23 @@ namespace luna
 
         Lexer lexer(state_, state_->GetString(module_name),
                     [&is] () { return is.GetChar(); });
+        Load(&lexer);
+    }
+
+    void ModuleManager::LoadString(const std::string &script_str,
+                                   const std::string &name)
+    {
+        io::text::InStringStream is(script_str);
+        Lexer lexer(state_, state_->GetString(name),
+                    [&is] () { return is.GetChar(); });
+        Load(&lexer);
+    }
 
+    void ModuleManager::Load(Lexer *lexer)
+    {
         // Parse to AST
         Parser parser;
-        auto ast = parser.Parse(&lexer);
+        auto ast = parser.Parse(lexer);
 
         // Semantic analysis
         SemanticAnalysis(ast.get(), state_);
@@ -6,6 +6,7 @@
 namespace luna
 {
     class State;
+    class Lexer;
 
     class ModuleManager
     {
@@ -18,7 +19,13 @@ namespace luna
         void AddModulePath(const std::string &path) { }
         void LoadModule(const std::string &module_name);
 
+        // Load script string, 'name' is module name of the script
+        void LoadString(const std::string &script_str, const std::string &name);
+
     private:
+        // Parse and generate code from lexer
+        void Load(Lexer *lexer);
+
         State *state_;
     };
 } // namespace luna
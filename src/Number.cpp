@@ -0,0 +1,673 @@
+#include "Number.h"
+#include <string>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace luna
+{
+namespace
+{
+    typedef unsigned long long Word;
+
+    const Word kPow10[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+        10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+        100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+        100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+        100000000000000000ULL, 1000000000000000000ULL,
+        10000000000000000000ULL
+    };
+
+    // Two digits of 00 - 99
+    const char kDigits[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    // Write digits of 'n' to 'buffer', return the count of digits
+    std::size_t WriteInteger(Word n, char *buffer)
+    {
+        char temp[24];
+        char *p = temp + sizeof(temp);
+        while (n >= 100)
+        {
+            auto i = (n % 100) * 2;
+            n /= 100;
+            *--p = kDigits[i + 1];
+            *--p = kDigits[i];
+        }
+
+        if (n >= 10)
+        {
+            *--p = kDigits[n * 2 + 1];
+            *--p = kDigits[n * 2];
+        }
+        else
+        {
+            *--p = static_cast<char>('0' + n);
+        }
+
+        std::size_t len = temp + sizeof(temp) - p;
+        memcpy(buffer, p, len);
+        return len;
+    }
+
+    // Floating point number f * 2^e with 64 bits significand
+    struct DiyFp
+    {
+        Word f_;
+        int e_;
+
+        DiyFp(Word f, int e) : f_(f), e_(e) { }
+
+        explicit DiyFp(double d)
+        {
+            Word bits = 0;
+            memcpy(&bits, &d, sizeof(bits));
+            int biased_e = static_cast<int>((bits >> 52) & 0x7FF);
+            Word significand = bits & kFractionMask;
+            if (biased_e != 0)
+            {
+                f_ = significand + kHiddenBit;
+                e_ = biased_e - kExponentBias;
+            }
+            else
+            {
+                f_ = significand;
+                e_ = 1 - kExponentBias;
+            }
+        }
+
+        DiyFp operator - (const DiyFp &rhs) const
+        {
+            return DiyFp(f_ - rhs.f_, e_);
+        }
+
+        // Upper 64 bits of the product, rounded
+        DiyFp operator * (const DiyFp &rhs) const
+        {
+            const Word mask = 0xFFFFFFFFULL;
+            Word a = f_ >> 32;
+            Word b = f_ & mask;
+            Word c = rhs.f_ >> 32;
+            Word d = rhs.f_ & mask;
+            Word ac = a * c;
+            Word bc = b * c;
+            Word ad = a * d;
+            Word bd = b * d;
+            Word tmp = (bd >> 32) + (ad & mask) + (bc & mask);
+            tmp += 1ULL << 31;
+            return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32),
+                         e_ + rhs.e_ + 64);
+        }
+
+        DiyFp Normalize() const
+        {
+            DiyFp res = *this;
+            while (!(res.f_ & (1ULL << 63)))
+            {
+                res.f_ <<= 1;
+                --res.e_;
+            }
+            return res;
+        }
+
+        DiyFp NormalizeBoundary() const
+        {
+            DiyFp res = *this;
+            while (!(res.f_ & (kHiddenBit << 1)))
+            {
+                res.f_ <<= 1;
+                --res.e_;
+            }
+            res.f_ <<= 64 - 52 - 2;
+            res.e_ -= 64 - 52 - 2;
+            return res;
+        }
+
+        // Boundaries of the interval which rounds to this number
+        void NormalizedBoundaries(DiyFp *minus, DiyFp *plus) const
+        {
+            DiyFp pl = DiyFp((f_ << 1) + 1, e_ - 1).NormalizeBoundary();
+            DiyFp mi = f_ == kHiddenBit ?
+                DiyFp((f_ << 2) - 1, e_ - 2) : DiyFp((f_ << 1) - 1, e_ - 1);
+            mi.f_ <<= mi.e_ - pl.e_;
+            mi.e_ = pl.e_;
+            *minus = mi;
+            *plus = pl;
+        }
+
+        static const int kExponentBias = 0x3FF + 52;
+        static const Word kFractionMask = 0x000FFFFFFFFFFFFFULL;
+        static const Word kHiddenBit = 0x0010000000000000ULL;
+    };
+
+    // Normalized 10^K for K = -348, -340, ..., 340
+    const Word kCachedPowersF[] = {
+        0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+        0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+        0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+        0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+        0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+        0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+        0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+        0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+        0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+        0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+        0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+        0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+        0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+        0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+        0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+        0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+        0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+        0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+        0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+        0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+        0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+        0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+        0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+        0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+        0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+        0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+        0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+        0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+        0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+    };
+
+    const short kCachedPowersE[] = {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+        -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+        -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+        -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+        -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+        109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+        375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+        641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+        907, 933, 960, 986, 1013, 1039, 1066,
+    };
+
+    // Get cached power 10^-K which scales 2^e into [2^-60, 2^-32]
+    DiyFp GetCachedPower(int e, int *K)
+    {
+        double dk = (-61 - e) * 0.30102999566398114 + 347;
+        int k = static_cast<int>(dk);
+        if (dk - k > 0.0)
+            ++k;
+
+        unsigned int index = static_cast<unsigned int>((k >> 3) + 1);
+        *K = -(-348 + static_cast<int>(index << 3));
+        return DiyFp(kCachedPowersF[index], kCachedPowersE[index]);
+    }
+
+    std::size_t CountDecimalDigit(unsigned int n)
+    {
+        std::size_t count = 1;
+        while (count < 10 && n >= kPow10[count])
+            ++count;
+        return count;
+    }
+
+    void GrisuRound(char *buffer, std::size_t len, Word delta, Word rest,
+                    Word ten_kappa, Word wp_w)
+    {
+        while (rest < wp_w && delta - rest >= ten_kappa &&
+               (rest + ten_kappa < wp_w ||
+                wp_w - rest > rest + ten_kappa - wp_w))
+        {
+            --buffer[len - 1];
+            rest += ten_kappa;
+        }
+    }
+
+    // Generate the shortest digits in [Mp - delta, Mp] which is close
+    // to W, the number is digits * 10^K
+    void DigitGen(const DiyFp &W, const DiyFp &Mp, Word delta,
+                  char *buffer, std::size_t *len, int *K)
+    {
+        const DiyFp one(1ULL << -Mp.e_, Mp.e_);
+        const DiyFp wp_w = Mp - W;
+        auto p1 = static_cast<unsigned int>(Mp.f_ >> -one.e_);
+        Word p2 = Mp.f_ & (one.f_ - 1);
+        int kappa = static_cast<int>(CountDecimalDigit(p1));
+        *len = 0;
+
+        while (kappa > 0)
+        {
+            auto pow10 = static_cast<unsigned int>(kPow10[kappa - 1]);
+            unsigned int d = p1 / pow10;
+            p1 %= pow10;
+            if (d || *len)
+                buffer[(*len)++] = static_cast<char>('0' + d);
+            --kappa;
+
+            Word tmp = (static_cast<Word>(p1) << -one.e_) + p2;
+            if (tmp <= delta)
+            {
+                *K += kappa;
+                GrisuRound(buffer, *len, delta, tmp,
+                           kPow10[kappa] << -one.e_, wp_w.f_);
+                return ;
+            }
+        }
+
+        for (;;)
+        {
+            p2 *= 10;
+            delta *= 10;
+            auto d = static_cast<char>(p2 >> -one.e_);
+            if (d || *len)
+                buffer[(*len)++] = static_cast<char>('0' + d);
+            p2 &= one.f_ - 1;
+            --kappa;
+
+            if (p2 < delta)
+            {
+                *K += kappa;
+                int index = -kappa;
+                GrisuRound(buffer, *len, delta, p2, one.f_,
+                           wp_w.f_ * (index < 20 ? kPow10[index] : 0));
+                return ;
+            }
+        }
+    }
+
+    // Grisu2 algorithm, 'value' is positive, generated number is
+    // digits * 10^K and reads back to 'value'
+    void Grisu2(double value, char *buffer, std::size_t *len, int *K)
+    {
+        const DiyFp v(value);
+        DiyFp w_m(0, 0), w_p(0, 0);
+        v.NormalizedBoundaries(&w_m, &w_p);
+
+        const DiyFp c_mk = GetCachedPower(w_p.e_, K);
+        const DiyFp W = v.Normalize() * c_mk;
+        DiyFp Wp = w_p * c_mk;
+        DiyFp Wm = w_m * c_mk;
+        ++Wm.f_;
+        --Wp.f_;
+        DigitGen(W, Wp, Wp.f_ - Wm.f_, buffer, len, K);
+    }
+
+    // Exact powers of ten of double
+    const double kExactPow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const Word kMaxExactInteger = 1ULL << 53;
+
+    inline bool IsSpace(char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    inline bool IsDigit(char c)
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    // Value of digit 'c' in base 36, return 36 when it is not a digit
+    inline int DigitValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'z')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'Z')
+            return c - 'A' + 10;
+        return 36;
+    }
+
+    // Parse exponent digits after 'e' or 'p', return nullptr when there
+    // is no digit
+    const char * ParseExponent(const char *p, const char *end, int *exp)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        if (p >= end || !IsDigit(*p))
+            return nullptr;
+
+        int e = 0;
+        for (; p < end && IsDigit(*p); ++p)
+        {
+            if (e < 100000)
+                e = e * 10 + (*p - '0');
+        }
+        *exp = negative ? -e : e;
+        return p;
+    }
+
+    // Shift 'm' right by 'shift' bits, and round to nearest even
+    Word RoundShift(Word m, int shift)
+    {
+        if (shift >= 64)
+            return 0;
+
+        Word half = 1ULL << (shift - 1);
+        Word rest = m & ((half << 1) - 1);
+        m >>= shift;
+        if (rest > half || (rest == half && (m & 1)))
+            ++m;
+        return m;
+    }
+
+    // Parse hexadecimal number after "0x", significand digits beyond
+    // 60 bits only adjust the exponent and set a sticky bit, then the
+    // significand is rounded once to the precision of the result
+    const char * ParseHex(const char *p, const char *end, double *num)
+    {
+        Word m = 0;
+        int exp = 0;
+        bool any_digit = false;
+
+        for (; p < end && DigitValue(*p) < 16; ++p, any_digit = true)
+        {
+            if (!(m >> 56))
+                m = (m << 4) | DigitValue(*p);
+            else
+            {
+                exp += 4;
+                if (*p != '0')
+                    m |= 1;
+            }
+        }
+
+        if (p < end && *p == '.')
+        {
+            for (++p; p < end && DigitValue(*p) < 16; ++p, any_digit = true)
+            {
+                if (!(m >> 56))
+                {
+                    m = (m << 4) | DigitValue(*p);
+                    exp -= 4;
+                }
+                else if (*p != '0')
+                {
+                    m |= 1;
+                }
+            }
+        }
+
+        if (!any_digit)
+            return nullptr;
+
+        if (p < end && (*p == 'p' || *p == 'P'))
+        {
+            int e = 0;
+            p = ParseExponent(p + 1, end, &e);
+            if (!p)
+                return nullptr;
+            exp += e;
+        }
+
+        if (m == 0)
+        {
+            *num = 0.0;
+            return p;
+        }
+
+        // Lowest bit which the result keeps, 53 bits for normal numbers
+        // and less for subnormal numbers
+        int bits = 0;
+        while (bits < 64 && (m >> bits))
+            ++bits;
+        int low = std::max(exp + bits - 53, -1074);
+        if (exp < low)
+        {
+            m = RoundShift(m, low - exp);
+            exp = low;
+        }
+
+        // 'm' is at most 2^53 now, so the conversion and scaling are exact
+        *num = ldexp(static_cast<double>(m), exp);
+        return p;
+    }
+
+    // Parse decimal number, use exact double arithmetic when the
+    // significand and the power of ten are both exact, otherwise
+    // convert by strtod
+    const char * ParseDecimal(const char *p, const char *end, double *num)
+    {
+        const char *begin = p;
+        Word m = 0;
+        int digits = 0;
+        int exp = 0;
+        bool any_digit = false;
+
+        // Leading zeros are not significant
+        for (; p < end && *p == '0'; ++p)
+            any_digit = true;
+        for (; p < end && IsDigit(*p); ++p, ++digits)
+            m = m * 10 + (*p - '0');
+        any_digit = any_digit || digits > 0;
+
+        if (p < end && *p == '.')
+        {
+            ++p;
+            if (digits == 0)
+            {
+                for (; p < end && *p == '0'; ++p, --exp)
+                    any_digit = true;
+            }
+            for (; p < end && IsDigit(*p); ++p, ++digits, --exp)
+            {
+                m = m * 10 + (*p - '0');
+                any_digit = true;
+            }
+        }
+
+        if (!any_digit)
+            return nullptr;
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            int e = 0;
+            p = ParseExponent(p + 1, end, &e);
+            if (!p)
+                return nullptr;
+            exp += e;
+        }
+
+        // At most 19 digits can not overflow the significand
+        if (digits <= 19)
+        {
+            if (m == 0)
+            {
+                *num = 0.0;
+                return p;
+            }
+
+            // Move exponent into significand when it keeps exact
+            while (exp > 22 && m < kMaxExactInteger / 10)
+            {
+                m *= 10;
+                --exp;
+            }
+
+            if (m <= kMaxExactInteger && exp >= -22 && exp <= 22)
+            {
+                double d = static_cast<double>(m);
+                *num = exp < 0 ? d / kExactPow10[-exp] : d * kExactPow10[exp];
+                return p;
+            }
+        }
+
+        std::string str(begin, p);
+        *num = strtod(str.c_str(), nullptr);
+        return p;
+    }
+
+    std::size_t WriteExponent(int e, char *buffer)
+    {
+        char *p = buffer;
+        *p++ = 'e';
+        if (e < 0)
+        {
+            *p++ = '-';
+            e = -e;
+        }
+        else
+        {
+            *p++ = '+';
+        }
+
+        // At least two digits like printf
+        if (e < 10)
+            *p++ = '0';
+        p += WriteInteger(static_cast<Word>(e), p);
+        return p - buffer;
+    }
+
+    // Format digits * 10^K in fixed or scientific notation
+    std::size_t Prettify(char *buffer, std::size_t len, int K)
+    {
+        // Decimal exponent of the first digit
+        int exp10 = static_cast<int>(len) + K - 1;
+        if (exp10 < -4 || exp10 >= 17)
+        {
+            // d.ddde+XX
+            if (len == 1)
+                return 1 + WriteExponent(exp10, buffer + 1);
+
+            memmove(buffer + 2, buffer + 1, len - 1);
+            buffer[1] = '.';
+            return len + 1 + WriteExponent(exp10, buffer + len + 1);
+        }
+
+        if (K >= 0)
+        {
+            // dddd000
+            memset(buffer + len, '0', K);
+            return len + K;
+        }
+
+        int point = static_cast<int>(len) + K;
+        if (point > 0)
+        {
+            // dd.dd
+            memmove(buffer + point + 1, buffer + point, len - point);
+            buffer[point] = '.';
+            return len + 1;
+        }
+
+        // 0.000dddd
+        std::size_t zeros = static_cast<std::size_t>(2 - point);
+        memmove(buffer + zeros, buffer, len);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        memset(buffer + 2, '0', zeros - 2);
+        return len + zeros;
+    }
+} // namespace
+
+    std::size_t NumberToString(double num, char *buffer)
+    {
+        char *p = buffer;
+        if (isnan(num))
+        {
+            const char *nan = signbit(num) ? "-nan" : "nan";
+            std::size_t len = strlen(nan);
+            memcpy(p, nan, len + 1);
+            return len;
+        }
+
+        if (signbit(num))
+        {
+            *p++ = '-';
+            num = -num;
+        }
+
+        std::size_t len = 0;
+        if (isinf(num))
+        {
+            memcpy(p, "inf", 3);
+            len = 3;
+        }
+        else if (num == 0.0)
+        {
+            *p = '0';
+            len = 1;
+        }
+        else if (num < 9007199254740992.0 && floor(num) == num)
+        {
+            // Integers are exact, convert them directly
+            len = WriteInteger(static_cast<Word>(num), p);
+        }
+        else
+        {
+            int K = 0;
+            Grisu2(num, p, &len, &K);
+            len = Prettify(p, len, K);
+        }
+
+        p[len] = 0;
+        return p - buffer + len;
+    }
+
+    bool StringToNumber(const char *s, std::size_t len, double *num)
+    {
+        const char *p = s;
+        const char *end = s + len;
+        while (p < end && IsSpace(*p))
+            ++p;
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+
+        double value = 0.0;
+        if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+            p = ParseHex(p + 2, end, &value);
+        else
+            p = ParseDecimal(p, end, &value);
+        if (!p)
+            return false;
+
+        while (p < end && IsSpace(*p))
+            ++p;
+        if (p != end)
+            return false;
+
+        *num = negative ? -value : value;
+        return true;
+    }
+
+    bool StringToInteger(const char *s, std::size_t len, int base, double *num)
+    {
+        const char *p = s;
+        const char *end = s + len;
+        while (p < end && IsSpace(*p))
+            ++p;
+
+        bool negative = false;
+        if (p < end && *p == '-')
+        {
+            negative = true;
+            ++p;
+        }
+
+        if (p >= end || DigitValue(*p) >= base)
+            return false;
+
+        double value = 0.0;
+        for (; p < end; ++p)
+        {
+            int d = DigitValue(*p);
+            if (d >= base)
+                break;
+            value = value * base + d;
+        }
+
+        while (p < end && IsSpace(*p))
+            ++p;
+        if (p != end)
+            return false;
+
+        *num = negative ? -value : value;
+        return true;
+    }
+} // namespace luna
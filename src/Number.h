@@ -0,0 +1,30 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <cstddef>
+
+namespace luna
+{
+    // Buffer size which is enough for any number converted by
+    // NumberToString, including the terminating zero
+    const std::size_t kNumberBufferSize = 32;
+
+    // Convert 'num' to the shortest string which reads back to the same
+    // number, write it to 'buffer' of kNumberBufferSize bytes with a
+    // terminating zero and return its length. Integers are converted
+    // without exponent, other numbers are converted like "%.17g" but
+    // with the shortest digits. The result does not depend on locale.
+    std::size_t NumberToString(double num, char *buffer);
+
+    // Convert string 's' of 'len' bytes to number, which is a decimal or
+    // hexadecimal number with optional sign, surrounded by optional
+    // spaces, return false when the whole string is not a number.
+    bool StringToNumber(const char *s, std::size_t len, double *num);
+
+    // Convert string 's' of 'len' bytes to integer of 'base' in [2, 36],
+    // with optional '-' and surrounded by optional spaces, return false
+    // when the whole string is not an integer of 'base'.
+    bool StringToInteger(const char *s, std::size_t len, int base, double *num);
+} // namespace luna
+
+#endif // NUMBER_H
@@ -38,7 +38,7 @@ namespace luna
         OpType_UnEqual,                 // ABC  A: dst register B: operand1 register C: operand2 register
         OpType_LessEqual,               // ABC  A: dst register B: operand1 register C: operand2 register
         OpType_GreaterEqual,            // ABC  A: dst register B: operand1 register C: operand2 register
-        OpType_NewTable,                // A    A: register of table
+        OpType_NewTable,                // ABx  A: register of table Bx: allocation site index
         OpType_SetTable,                // ABC  A: register of table B: key register C: value register
         OpType_GetTable,                // ABC  A: register of table B: key register C: value register
         OpType_ForInit,                 // ABC  A: var register B: limit register    C: step register
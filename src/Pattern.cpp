@@ -0,0 +1,660 @@
+#include "Pattern.h"
+#include "String.h"
+#include <ctype.h>
+#include <string.h>
+
+namespace luna
+{
+namespace
+{
+    const std::ptrdiff_t kCapUnfinished = -1;
+    const std::ptrdiff_t kCapPosition = -2;
+
+    bool IsClass(int cl)
+    {
+        return strchr("acdglpsuwx", tolower(cl)) != nullptr && cl != 0;
+    }
+
+    bool MatchClass(int c, int cl)
+    {
+        bool res = false;
+        switch (tolower(cl))
+        {
+            case 'a': res = isalpha(c) != 0; break;
+            case 'c': res = iscntrl(c) != 0; break;
+            case 'd': res = isdigit(c) != 0; break;
+            case 'g': res = isgraph(c) != 0; break;
+            case 'l': res = islower(c) != 0; break;
+            case 'p': res = ispunct(c) != 0; break;
+            case 's': res = isspace(c) != 0; break;
+            case 'u': res = isupper(c) != 0; break;
+            case 'w': res = isalnum(c) != 0; break;
+            case 'x': res = isxdigit(c) != 0; break;
+            default: return cl == c;
+        }
+        return isupper(cl) ? !res : res;
+    }
+
+    // Match 'c' with set [p, ec], 'p' is '[' and 'ec' is ']'
+    bool MatchBracketClass(int c, const char *p, const char *ec)
+    {
+        bool sig = true;
+        if (*(p + 1) == '^')
+        {
+            sig = false;
+            ++p;
+        }
+
+        while (++p < ec)
+        {
+            if (*p == '%')
+            {
+                ++p;
+                if (MatchClass(c, static_cast<unsigned char>(*p)))
+                    return sig;
+            }
+            else if (*(p + 1) == '-' && p + 2 < ec)
+            {
+                p += 2;
+                if (static_cast<unsigned char>(*(p - 2)) <= c &&
+                    c <= static_cast<unsigned char>(*p))
+                    return sig;
+            }
+            else if (static_cast<unsigned char>(*p) == c)
+            {
+                return sig;
+            }
+        }
+        return !sig;
+    }
+} // namespace
+
+    const char * FindString(const char *s, std::size_t len,
+                            const char *p, std::size_t plen)
+    {
+        if (plen == 0)
+            return s;
+        if (plen > len)
+            return nullptr;
+
+        // Search the first byte with memchr, which is vectorized by
+        // the C library, then compare the rest.
+        const char *end = s + len - plen + 1;
+        const char first = p[0];
+        const char last = p[plen - 1];
+        while (s < end)
+        {
+            s = static_cast<const char *>(memchr(s, first, end - s));
+            if (!s)
+                return nullptr;
+            if (s[plen - 1] == last && memcmp(s + 1, p + 1, plen - 1) == 0)
+                return s;
+            ++s;
+        }
+        return nullptr;
+    }
+
+    Pattern::Pattern(const char *pattern, std::size_t len, bool anchor)
+        : anchored_(false), first_set_(-1)
+    {
+        const char *p = pattern;
+        const char *p_end = pattern + len;
+        if (anchor && p < p_end && *p == '^')
+        {
+            anchored_ = true;
+            ++p;
+        }
+
+        Compile(p, p_end);
+        ComputePrefilter();
+    }
+
+    void Pattern::Compile(const char *p, const char *p_end)
+    {
+        unsigned int captures = 0;
+        std::vector<unsigned int> open;
+        std::vector<bool> closed;
+
+        while (p < p_end)
+        {
+            switch (*p)
+            {
+                case '(':
+                    if (captures >= static_cast<unsigned int>(
+                            PatternMatcher::kMaxCaptures))
+                        throw PatternError("has too many captures");
+                    if (p + 1 < p_end && *(p + 1) == ')')
+                    {
+                        code_.push_back(Instruction(PatternOp_PositionCapture,
+                                                    captures++));
+                        closed.push_back(true);
+                        p += 2;
+                    }
+                    else
+                    {
+                        open.push_back(captures);
+                        code_.push_back(Instruction(PatternOp_StartCapture,
+                                                    captures++));
+                        closed.push_back(false);
+                        ++p;
+                    }
+                    continue;
+                case ')':
+                    if (open.empty())
+                        throw PatternError("has invalid pattern capture");
+                    code_.push_back(Instruction(PatternOp_EndCapture, open.back()));
+                    closed[open.back()] = true;
+                    open.pop_back();
+                    ++p;
+                    continue;
+                case '$':
+                    if (p + 1 == p_end)
+                    {
+                        code_.push_back(Instruction(PatternOp_EndAnchor));
+                        ++p;
+                        continue;
+                    }
+                    break;
+                case '%':
+                    if (p + 1 >= p_end)
+                        break;
+                    if (*(p + 1) == 'b')
+                    {
+                        if (p + 4 > p_end)
+                            throw PatternError("has malformed pattern "
+                                               "(missing arguments to '%b')");
+                        Instruction ins(PatternOp_Balance);
+                        ins.c1_ = *(p + 2);
+                        ins.c2_ = *(p + 3);
+                        code_.push_back(ins);
+                        p += 4;
+                        continue;
+                    }
+                    if (*(p + 1) == 'f')
+                    {
+                        p += 2;
+                        if (p >= p_end || *p != '[')
+                            throw PatternError("has malformed pattern "
+                                               "(missing '[' after '%f')");
+                        auto ep = ClassEnd(p, p_end);
+                        code_.push_back(Instruction(PatternOp_Frontier,
+                                                    AddSet(p, ep)));
+                        p = ep;
+                        continue;
+                    }
+                    if (isdigit(static_cast<unsigned char>(*(p + 1))))
+                    {
+                        int l = *(p + 1) - '1';
+                        if (l < 0 || l >= static_cast<int>(captures) || !closed[l])
+                            throw PatternError(std::string("has invalid capture "
+                                                           "index %") + *(p + 1));
+                        code_.push_back(Instruction(PatternOp_BackRef, l));
+                        p += 2;
+                        continue;
+                    }
+                    break;
+            }
+
+            // Single char class with optional repetition suffix
+            auto ep = ClassEnd(p, p_end);
+            auto repeat = PatternRepeat_One;
+            if (ep < p_end)
+            {
+                switch (*ep)
+                {
+                    case '?': repeat = PatternRepeat_Optional; break;
+                    case '*': repeat = PatternRepeat_Star; break;
+                    case '+': repeat = PatternRepeat_Plus; break;
+                    case '-': repeat = PatternRepeat_Lazy; break;
+                }
+            }
+
+            CompileSingle(p, ep, repeat);
+            p = repeat == PatternRepeat_One ? ep : ep + 1;
+        }
+
+        if (!open.empty())
+            throw PatternError("has unfinished capture");
+        code_.push_back(Instruction(PatternOp_Match));
+    }
+
+    const char * Pattern::ClassEnd(const char *p, const char *p_end) const
+    {
+        char c = *p++;
+        if (c == '%')
+        {
+            if (p >= p_end)
+                throw PatternError("has malformed pattern (ends with '%')");
+            return p + 1;
+        }
+
+        if (c == '[')
+        {
+            if (p < p_end && *p == '^')
+                ++p;
+            // Look for a ']', the first char of set could be ']'
+            do
+            {
+                if (p >= p_end)
+                    throw PatternError("has malformed pattern (missing ']')");
+                if (*p++ == '%' && p < p_end)
+                    ++p;
+            } while (p >= p_end || *p != ']');
+            return p + 1;
+        }
+
+        return p;
+    }
+
+    void Pattern::CompileSingle(const char *p, const char *ep,
+                                PatternRepeat repeat)
+    {
+        Instruction ins(PatternOp_Char);
+        if (*p == '.')
+        {
+            ins.op_ = PatternOp_Any;
+        }
+        else if (*p == '[' || (*p == '%' && IsClass(static_cast<unsigned char>(*(p + 1)))))
+        {
+            ins.op_ = PatternOp_Set;
+            ins.arg_ = AddSet(p, ep);
+        }
+        else
+        {
+            ins.c1_ = *p == '%' ? *(p + 1) : *p;
+            if (repeat == PatternRepeat_One)
+            {
+                AddLiteral(ins.c1_);
+                return ;
+            }
+        }
+
+        ins.repeat_ = repeat;
+        code_.push_back(ins);
+    }
+
+    unsigned int Pattern::AddSet(const char *p, const char *ep)
+    {
+        CharSet set = { { 0 } };
+        for (int c = 0; c < 256; ++c)
+        {
+            bool match = *p == '[' ?
+                MatchBracketClass(c, p, ep - 1) :
+                MatchClass(c, static_cast<unsigned char>(*(p + 1)));
+            if (match)
+                set.Set(static_cast<unsigned char>(c));
+        }
+
+        sets_.push_back(set);
+        return static_cast<unsigned int>(sets_.size() - 1);
+    }
+
+    void Pattern::AddLiteral(unsigned char c)
+    {
+        // Merge continuous chars into literal string
+        if (!code_.empty())
+        {
+            auto &last = code_.back();
+            if (last.op_ == PatternOp_String)
+            {
+                literals_.push_back(c);
+                ++last.len_;
+                return ;
+            }
+
+            if (last.op_ == PatternOp_Char && last.repeat_ == PatternRepeat_One)
+            {
+                last.op_ = PatternOp_String;
+                last.arg_ = static_cast<unsigned int>(literals_.size());
+                last.len_ = 2;
+                literals_.push_back(last.c1_);
+                literals_.push_back(c);
+                return ;
+            }
+        }
+
+        Instruction ins(PatternOp_Char);
+        ins.c1_ = c;
+        code_.push_back(ins);
+    }
+
+    void Pattern::ComputePrefilter()
+    {
+        // Captures do not consume chars, skip them
+        std::size_t pc = 0;
+        while (code_[pc].op_ == PatternOp_StartCapture ||
+               code_[pc].op_ == PatternOp_PositionCapture)
+            ++pc;
+
+        const auto &ins = code_[pc];
+        bool once_at_least = ins.repeat_ == PatternRepeat_One ||
+            ins.repeat_ == PatternRepeat_Plus;
+        if (ins.op_ == PatternOp_String)
+            prefix_.assign(literals_, ins.arg_, ins.len_);
+        else if (ins.op_ == PatternOp_Char && once_at_least)
+            prefix_.assign(1, static_cast<char>(ins.c1_));
+        else if (ins.op_ == PatternOp_Set && once_at_least)
+            first_set_ = static_cast<int>(ins.arg_);
+    }
+
+    PatternMatcher::PatternMatcher(const Pattern *pattern,
+                                   const char *src, std::size_t len)
+        : pattern_(pattern), src_init_(src), src_end_(src + len),
+          level_(0), depth_(0)
+    {
+    }
+
+    const char * PatternMatcher::Match(const char *s)
+    {
+        level_ = 0;
+        depth_ = 0;
+        return DoMatch(s, 0);
+    }
+
+    const char * PatternMatcher::Find(const char *s, const char **start)
+    {
+        const auto &prefix = pattern_->prefix_;
+        bool anchored = pattern_->anchored_;
+        const Pattern::CharSet *first_set = pattern_->first_set_ >= 0 ?
+            &pattern_->sets_[pattern_->first_set_] : nullptr;
+
+        for (;;)
+        {
+            // Skip to the position where a match could start
+            if (!anchored && !prefix.empty())
+            {
+                s = FindString(s, src_end_ - s, prefix.data(), prefix.size());
+                if (!s)
+                    return nullptr;
+            }
+            else if (!anchored && first_set)
+            {
+                while (s < src_end_ && !first_set->Test(*s))
+                    ++s;
+                if (s >= src_end_)
+                    return nullptr;
+            }
+
+            auto e = Match(s);
+            if (e)
+            {
+                *start = s;
+                return e;
+            }
+
+            if (anchored || s >= src_end_)
+                return nullptr;
+            ++s;
+        }
+    }
+
+    bool PatternMatcher::GetCapture(int i, const char *s, const char *e,
+                                    const char **str, std::size_t *len) const
+    {
+        if (i >= level_)
+        {
+            if (i != 0)
+                throw PatternError("has invalid capture index");
+            *str = s;
+            *len = e - s;
+            return true;
+        }
+
+        *str = capture_[i].init_;
+        if (capture_[i].len_ == kCapPosition)
+            return false;
+        *len = capture_[i].len_;
+        return true;
+    }
+
+    bool PatternMatcher::SingleMatch(const Pattern::Instruction &ins,
+                                     unsigned char c) const
+    {
+        switch (ins.op_)
+        {
+            case PatternOp_Char: return ins.c1_ == c;
+            case PatternOp_Any: return true;
+            default: return pattern_->sets_[ins.arg_].Test(c);
+        }
+    }
+
+    const char * PatternMatcher::DoMatch(const char *s, std::size_t pc)
+    {
+        if (++depth_ > kMaxMatchDepth)
+            throw PatternError("has too complex pattern");
+        auto res = MatchImpl(s, pc);
+        --depth_;
+        return res;
+    }
+
+    const char * PatternMatcher::MatchImpl(const char *s, std::size_t pc)
+    {
+        const auto &code = pattern_->code_;
+        for (;;)
+        {
+            const auto &ins = code[pc];
+            switch (ins.op_)
+            {
+                case PatternOp_Match:
+                    return s;
+                case PatternOp_String:
+                    if (static_cast<std::size_t>(src_end_ - s) < ins.len_ ||
+                        memcmp(s, pattern_->literals_.data() + ins.arg_,
+                               ins.len_) != 0)
+                        return nullptr;
+                    s += ins.len_;
+                    ++pc;
+                    continue;
+                case PatternOp_StartCapture:
+                    return StartCapture(s, pc + 1, kCapUnfinished);
+                case PatternOp_PositionCapture:
+                    return StartCapture(s, pc + 1, kCapPosition);
+                case PatternOp_EndCapture:
+                    return EndCapture(s, pc + 1, ins.arg_);
+                case PatternOp_EndAnchor:
+                    return s == src_end_ ? s : nullptr;
+                case PatternOp_Balance:
+                    s = MatchBalance(s, ins);
+                    if (!s)
+                        return nullptr;
+                    ++pc;
+                    continue;
+                case PatternOp_Frontier:
+                {
+                    const auto &set = pattern_->sets_[ins.arg_];
+                    unsigned char prev = s == src_init_ ? 0 : *(s - 1);
+                    unsigned char cur = s < src_end_ ? *s : 0;
+                    if (set.Test(prev) || !set.Test(cur))
+                        return nullptr;
+                    ++pc;
+                    continue;
+                }
+                case PatternOp_BackRef:
+                    s = MatchBackRef(s, ins.arg_);
+                    if (!s)
+                        return nullptr;
+                    ++pc;
+                    continue;
+                default:
+                    break;
+            }
+
+            // Single char ops
+            bool m = s < src_end_ && SingleMatch(ins, *s);
+            switch (ins.repeat_)
+            {
+                case PatternRepeat_Optional:
+                    if (m)
+                    {
+                        auto res = DoMatch(s + 1, pc + 1);
+                        if (res)
+                            return res;
+                    }
+                    ++pc;
+                    continue;
+                case PatternRepeat_Plus:
+                    return m ? MaxExpand(s + 1, pc) : nullptr;
+                case PatternRepeat_Star:
+                    return MaxExpand(s, pc);
+                case PatternRepeat_Lazy:
+                    return MinExpand(s, pc);
+                default:
+                    if (!m)
+                        return nullptr;
+                    ++s;
+                    ++pc;
+                    continue;
+            }
+        }
+    }
+
+    const char * PatternMatcher::MaxExpand(const char *s, std::size_t pc)
+    {
+        const auto &ins = pattern_->code_[pc];
+        std::ptrdiff_t i = 0;
+        while (s + i < src_end_ && SingleMatch(ins, s[i]))
+            ++i;
+
+        // The longest expansion matches when nothing follows
+        if (pattern_->code_[pc + 1].op_ == PatternOp_Match)
+            return s + i;
+
+        // Try with the maximum repetitions, then less
+        for (; i >= 0; --i)
+        {
+            if (!CanStartAt(s + i, pc + 1))
+                continue;
+            auto res = DoMatch(s + i, pc + 1);
+            if (res)
+                return res;
+        }
+        return nullptr;
+    }
+
+    const char * PatternMatcher::MinExpand(const char *s, std::size_t pc)
+    {
+        const auto &ins = pattern_->code_[pc];
+        for (;;)
+        {
+            if (CanStartAt(s, pc + 1))
+            {
+                auto res = DoMatch(s, pc + 1);
+                if (res)
+                    return res;
+            }
+
+            if (s < src_end_ && SingleMatch(ins, *s))
+                ++s;
+            else
+                return nullptr;
+        }
+    }
+
+    // Quick check of the first char of instruction 'pc', return false
+    // when it can not match at 's'
+    bool PatternMatcher::CanStartAt(const char *s, std::size_t pc) const
+    {
+        const auto &ins = pattern_->code_[pc];
+        if (ins.op_ == PatternOp_String)
+            return s < src_end_ &&
+                *s == pattern_->literals_[ins.arg_];
+        if (ins.op_ == PatternOp_Char &&
+            (ins.repeat_ == PatternRepeat_One || ins.repeat_ == PatternRepeat_Plus))
+            return s < src_end_ && static_cast<unsigned char>(*s) == ins.c1_;
+        return true;
+    }
+
+    const char * PatternMatcher::MatchBalance(const char *s,
+                                              const Pattern::Instruction &ins) const
+    {
+        if (s >= src_end_ || static_cast<unsigned char>(*s) != ins.c1_)
+            return nullptr;
+
+        int count = 1;
+        while (++s < src_end_)
+        {
+            auto c = static_cast<unsigned char>(*s);
+            if (c == ins.c2_)
+            {
+                if (--count == 0)
+                    return s + 1;
+            }
+            else if (c == ins.c1_)
+            {
+                ++count;
+            }
+        }
+        return nullptr;
+    }
+
+    const char * PatternMatcher::StartCapture(const char *s, std::size_t pc,
+                                              std::ptrdiff_t what)
+    {
+        capture_[level_].init_ = s;
+        capture_[level_].len_ = what;
+        ++level_;
+
+        auto res = DoMatch(s, pc);
+        if (!res)
+            --level_;
+        return res;
+    }
+
+    const char * PatternMatcher::EndCapture(const char *s, std::size_t pc,
+                                            unsigned int index)
+    {
+        capture_[index].len_ = s - capture_[index].init_;
+        auto res = DoMatch(s, pc);
+        if (!res)
+            capture_[index].len_ = kCapUnfinished;
+        return res;
+    }
+
+    const char * PatternMatcher::MatchBackRef(const char *s,
+                                              unsigned int index) const
+    {
+        auto len = capture_[index].len_;
+        if (len == kCapPosition)
+            len = 0;
+        if (src_end_ - s >= len &&
+            memcmp(capture_[index].init_, s, len) == 0)
+            return s + len;
+        return nullptr;
+    }
+
+    PatternCache::PatternCache(std::size_t capacity)
+        : capacity_(capacity)
+    {
+    }
+
+    std::shared_ptr<const Pattern> PatternCache::GetPattern(const String *pattern,
+                                                            bool anchor)
+    {
+        Key key(pattern, anchor);
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            // Move to the front as the most recently used
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->second;
+        }
+
+        std::shared_ptr<const Pattern> compiled(
+            new Pattern(pattern->GetCStr(), pattern->GetLength(), anchor));
+        entries_.push_front(Entry(key, compiled));
+        index_[key] = entries_.begin();
+
+        if (entries_.size() > capacity_)
+        {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        return compiled;
+    }
+
+    void PatternCache::Accept(GCObjectVisitor *v) const
+    {
+        for (const auto &entry : entries_)
+            const_cast<String *>(entry.first.first)->Accept(v);
+    }
+} // namespace luna
@@ -0,0 +1,213 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace luna
+{
+    class String;
+    class GCObjectVisitor;
+
+    // Error of malformed pattern, 'desc_' describes the pattern argument
+    struct PatternError
+    {
+        std::string desc_;
+
+        explicit PatternError(const std::string &desc) : desc_(desc) { }
+    };
+
+    enum PatternOp
+    {
+        PatternOp_Char,             // Single char
+        PatternOp_Any,              // Any char
+        PatternOp_Set,              // Char in set
+        PatternOp_String,           // Literal string
+        PatternOp_StartCapture,
+        PatternOp_PositionCapture,
+        PatternOp_EndCapture,
+        PatternOp_Balance,          // %bxy
+        PatternOp_Frontier,         // %f[set]
+        PatternOp_BackRef,          // %1 - %9
+        PatternOp_EndAnchor,        // $ at the end of pattern
+        PatternOp_Match,            // End of pattern
+    };
+
+    // Repetition of single char ops
+    enum PatternRepeat
+    {
+        PatternRepeat_One,
+        PatternRepeat_Optional,     // ?
+        PatternRepeat_Star,         // *
+        PatternRepeat_Plus,         // +
+        PatternRepeat_Lazy,         // -
+    };
+
+    // Find 'p' of 'plen' bytes in 's' of 'len' bytes, return nullptr
+    // when not found
+    const char * FindString(const char *s, std::size_t len,
+                            const char *p, std::size_t plen);
+
+    // Lua pattern which is compiled into instructions, char classes
+    // and sets are compiled into bitmaps of 256 chars.
+    class Pattern
+    {
+    public:
+        // Compile pattern, throw PatternError when it is malformed.
+        // '^' at the beginning anchors the pattern when 'anchor' is
+        // true, otherwise it is a literal char, like in string.gmatch.
+        Pattern(const char *pattern, std::size_t len, bool anchor = true);
+
+        Pattern(const Pattern &) = delete;
+        void operator = (const Pattern &) = delete;
+
+        bool IsAnchored() const
+        { return anchored_; }
+
+    private:
+        friend class PatternMatcher;
+
+        struct Instruction
+        {
+            unsigned char op_;
+            unsigned char repeat_;
+            // Char of PatternOp_Char, chars of PatternOp_Balance
+            unsigned char c1_;
+            unsigned char c2_;
+            // Set index, capture index or offset of literal string
+            unsigned int arg_;
+            // Length of literal string
+            unsigned int len_;
+
+            Instruction(PatternOp op, unsigned int arg = 0)
+                : op_(op), repeat_(PatternRepeat_One),
+                  c1_(0), c2_(0), arg_(arg), len_(0) { }
+        };
+
+        struct CharSet
+        {
+            unsigned int bits_[8];
+
+            bool Test(unsigned char c) const
+            { return ((bits_[c >> 5] >> (c & 31)) & 1) != 0; }
+
+            void Set(unsigned char c)
+            { bits_[c >> 5] |= 1u << (c & 31); }
+        };
+
+        void Compile(const char *p, const char *p_end);
+        const char * ClassEnd(const char *p, const char *p_end) const;
+        void CompileSingle(const char *p, const char *ep, PatternRepeat repeat);
+        unsigned int AddSet(const char *p, const char *ep);
+        void AddLiteral(unsigned char c);
+        void ComputePrefilter();
+
+        std::vector<Instruction> code_;
+        std::vector<CharSet> sets_;
+        std::string literals_;
+        bool anchored_;
+        // Literal prefix of all matches
+        std::string prefix_;
+        // Set of the first char of all matches, -1 when no such set
+        int first_set_;
+    };
+
+    // Match a compiled pattern on the source string
+    class PatternMatcher
+    {
+    public:
+        PatternMatcher(const Pattern *pattern, const char *src, std::size_t len);
+
+        // Match pattern at 's', return end of the match or nullptr
+        const char * Match(const char *s);
+
+        // Find the first match from 's', set 'start' as the beginning of
+        // the match and return the end, return nullptr when not found
+        const char * Find(const char *s, const char **start);
+
+        int GetCaptureCount() const
+        { return level_; }
+
+        // Get capture 'i' of match [s, e), the whole match is capture 0
+        // when there is no capture. Return false when the capture is a
+        // position capture, then 'str' points to the position.
+        bool GetCapture(int i, const char *s, const char *e,
+                        const char **str, std::size_t *len) const;
+
+        const char * GetSource() const
+        { return src_init_; }
+
+        // Max count of captures of a pattern
+        static const int kMaxCaptures = 32;
+
+    private:
+        static const int kMaxMatchDepth = 200;
+
+        bool SingleMatch(const Pattern::Instruction &ins, unsigned char c) const;
+        const char * DoMatch(const char *s, std::size_t pc);
+        const char * MatchImpl(const char *s, std::size_t pc);
+        const char * MaxExpand(const char *s, std::size_t pc);
+        const char * MinExpand(const char *s, std::size_t pc);
+        bool CanStartAt(const char *s, std::size_t pc) const;
+        const char * MatchBalance(const char *s, const Pattern::Instruction &ins) const;
+        const char * StartCapture(const char *s, std::size_t pc, std::ptrdiff_t what);
+        const char * EndCapture(const char *s, std::size_t pc, unsigned int index);
+        const char * MatchBackRef(const char *s, unsigned int index) const;
+
+        struct Capture
+        {
+            const char *init_;
+            std::ptrdiff_t len_;
+        };
+
+        const Pattern *pattern_;
+        const char *src_init_;
+        const char *src_end_;
+        int level_;
+        int depth_;
+        Capture capture_[kMaxCaptures];
+    };
+
+    // LRU cache of compiled patterns, which is keyed by pattern string
+    class PatternCache
+    {
+    public:
+        explicit PatternCache(std::size_t capacity);
+
+        PatternCache(const PatternCache &) = delete;
+        void operator = (const PatternCache &) = delete;
+
+        // Get compiled pattern of 'pattern', compile it when missed,
+        // throw PatternError when the pattern is malformed. Patterns
+        // compiled with different 'anchor' are cached separately.
+        std::shared_ptr<const Pattern> GetPattern(const String *pattern,
+                                                  bool anchor = true);
+
+        // Visit cached pattern strings, strings are kept alive by
+        // the cache, so the key can not be reused by a new string
+        void Accept(GCObjectVisitor *v) const;
+
+    private:
+        // Pattern string and 'anchor' of compiling
+        typedef std::pair<const String *, bool> Key;
+        typedef std::pair<Key, std::shared_ptr<const Pattern>> Entry;
+        typedef std::list<Entry> EntryList;
+
+        struct KeyHash
+        {
+            std::size_t operator () (const Key &key) const
+            { return std::hash<const String *>()(key.first) ^ key.second; }
+        };
+
+        // Most recently used entry is at the front
+        EntryList entries_;
+        std::unordered_map<Key, EntryList::iterator, KeyHash> index_;
+        std::size_t capacity_;
+    };
+} // namespace luna
+
+#endif // PATTERN_H
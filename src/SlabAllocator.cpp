@@ -0,0 +1,187 @@
+#include "SlabAllocator.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif // _MSC_VER
+
+namespace luna
+{
+namespace
+{
+    // Alignment of blocks
+    const std::size_t kBlockAlign = 16;
+
+    inline std::size_t AlignUp(std::size_t size, std::size_t align)
+    {
+        return (size + align - 1) & ~(align - 1);
+    }
+
+    void * AllocAligned(std::size_t size, std::size_t align)
+    {
+#ifdef _MSC_VER
+        void *p = _aligned_malloc(size, align);
+#else
+        void *p = nullptr;
+        if (posix_memalign(&p, align, size) != 0)
+            p = nullptr;
+#endif // _MSC_VER
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    void FreeAligned(void *p)
+    {
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        free(p);
+#endif // _MSC_VER
+    }
+} // namespace
+
+    SlabAllocator::SlabAllocator(std::size_t block_size)
+        : block_size_(AlignUp(block_size, kBlockAlign)),
+          blocks_per_slab_(0),
+          partial_(nullptr), full_(nullptr), empty_(nullptr),
+          slab_count_(0)
+    {
+        auto header = AlignUp(sizeof(Slab), kBlockAlign);
+        assert(header + block_size_ <= kSlabSize);
+        blocks_per_slab_ = (kSlabSize - header) / block_size_;
+    }
+
+    SlabAllocator::~SlabAllocator()
+    {
+        DestroySlabs(partial_);
+        DestroySlabs(full_);
+        if (empty_)
+            FreeAligned(empty_);
+    }
+
+    void * SlabAllocator::Alloc()
+    {
+        if (!partial_)
+            LinkSlab(&partial_, NewSlab());
+
+        auto slab = partial_;
+        void *p = nullptr;
+        if (slab->free_)
+        {
+            p = slab->free_;
+            slab->free_ = slab->free_->next_;
+        }
+        else
+        {
+            p = slab->bump_;
+            slab->bump_ += block_size_;
+        }
+
+        if (++slab->used_ == blocks_per_slab_)
+        {
+            UnlinkSlab(&partial_, slab);
+            LinkSlab(&full_, slab);
+        }
+        return p;
+    }
+
+    void SlabAllocator::Free(void *p)
+    {
+        auto address = reinterpret_cast<uintptr_t>(p);
+        auto slab = reinterpret_cast<Slab *>(address & ~(kSlabSize - 1));
+        assert(slab->used_ > 0);
+
+        if (slab->used_ == blocks_per_slab_)
+        {
+            UnlinkSlab(&full_, slab);
+            LinkSlab(&partial_, slab);
+        }
+
+        auto block = static_cast<FreeBlock *>(p);
+        block->next_ = slab->free_;
+        slab->free_ = block;
+
+        if (--slab->used_ == 0)
+        {
+            UnlinkSlab(&partial_, slab);
+            ReleaseSlab(slab);
+        }
+    }
+
+    SlabAllocator::Slab * SlabAllocator::NewSlab()
+    {
+        // Reuse the empty slab before allocating from system
+        if (empty_)
+        {
+            auto slab = empty_;
+            empty_ = nullptr;
+            return slab;
+        }
+
+        auto slab = static_cast<Slab *>(AllocAligned(kSlabSize, kSlabSize));
+        ResetSlab(slab);
+        ++slab_count_;
+        return slab;
+    }
+
+    void SlabAllocator::ReleaseSlab(Slab *slab)
+    {
+        // Keep one empty slab, so allocating and freeing one block
+        // repeatedly does not allocate slab from system every time
+        if (!empty_)
+        {
+            ResetSlab(slab);
+            empty_ = slab;
+        }
+        else
+        {
+            FreeAligned(slab);
+            --slab_count_;
+        }
+    }
+
+    void SlabAllocator::ResetSlab(Slab *slab)
+    {
+        slab->prev_ = nullptr;
+        slab->next_ = nullptr;
+        slab->free_ = nullptr;
+        slab->bump_ = reinterpret_cast<char *>(slab) +
+            AlignUp(sizeof(Slab), kBlockAlign);
+        slab->used_ = 0;
+    }
+
+    void SlabAllocator::LinkSlab(Slab **list, Slab *slab)
+    {
+        slab->prev_ = nullptr;
+        slab->next_ = *list;
+        if (*list)
+            (*list)->prev_ = slab;
+        *list = slab;
+    }
+
+    void SlabAllocator::UnlinkSlab(Slab **list, Slab *slab)
+    {
+        if (slab->prev_)
+            slab->prev_->next_ = slab->next_;
+        else
+            *list = slab->next_;
+        if (slab->next_)
+            slab->next_->prev_ = slab->prev_;
+        slab->prev_ = nullptr;
+        slab->next_ = nullptr;
+    }
+
+    void SlabAllocator::DestroySlabs(Slab *list)
+    {
+        while (list)
+        {
+            auto slab = list;
+            list = list->next_;
+            FreeAligned(slab);
+        }
+    }
+} // namespace luna
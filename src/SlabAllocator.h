@@ -0,0 +1,77 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include <cstddef>
+
+namespace luna
+{
+    // Allocator of fixed size blocks. Blocks are allocated from slabs
+    // by popping the free list of slab or bumping a pointer, freed
+    // blocks return to their slab, and the slab is released when all
+    // of its blocks are freed.
+    class SlabAllocator
+    {
+    public:
+        // Bytes of each slab, slabs are aligned to this size, so the
+        // slab of a block is found by its address
+        static const std::size_t kSlabSize = 16 * 1024;
+
+        explicit SlabAllocator(std::size_t block_size);
+        ~SlabAllocator();
+
+        SlabAllocator(const SlabAllocator&) = delete;
+        void operator = (const SlabAllocator&) = delete;
+
+        // Allocate a block of GetBlockSize() bytes
+        void * Alloc();
+
+        // Free block 'p' allocated by this allocator
+        void Free(void *p);
+
+        std::size_t GetBlockSize() const
+        { return block_size_; }
+
+        // Count of slabs allocated from system
+        std::size_t GetSlabCount() const
+        { return slab_count_; }
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock *next_;
+        };
+
+        // Header of slab, blocks follow it
+        struct Slab
+        {
+            Slab *prev_;
+            Slab *next_;
+            // Freed blocks
+            FreeBlock *free_;
+            // Blocks from here to the end of slab are never allocated
+            char *bump_;
+            // Count of allocated blocks
+            std::size_t used_;
+        };
+
+        Slab * NewSlab();
+        void ReleaseSlab(Slab *slab);
+        void ResetSlab(Slab *slab);
+
+        static void LinkSlab(Slab **list, Slab *slab);
+        static void UnlinkSlab(Slab **list, Slab *slab);
+        static void DestroySlabs(Slab *list);
+
+        std::size_t block_size_;
+        std::size_t blocks_per_slab_;
+        // Slabs which have free blocks
+        Slab *partial_;
+        // Slabs whose blocks are all allocated
+        Slab *full_;
+        // An empty slab kept for reuse
+        Slab *empty_;
+        std::size_t slab_count_;
+    };
+} // namespace luna
+
+#endif // SLAB_ALLOCATOR_H
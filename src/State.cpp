@@ -5,21 +5,39 @@
 #include "Function.h"
 #include "Table.h"
 #include "TextInStream.h"
+#include <chrono>
+#include <stdint.h>
 
 namespace luna
 {
+namespace
+{
+    // Each state has its own string hash seed, so hash collisions of
+    // strings can not be prepared ahead
+    std::size_t MakeHashSeed(const void *state)
+    {
+        auto ticks = std::chrono::high_resolution_clock::now()
+            .time_since_epoch().count();
+        auto seed = static_cast<unsigned long long>(ticks) ^
+            reinterpret_cast<uintptr_t>(state);
+        return static_cast<std::size_t>(seed * 0x9E3779B97F4A7C15ULL);
+    }
+} // namespace
+
     State::State()
     {
         module_manager_.reset(new ModuleManager(this));
-        string_pool_.reset(new StringPool);
+        string_pool_.reset(new StringPool(MakeHashSeed(this)));
+        pattern_cache_.reset(new PatternCache(kPatternCacheSize));
 
         // Init GC
         gc_.reset(new GC([&](GCObject *obj, unsigned int type) {
             if (type == GCObjectType_String)
             {
-                string_pool_->DeleteString(static_cast<String *>(obj));
+                auto str = static_cast<String *>(obj);
+                if (str->IsInterned())
+                    string_pool_->DeleteString(str);
             }
-            delete obj;
         }));
         auto root = std::bind(&State::FullGCRoot, this, std::placeholders::_1);
         gc_->SetRootTraveller(root, root);
@@ -27,6 +45,17 @@ namespace luna
         // New global table
         global_.table_ = NewTable();
         global_.type_ = ValueT_Table;
+
+        // Metamethod names in order of MetaEvent
+        const char *meta_event_names[] = {
+            "__index", "__newindex", "__call", "__add", "__sub", "__mul",
+            "__div", "__mod", "__pow", "__unm", "__eq", "__lt", "__le",
+            "__len", "__concat"
+        };
+        static_assert(sizeof(meta_event_names) / sizeof(meta_event_names[0]) ==
+                      MetaEvent_Count, "metamethod names mismatch MetaEvent");
+        for (auto name : meta_event_names)
+            meta_event_names_.push_back(GetString(name));
     }
 
     State::~State()
@@ -44,44 +73,46 @@ namespace luna
         module_manager_->LoadModule(module_name);
     }
 
-    void State::LoadString(const std::string &script_str)
+    void State::LoadString(const std::string &script_str,
+                           const std::string &name)
     {
+        module_manager_->LoadString(script_str, name);
     }
 
     String * State::GetString(const std::string &str)
     {
-        auto s = string_pool_->GetString(str);
-        if (!s)
-        {
-            s = gc_->NewString();
-            s->SetValue(str);
-            string_pool_->AddString(s);
-        }
-        return s;
+        return GetString(str.c_str(), str.size());
     }
 
     String * State::GetString(const char *str, std::size_t len)
     {
-        auto s = string_pool_->GetString(str, len);
+        // Long strings are not interned
+        if (len > kMaxShortStringLength)
+            return gc_->NewLongString(str, len, string_pool_->GetSeed());
+        return InternString(str, len);
+    }
+
+    String * State::InternString(const char *str, std::size_t len)
+    {
+        // Hash once, then construct string from 'str' when missed
+        auto hash = String::Hash(str, len, string_pool_->GetSeed());
+        auto s = string_pool_->GetString(str, len, hash);
         if (!s)
         {
-            s = gc_->NewString();
-            s->SetValue(str, len);
+            s = gc_->NewString(str, len, hash);
             string_pool_->AddString(s);
         }
+        else
+        {
+            // Dead string may be found before it is swept
+            gc_->KeepAlive(s);
+        }
         return s;
     }
 
     String * State::GetString(const char *str)
     {
-        auto s = string_pool_->GetString(str);
-        if (!s)
-        {
-            s = gc_->NewString();
-            s->SetValue(str);
-            string_pool_->AddString(s);
-        }
-        return s;
+        return GetString(str, strlen(str));
     }
 
     Function * State::NewFunction()
@@ -89,9 +120,9 @@ namespace luna
         return gc_->NewFunction();
     }
 
-    Closure * State::NewClosure()
+    Closure * State::NewClosure(unsigned int site)
     {
-        return gc_->NewClosure();
+        return gc_->NewClosure(gc_->GetAllocSiteGen(site), site);
     }
 
     Upvalue * State::NewUpvalue()
@@ -99,9 +130,9 @@ namespace luna
         return gc_->NewUpvalue();
     }
 
-    Table * State::NewTable()
+    Table * State::NewTable(unsigned int site)
     {
-        return gc_->NewTable();
+        return gc_->NewTable(gc_->GetAllocSiteGen(site), site);
     }
 
     CallInfo * State::GetCurrentCall()
@@ -121,6 +152,13 @@ namespace luna
         // Visit global table
         global_.Accept(v);
 
+        // Visit metamethod names
+        for (auto name : meta_event_names_)
+            name->Accept(v);
+
+        // Visit cached pattern strings
+        pattern_cache_->Accept(v);
+
         // Visit stack values
         for (const auto &value : stack_.stack_)
         {
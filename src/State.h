@@ -5,6 +5,7 @@
 #include "Runtime.h"
 #include "ModuleManager.h"
 #include "StringPool.h"
+#include "Pattern.h"
 #include <string>
 #include <memory>
 #include <vector>
@@ -20,6 +21,7 @@ namespace luna
         CFuntionErrorType_NoError,
         CFuntionErrorType_ArgCount,
         CFuntionErrorType_ArgType,
+        CFuntionErrorType_ArgValue,
     };
 
     // Error reported by called c function
@@ -36,6 +38,9 @@ namespace luna
             };
         };
 
+        // Description of bad argument value
+        std::string arg_desc_;
+
         CFunctionError() : type_(CFuntionErrorType_NoError) { }
     };
 
@@ -58,16 +63,22 @@ namespace luna
 
         // Load modules
         void LoadModule(const std::string &module_name);
-        void LoadString(const std::string &script_str);
+        void LoadString(const std::string &script_str,
+                        const std::string &name = "string");
 
         // New GCObjects
         String * GetString(const std::string &str);
         String * GetString(const char *str, std::size_t len);
         String * GetString(const char *str);
+        // Get interned string whatever its length is, strings of
+        // source code are interned, names could be compared by pointer
+        String * InternString(const char *str, std::size_t len);
+        // New closures and tables of GC allocation 'site', they are
+        // allocated in generation decided by the site
         Function * NewFunction();
-        Closure * NewClosure();
+        Closure * NewClosure(unsigned int site = 0);
         Upvalue * NewUpvalue();
-        Table * NewTable();
+        Table * NewTable(unsigned int site = 0);
 
         // Get current CallInfo
         CallInfo * GetCurrentCall();
@@ -75,6 +86,10 @@ namespace luna
         // Get global table value
         Value * GetGlobal();
 
+        // Get metamethod name of MetaEvent 'event'
+        String * GetMetaEventName(int event) const
+        { return meta_event_names_[event]; }
+
         // For call c function
         void ClearCFunctionError()
         { cfunc_error_.type_ = CFuntionErrorType_NoError; }
@@ -91,13 +106,21 @@ namespace luna
         void CheckRunGC()
         { gc_->CheckGC(); }
 
+        // Get cache of compiled string patterns
+        PatternCache& GetPatternCache()
+        { return *pattern_cache_; }
+
     private:
+        // Capacity of pattern cache
+        static const std::size_t kPatternCacheSize = 64;
+
         // Full GC root
         void FullGCRoot(GCObjectVisitor *v);
 
         std::unique_ptr<ModuleManager> module_manager_;
         std::unique_ptr<StringPool> string_pool_;
         std::unique_ptr<GC> gc_;
+        std::unique_ptr<PatternCache> pattern_cache_;
 
         // For c function error
         CFunctionError cfunc_error_;
@@ -106,6 +129,9 @@ namespace luna
         Stack stack_;
         std::list<CallInfo> calls_;
         Value global_;
+
+        // Metamethod names indexed by MetaEvent
+        std::vector<String *> meta_event_names_;
     };
 } // namespace luna
 
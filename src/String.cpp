@@ -2,70 +2,117 @@
 
 namespace luna
 {
-    String::String()
-        : in_heap_(0), str_(nullptr), length_(0), hash_(0)
+namespace
+{
+    // Strings of at least this length are hashed by four independent
+    // lanes of words
+    const std::size_t kLaneHashLength = 64;
+
+    const unsigned long long kHashMul = 0x9E3779B97F4A7C15ULL;
+
+    inline unsigned long long LoadWord(const char *s)
     {
+        unsigned long long w;
+        memcpy(&w, s, sizeof(w));
+        return w;
     }
 
-    String::String(const char *str)
-        : String()
+    // Load 'len' (less than 8) bytes as a word
+    inline unsigned long long LoadTail(const char *s, std::size_t len)
     {
-        SetValue(str);
+        unsigned long long w = 0;
+        memcpy(&w, s, len);
+        return w;
     }
 
-    String::~String()
+    inline unsigned long long MixWord(unsigned long long h,
+                                      unsigned long long w)
     {
-        if (in_heap_)
-            delete [] str_;
+        h ^= w * kHashMul;
+        h = (h << 27) | (h >> 37);
+        return h * 5 + 0x52DCE729;
     }
 
-    std::string String::GetStdString() const
+    // MurmurHash3 finalizer
+    inline unsigned long long Finalize(unsigned long long h)
     {
-        if (in_heap_)
-            return std::string(str_, length_);
-        else
-            return std::string(str_buffer_, length_);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
     }
+} // namespace
 
-    void String::SetValue(const std::string &str)
+    String * String::Create(const char *str, std::size_t len,
+                            std::size_t hash)
     {
-        SetValue(str.c_str(), str.size());
+        // Header and characters with the terminating zero
+        return Create(::operator new(GetAllocSize(len)), str, len, hash);
     }
 
-    void String::SetValue(const char *str)
+    String * String::CreateLazyHash(const char *str, std::size_t len,
+                                    std::size_t seed)
     {
-        SetValue(str, strlen(str));
+        return CreateLazyHash(::operator new(GetAllocSize(len)),
+                              str, len, seed);
     }
 
-    void String::SetValue(const char *str, std::size_t len)
+    String * String::Create(void *mem, const char *str, std::size_t len,
+                            std::size_t hash)
     {
-        if (in_heap_)
-            delete [] str_;
+        return ::new (mem) String(str, len, hash, true);
+    }
 
-        length_ = len;
-        if (len < sizeof(str_buffer_))
-        {
-            memcpy(str_buffer_, str, len);
-            str_buffer_[len] = 0;
-            in_heap_ = 0;
-            Hash(str_buffer_);
-        }
-        else
-        {
-            str_ = new char[len + 1];
-            memcpy(str_, str, len);
-            str_[len] = 0;
-            in_heap_ = 1;
-            Hash(str_);
-        }
+    String * String::CreateLazyHash(void *mem, const char *str,
+                                    std::size_t len, std::size_t seed)
+    {
+        return ::new (mem) String(str, len, seed, false);
     }
 
-    void String::Hash(const char *s)
+    String::String(const char *str, std::size_t len,
+                   std::size_t hash, bool hashed)
+        : hashed_(hashed), interned_(false), length_(len), hash_(hash),
+          pool_next_(nullptr)
     {
-        hash_ = 5381;
-        int c = 0;
+        char *chars = reinterpret_cast<char *>(this + 1);
+        memcpy(chars, str, len);
+        chars[len] = 0;
+    }
+
+    std::string String::GetStdString() const
+    {
+        return std::string(GetCStr(), length_);
+    }
+
+    std::size_t String::Hash(const char *s, std::size_t len,
+                             std::size_t seed)
+    {
+        unsigned long long h = seed ^ (len * kHashMul);
+        std::size_t i = 0;
+        if (len >= kLaneHashLength)
+        {
+            // Lanes do not depend on each other, so their multiplies
+            // overlap, and every byte is still hashed
+            unsigned long long h1 = h;
+            unsigned long long h2 = h ^ 0x243F6A8885A308D3ULL;
+            unsigned long long h3 = h ^ 0x13198A2E03707344ULL;
+            unsigned long long h4 = h ^ 0xA4093822299F31D0ULL;
+            for (; i + 32 <= len; i += 32)
+            {
+                h1 = MixWord(h1, LoadWord(s + i));
+                h2 = MixWord(h2, LoadWord(s + i + 8));
+                h3 = MixWord(h3, LoadWord(s + i + 16));
+                h4 = MixWord(h4, LoadWord(s + i + 24));
+            }
+            h = MixWord(MixWord(MixWord(h1, h2), h3), h4);
+        }
 
-        while ((c = *s++))
-            hash_ = ((hash_ << 5) + hash_) + c;
+        for (; i + 8 <= len; i += 8)
+            h = MixWord(h, LoadWord(s + i));
+        if (i < len)
+            h = MixWord(h, LoadTail(s + i, len - i));
+        return static_cast<std::size_t>(Finalize(h));
     }
 } // namespace luna
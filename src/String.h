@@ -8,12 +8,38 @@
 
 namespace luna
 {
+    // Strings longer than this are long strings, long strings created at
+    // runtime are not interned, they are compared by content and their
+    // hash is computed when needed.
+    const std::size_t kMaxShortStringLength = 40;
+
+    // String is immutable, characters are stored after the header in
+    // the same allocation.
     class String : public GCObject
     {
+        friend class StringPool;
     public:
-        String();
-        explicit String(const char *str);
-        ~String();
+        // Create string of 'len' characters from 'str' with 'hash'
+        static String * Create(const char *str, std::size_t len,
+                               std::size_t hash);
+        // Create string whose hash is computed with 'seed' on demand
+        static String * CreateLazyHash(const char *str, std::size_t len,
+                                       std::size_t seed);
+
+        // Bytes of string of 'len' characters
+        static std::size_t GetAllocSize(std::size_t len)
+        { return sizeof(String) + len + 1; }
+
+        // Create string in 'mem' of GetAllocSize(len) bytes
+        static String * Create(void *mem, const char *str, std::size_t len,
+                               std::size_t hash);
+        static String * CreateLazyHash(void *mem, const char *str,
+                                       std::size_t len, std::size_t seed);
+
+        // Strings are only created by Create
+        static void * operator new (std::size_t) = delete;
+        static void operator delete (void *p)
+        { ::operator delete(p); }
 
         String(const String &) = delete;
         void operator = (const String &) = delete;
@@ -21,29 +47,53 @@ namespace luna
         virtual void Accept(GCObjectVisitor *v)
         { v->Visit(this); }
 
+        virtual std::size_t GetMemorySize() const
+        { return GetAllocSize(length_); }
+
         std::size_t GetHash() const
-        { return hash_; }
+        {
+            // hash_ holds the seed until hash is computed
+            if (!hashed_)
+            {
+                hash_ = Hash(GetCStr(), length_, hash_);
+                hashed_ = true;
+            }
+            return hash_;
+        }
+
+        bool IsLong() const
+        { return length_ > kMaxShortStringLength; }
+
+        // Interned strings are in StringPool
+        bool IsInterned() const
+        { return interned_; }
+
+        void SetInterned(bool interned)
+        { interned_ = interned; }
 
         std::size_t GetLength() const
         { return length_; }
 
         const char * GetCStr() const
-        { return in_heap_ ? str_ : str_buffer_; }
+        { return reinterpret_cast<const char *>(this + 1); }
 
         // Convert to std::string
         std::string GetStdString() const;
 
-        // Change context of string
-        void SetValue(const std::string &str);
-        void SetValue(const char *str);
-        void SetValue(const char *str, std::size_t len);
+        // Calculate hash of all 'len' bytes from 's', embedded zeros
+        // are hashed too
+        static std::size_t Hash(const char *s, std::size_t len,
+                                std::size_t seed);
 
         friend bool operator == (const String &l, const String &r)
         {
-            return l.hash_ == r.hash_ &&
-                l.length_ == r.length_ &&
-                (l.in_heap_ ? memcmp(l.str_, r.str_, l.length_) :
-                 memcmp(l.str_buffer_, r.str_buffer_, l.length_)) == 0;
+            if (&l == &r)
+                return true;
+            if (l.length_ != r.length_)
+                return false;
+            if (l.hashed_ && r.hashed_ && l.hash_ != r.hash_)
+                return false;
+            return memcmp(l.GetCStr(), r.GetCStr(), l.length_) == 0;
         }
 
         friend bool operator != (const String &l, const String &r)
@@ -53,8 +103,8 @@ namespace luna
 
         friend bool operator < (const String &l, const String &r)
         {
-            auto *l_s = l.in_heap_ ? l.str_ : l.str_buffer_;
-            auto *r_s = r.in_heap_ ? r.str_ : r.str_buffer_;
+            auto *l_s = l.GetCStr();
+            auto *r_s = r.GetCStr();
             auto len = std::min(l.length_, r.length_);
             auto cmp = memcmp(l_s, r_s, len);
             if (cmp == 0)
@@ -79,23 +129,21 @@ namespace luna
         }
 
     private:
-        // Calculate hash of string
-        void Hash(const char *s);
-
-        // String in heap or not
-        char in_heap_;
-        union
-        {
-            // Buffer for short string
-            char str_buffer_[11];
-            // Pointer to heap which stored long string
-            char *str_;
-        };
-
+        String(const char *str, std::size_t len,
+               std::size_t hash, bool hashed);
+
+        // Flags are before length_ to fill the tail padding of
+        // GCObject, so the 64-bit length does not enlarge the header.
+        // Hash is computed or not
+        mutable bool hashed_;
+        // String is in StringPool or not
+        bool interned_;
         // Length of string
-        unsigned int length_;
+        std::size_t length_;
         // Hash value of string
-        std::size_t hash_;
+        mutable std::size_t hash_;
+        // Next string in the same bucket of StringPool
+        String *pool_next_;
     };
 } // namespace luna
 
@@ -3,46 +3,160 @@
 
 namespace luna
 {
-    StringPool::StringPool()
+namespace
+{
+    // Initial count of buckets, power of 2
+    const std::size_t kInitialBuckets = 256;
+    // Old buckets moved by each insert, pool grows after inserting as
+    // many strings as old buckets, so rehash is finished before that
+    const std::size_t kInsertRehashBuckets = 4;
+    // Old buckets moved by each lookup
+    const std::size_t kLookupRehashBuckets = 1;
+
+    inline std::size_t BucketIndex(std::size_t hash, std::size_t size)
+    {
+        return hash & (size - 1);
+    }
+} // namespace
+
+    StringPool::StringPool(std::size_t seed)
+        : seed_(seed), size_(0),
+          buckets_(kInitialBuckets, nullptr), rehash_index_(0)
+    {
+    }
+
+    String * StringPool::GetString(const char *str, std::size_t len,
+                                   std::size_t hash)
     {
+        if (IsRehashing())
+            Rehash(kLookupRehashBuckets);
+
+        if (auto bucket = GetOldBucket(hash))
+        {
+            if (auto s = FindInBucket(*bucket, str, len, hash))
+                return s;
+        }
+
+        auto index = BucketIndex(hash, buckets_.size());
+        return FindInBucket(buckets_[index], str, len, hash);
     }
 
     String * StringPool::GetString(const std::string &str)
     {
-        temp_.SetValue(str);
-        return GetString();
+        return GetString(str.c_str(), str.size());
     }
 
     String * StringPool::GetString(const char *str, std::size_t len)
     {
-        temp_.SetValue(str, len);
-        return GetString();
+        return GetString(str, len, String::Hash(str, len, seed_));
     }
 
     String * StringPool::GetString(const char *str)
     {
-        temp_.SetValue(str);
-        return GetString();
+        return GetString(str, strlen(str));
     }
 
     void StringPool::AddString(String *str)
     {
-        auto it = strings_.insert(str);
-        assert(it.second);
-        (void)it;
+        assert(!str->IsInterned());
+        if (IsRehashing())
+            Rehash(kInsertRehashBuckets);
+        else if (size_ >= buckets_.size())
+            StartRehash();
+
+        // New strings are always added to new buckets
+        auto index = BucketIndex(str->GetHash(), buckets_.size());
+        str->pool_next_ = buckets_[index];
+        buckets_[index] = str;
+        ++size_;
+        str->SetInterned(true);
     }
 
     void StringPool::DeleteString(String *str)
     {
-        strings_.erase(str);
+        // Find the bucket by hash, and unlink string from the chain
+        // of bucket without rehashing
+        auto hash = str->GetHash();
+        auto bucket = GetOldBucket(hash);
+        if (!bucket || !RemoveFromBucket(bucket, str))
+        {
+            auto index = BucketIndex(hash, buckets_.size());
+            if (!RemoveFromBucket(&buckets_[index], str))
+                return ;
+        }
+
+        --size_;
+        str->pool_next_ = nullptr;
+        str->SetInterned(false);
     }
 
-    String * StringPool::GetString()
+    String * StringPool::FindInBucket(String *head, const char *str,
+                                      std::size_t len, std::size_t hash)
     {
-        auto it = strings_.find(&temp_);
-        if (it == strings_.end())
+        for (auto s = head; s; s = s->pool_next_)
+        {
+            if (s->hash_ == hash && s->length_ == len &&
+                memcmp(s->GetCStr(), str, len) == 0)
+                return s;
+        }
+        return nullptr;
+    }
+
+    bool StringPool::RemoveFromBucket(String **bucket, String *str)
+    {
+        for (auto link = bucket; *link; link = &(*link)->pool_next_)
+        {
+            if (*link == str)
+            {
+                *link = str->pool_next_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    String ** StringPool::GetOldBucket(std::size_t hash)
+    {
+        if (!IsRehashing())
             return nullptr;
-        else
-            return *it;
+
+        auto index = BucketIndex(hash, old_buckets_.size());
+        if (index < rehash_index_)
+            return nullptr;
+        return &old_buckets_[index];
+    }
+
+    void StringPool::StartRehash()
+    {
+        assert(!IsRehashing());
+        Buckets buckets(buckets_.size() * 2, nullptr);
+        old_buckets_.swap(buckets_);
+        buckets_.swap(buckets);
+        rehash_index_ = 0;
+    }
+
+    void StringPool::Rehash(std::size_t count)
+    {
+        auto size = old_buckets_.size();
+        auto end = std::min(rehash_index_ + count, size);
+        for (; rehash_index_ < end; ++rehash_index_)
+        {
+            auto s = old_buckets_[rehash_index_];
+            while (s)
+            {
+                auto next = s->pool_next_;
+                auto index = BucketIndex(s->hash_, buckets_.size());
+                s->pool_next_ = buckets_[index];
+                buckets_[index] = s;
+                s = next;
+            }
+        }
+
+        // Release old buckets when all strings are moved
+        if (rehash_index_ == size)
+        {
+            Buckets().swap(old_buckets_);
+            rehash_index_ = 0;
+        }
     }
 } // namespace luna
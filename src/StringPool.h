@@ -2,25 +2,45 @@
 #define STRING_POOL_H
 
 #include "String.h"
+#include <string>
 #include <vector>
-#include <unordered_set>
 
 namespace luna
 {
+    // Strings are chained in buckets through String::pool_next_. When
+    // the pool grows, the old buckets are kept and moved to the new
+    // buckets a few at a time on each insert and lookup, so there is
+    // no pause for rehashing all strings at once.
     class StringPool
     {
     public:
-        StringPool();
+        // Hash of strings in pool are computed with 'seed'
+        explicit StringPool(std::size_t seed = 0);
 
         StringPool(const StringPool&) = delete;
         void operator = (const StringPool&) = delete;
 
         // Get string from pool when string is existed,
-        // otherwise return nullptr
+        // otherwise return nullptr, 'hash' is String::Hash of
+        // 'str' with seed of pool
+        String * GetString(const char *str, std::size_t len,
+                           std::size_t hash);
         String * GetString(const std::string &str);
         String * GetString(const char *str, std::size_t len);
         String * GetString(const char *str);
 
+        // Hash seed of strings in pool
+        std::size_t GetSeed() const
+        { return seed_; }
+
+        // Count of strings in pool
+        std::size_t GetSize() const
+        { return size_; }
+
+        // Pool is moving strings to the new buckets or not
+        bool IsRehashing() const
+        { return !old_buckets_.empty(); }
+
         // Add string to pool
         void AddString(String *str);
 
@@ -28,26 +48,33 @@ namespace luna
         void DeleteString(String *str);
 
     private:
-        struct StringHash
-        {
-            std::size_t operator () (const String *s) const
-            {
-                return s->GetHash();
-            }
-        };
-
-        struct StringEqual
-        {
-            bool operator () (const String *l, const String *r) const
-            {
-                return l == r || *l == *r;
-            }
-        };
-
-        String * GetString();
-
-        String temp_;
-        std::unordered_set<String *, StringHash, StringEqual> strings_;
+        typedef std::vector<String *> Buckets;
+
+        static String * FindInBucket(String *head, const char *str,
+                                     std::size_t len, std::size_t hash);
+
+        // Remove 'str' from 'bucket', return true when it is found
+        static bool RemoveFromBucket(String **bucket, String *str);
+
+        // Old bucket of 'hash' when pool is rehashing and the bucket
+        // is not moved yet, otherwise return nullptr
+        String ** GetOldBucket(std::size_t hash);
+
+        // Start to move strings to buckets of double size
+        void StartRehash();
+
+        // Move at most 'count' old buckets to new buckets
+        void Rehash(std::size_t count);
+
+        std::size_t seed_;
+        // Count of strings
+        std::size_t size_;
+        // Buckets of new strings, size is power of 2
+        Buckets buckets_;
+        // Buckets which are moving to 'buckets_'
+        Buckets old_buckets_;
+        // Old buckets before this index are moved
+        std::size_t rehash_index_;
     };
 } // namespace luna
 
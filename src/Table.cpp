@@ -1,4 +1,5 @@
 #include "Table.h"
+#include <algorithm>
 #include <math.h>
 
 namespace
@@ -7,11 +8,166 @@ namespace
     {
         return floor(d) == d;
     }
+
+    // Finalizer of MurmurHash3, mix all bits of hash value
+    inline unsigned long long MixHash(unsigned long long h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Slot of key hash 'h' with bucket displacement 'd', keys of the same
+    // bucket move by different steps, then map to [0, n) by multiplication.
+    inline std::size_t GetSlot(unsigned long long h, std::size_t d, std::size_t n)
+    {
+        unsigned int base = static_cast<unsigned int>(h >> 32);
+        unsigned int step = static_cast<unsigned int>(h >> 16) | 1;
+        unsigned int mixed = base + static_cast<unsigned int>(d) * step;
+        return static_cast<std::size_t>((static_cast<unsigned long long>(mixed) * n) >> 32);
+    }
+
+    inline bool IsWeakRef(const luna::Value &value)
+    {
+        return value.type_ == luna::ValueT_Table ||
+               value.type_ == luna::ValueT_Closure;
+    }
+
+    inline bool IsMarked(const luna::Value &value, luna::GCObjectVisitor *v)
+    {
+        switch (value.type_)
+        {
+            case luna::ValueT_Obj:
+            case luna::ValueT_String:
+            case luna::ValueT_Closure:
+            case luna::ValueT_Upvalue:
+            case luna::ValueT_Table:
+                return v->IsMarked(value.obj_);
+            default:
+                return true;
+        }
+    }
 } // namespace
 
 namespace luna
 {
-    Table::Table()
+    unsigned long long Table::FrozenHash::GetHash(const Value &key) const
+    {
+        return MixHash(std::hash<Value>()(key) ^ seed_);
+    }
+
+    bool Table::FrozenHash::Build()
+    {
+        // Keys of the same hash value are never separated by any seed
+        std::vector<std::size_t> key_hashes(slots_.size());
+        for (std::size_t i = 0; i < slots_.size(); ++i)
+            key_hashes[i] = std::hash<Value>()(slots_[i].first);
+        std::sort(key_hashes.begin(), key_hashes.end());
+        if (std::adjacent_find(key_hashes.begin(), key_hashes.end()) !=
+            key_hashes.end())
+            return false;
+
+        // Try other seeds when keys can not be placed
+        const std::size_t kMaxSeeds = 8;
+        std::vector<std::size_t> slot_of(slots_.size());
+        for (seed_ = 0; seed_ < kMaxSeeds; ++seed_)
+        {
+            if (TryBuild(slot_of))
+            {
+                std::vector<std::pair<Value, Value>> slots(slots_.size());
+                for (std::size_t i = 0; i < slots_.size(); ++i)
+                    slots[slot_of[i]] = slots_[i];
+                slots_.swap(slots);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Table::FrozenHash::TryBuild(std::vector<std::size_t> &slot_of)
+    {
+        // Bucket count is power of 2, about half of key count
+        std::size_t n = slots_.size();
+        std::size_t bucket_count = 1;
+        while (bucket_count * 2 < n)
+            bucket_count *= 2;
+        disp_.assign(bucket_count, 0);
+
+        std::vector<unsigned long long> hashes(n);
+        std::vector<std::vector<std::size_t>> buckets(bucket_count);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            hashes[i] = GetHash(slots_[i].first);
+            buckets[hashes[i] & (bucket_count - 1)].push_back(i);
+        }
+
+        // Place the largest buckets first while most slots are free
+        std::vector<std::size_t> order(bucket_count);
+        for (std::size_t i = 0; i < bucket_count; ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+                         [&](std::size_t l, std::size_t r) {
+                             return buckets[l].size() > buckets[r].size();
+                         });
+
+        std::vector<bool> used(n, false);
+        std::vector<std::size_t> placed;
+        std::size_t max_disp = 16 * n + 64;
+        for (auto b : order)
+        {
+            const auto &bucket = buckets[b];
+            if (bucket.empty())
+                break;
+
+            bool found = false;
+            for (std::size_t d = 0; d < max_disp && !found; ++d)
+            {
+                placed.clear();
+                for (auto index : bucket)
+                {
+                    std::size_t slot = GetSlot(hashes[index], d, n);
+                    if (used[slot] ||
+                        std::find(placed.begin(), placed.end(), slot) != placed.end())
+                        break;
+                    placed.push_back(slot);
+                }
+
+                if (placed.size() == bucket.size())
+                {
+                    for (std::size_t i = 0; i < bucket.size(); ++i)
+                    {
+                        used[placed[i]] = true;
+                        slot_of[bucket[i]] = placed[i];
+                    }
+                    disp_[b] = d;
+                    found = true;
+                }
+            }
+
+            if (!found)
+                return false;
+        }
+
+        return true;
+    }
+
+    int Table::FrozenHash::FindSlot(const Value &key) const
+    {
+        if (slots_.empty())
+            return -1;
+
+        unsigned long long h = GetHash(key);
+        std::size_t d = disp_[h & (disp_.size() - 1)];
+        std::size_t slot = GetSlot(h, d, slots_.size());
+        return slots_[slot].first == key ? static_cast<int>(slot) : -1;
+    }
+
+    Table::Table(GC *owner)
+        : metatable_(nullptr), owner_(owner), frozen_(false),
+          weak_mode_(WeakMode_None), absent_events_(0)
     {
     }
 
@@ -19,7 +175,17 @@ namespace luna
     {
         if (v->Visit(this))
         {
-            // Visit all array members
+            if (metatable_)
+                metatable_->Accept(v);
+
+            if (weak_mode_ != WeakMode_None)
+            {
+                AcceptWeak(v);
+                return ;
+            }
+
+            // Visit all array members, packed number array has
+            // no GC objects, so skip it.
             if (array_)
             {
                 for (const auto &value : *array_)
@@ -35,12 +201,44 @@ namespace luna
                     it->second.Accept(v);
                 }
             }
+
+            if (frozen_hash_)
+            {
+                for (const auto &slot : frozen_hash_->slots_)
+                {
+                    slot.first.Accept(v);
+                    slot.second.Accept(v);
+                }
+            }
         }
     }
 
+    std::size_t Table::GetMemorySize() const
+    {
+        std::size_t size = sizeof(Table);
+        if (array_)
+            size += sizeof(Array) + array_->capacity() * sizeof(Value);
+        if (num_array_)
+            size += sizeof(NumberArray) + num_array_->capacity() * sizeof(double);
+        if (hash_)
+        {
+            // Buckets are pointers, and each node holds key-value pair
+            // and pointer to next node
+            size += sizeof(Hash) + hash_->bucket_count() * sizeof(void *) +
+                hash_->size() * (sizeof(Hash::value_type) + sizeof(void *));
+        }
+        if (frozen_hash_)
+        {
+            size += sizeof(FrozenHash) +
+                frozen_hash_->disp_.capacity() * sizeof(std::size_t) +
+                frozen_hash_->slots_.capacity() * sizeof(frozen_hash_->slots_[0]);
+        }
+        return size;
+    }
+
     bool Table::SetArrayValue(std::size_t index, const Value &value)
     {
-        if (index < 1)
+        if (index < 1 || frozen_)
             return false;
 
         std::size_t array_size = ArraySize();
@@ -49,14 +247,24 @@ namespace luna
 
         if (index == array_size + 1)
         {
+            auto bytes = GetMemorySize();
             AppendToArray(value);
-
-            // move all continuous key from hash to array
-            Value key;
-            key.num_ = ++index;
-            key.type_ = ValueT_Number;
-            while (MoveHashToArray(key))
-                key.num_ = ++index;
+            MergeHashToArray();
+            ReportResize(bytes);
+        }
+        else if (num_array_)
+        {
+            if (value.type_ == ValueT_Number)
+            {
+                (*num_array_)[index - 1] = value.num_;
+            }
+            else
+            {
+                auto bytes = GetMemorySize();
+                UnpackArray();
+                (*array_)[index - 1] = value;
+                ReportResize(bytes);
+            }
         }
         else
         {
@@ -66,8 +274,53 @@ namespace luna
         return true;
     }
 
+    bool Table::InsertArrayValue(std::size_t index, const Value &value)
+    {
+        std::size_t array_size = ArraySize();
+        if (index < 1 || index > array_size + 1 || frozen_)
+            return false;
+
+        if (index == array_size + 1)
+            return SetArrayValue(index, value);
+
+        auto bytes = GetMemorySize();
+        if (num_array_ && value.type_ == ValueT_Number)
+        {
+            num_array_->insert(num_array_->begin() + (index - 1), value.num_);
+        }
+        else
+        {
+            if (num_array_)
+                UnpackArray();
+            array_->insert(array_->begin() + (index - 1), value);
+        }
+
+        MergeHashToArray();
+        ReportResize(bytes);
+        return true;
+    }
+
+    bool Table::RemoveArrayValue(std::size_t index)
+    {
+        if (index < 1 || index > ArraySize() || frozen_)
+            return false;
+
+        if (num_array_)
+            num_array_->erase(num_array_->begin() + (index - 1));
+        else
+            array_->erase(array_->begin() + (index - 1));
+        return true;
+    }
+
     void Table::SetValue(const Value &key, const Value &value)
     {
+        // Callers report error of modifying frozen table
+        if (frozen_)
+            return ;
+
+        // Metamethods may be changed
+        absent_events_ = 0;
+
         // Try array part
         if (key.type_ == ValueT_Number && IsInt(key.num_))
         {
@@ -76,14 +329,22 @@ namespace luna
         }
 
         // Hash part
+        if (hash_)
+        {
+            auto it = hash_->find(key);
+            if (it != hash_->end())
+            {
+                it->second = value;
+                return ;
+            }
+        }
+
+        // New key grows hash part
+        auto bytes = GetMemorySize();
         if (!hash_)
             hash_.reset(new Hash);
-
-        auto it = hash_->find(key);
-        if (it != hash_->end())
-            it->second = value;
-        else
-            hash_->insert(std::make_pair(key, value));
+        hash_->insert(std::make_pair(key, value));
+        ReportResize(bytes);
     }
 
     Value Table::GetValue(const Value &key) const
@@ -93,7 +354,16 @@ namespace luna
         {
             std::size_t index = static_cast<std::size_t>(key.num_);
             if (index >= 1 && index <= ArraySize())
-                return (*array_)[index - 1];
+                return GetArrayValue(index - 1);
+        }
+
+        // Get from frozen hash table
+        if (frozen_hash_)
+        {
+            int slot = frozen_hash_->FindSlot(key);
+            if (slot >= 0)
+                return frozen_hash_->slots_[slot].second;
+            return Value();
         }
 
         // Get from hash table
@@ -115,7 +385,15 @@ namespace luna
         {
             key.num_ = 1;           // first element index
             key.type_ = ValueT_Number;
-            value = (*array_)[0];
+            value = GetArrayValue(0);
+            return true;
+        }
+
+        // frozen hash part
+        if (frozen_hash_ && !frozen_hash_->slots_.empty())
+        {
+            key = frozen_hash_->slots_[0].first;
+            value = frozen_hash_->slots_[0].second;
             return true;
         }
 
@@ -141,11 +419,26 @@ namespace luna
             {
                 next_key.num_ = index;
                 next_key.type_ = ValueT_Number;
-                next_value = (*array_)[index - 1];
+                next_value = GetArrayValue(index - 1);
                 return true;
             }
         }
 
+        // frozen hash part, iterate slots in order
+        if (frozen_hash_)
+        {
+            const auto &slots = frozen_hash_->slots_;
+            int slot = frozen_hash_->FindSlot(key);
+            std::size_t next = slot < 0 ? 0 : slot + 1;
+            if (next < slots.size())
+            {
+                next_key = slots[next].first;
+                next_value = slots[next].second;
+                return true;
+            }
+            return false;
+        }
+
         // hash part
         if (hash_)
         {
@@ -171,16 +464,238 @@ namespace luna
 
     std::size_t Table::ArraySize() const
     {
+        if (num_array_)
+            return num_array_->size();
         return array_ ? array_->size() : 0;
     }
 
+    double * Table::GetNumberArray()
+    {
+        return num_array_ && !num_array_->empty() ? &(*num_array_)[0] : nullptr;
+    }
+
+    const double * Table::GetNumberArray() const
+    {
+        return num_array_ && !num_array_->empty() ? &(*num_array_)[0] : nullptr;
+    }
+
+    Value * Table::GetValueArray()
+    {
+        return array_ && !array_->empty() ? &(*array_)[0] : nullptr;
+    }
+
+    void Table::SetMetatable(Table *metatable)
+    {
+        metatable_ = metatable;
+    }
+
+    Value Table::GetMetamethod(MetaEvent event, String *name)
+    {
+        Value key;
+        key.type_ = ValueT_String;
+        key.str_ = name;
+
+        Value method = GetValue(key);
+        if (method.type_ == ValueT_Nil)
+            absent_events_ |= 1u << event;
+        return method;
+    }
+
+    void Table::SetWeakMode(unsigned int mode)
+    {
+        weak_mode_ = mode;
+    }
+
+    unsigned int Table::GetWeakMode() const
+    {
+        return weak_mode_;
+    }
+
+    void Table::Freeze()
+    {
+        if (frozen_)
+            return ;
+
+        frozen_ = true;
+        auto bytes = GetMemorySize();
+        if (array_)
+            array_->shrink_to_fit();
+        if (num_array_)
+            num_array_->shrink_to_fit();
+
+        if (hash_)
+        {
+            std::unique_ptr<FrozenHash> frozen_hash(new FrozenHash);
+            frozen_hash->slots_.reserve(hash_->size());
+            for (const auto &kv : *hash_)
+            {
+                if (kv.second.type_ != ValueT_Nil)
+                    frozen_hash->slots_.push_back(kv);
+            }
+
+            // Keep general hash table when perfect hash can not be built
+            if (frozen_hash->Build())
+            {
+                frozen_hash_ = std::move(frozen_hash);
+                hash_.reset();
+            }
+        }
+
+        ReportResize(bytes);
+    }
+
+    bool Table::IsFrozen() const
+    {
+        return frozen_;
+    }
+
+    bool Table::VisitEphemeron(GCObjectVisitor *v)
+    {
+        // Values of weak values table are never visited
+        if (weak_mode_ != WeakMode_Key || !hash_)
+            return false;
+
+        bool visited = false;
+        for (auto it = hash_->begin(); it != hash_->end(); ++it)
+        {
+            if (IsWeakRef(it->first) && IsMarked(it->first, v) &&
+                !IsMarked(it->second, v))
+            {
+                it->second.Accept(v);
+                visited = true;
+            }
+        }
+
+        return visited;
+    }
+
+    void Table::ClearWeakEntries(GCObjectVisitor *v)
+    {
+        bool weak_key = (weak_mode_ & WeakMode_Key) != 0;
+        bool weak_value = (weak_mode_ & WeakMode_Value) != 0;
+        auto bytes = GetMemorySize();
+
+        if (weak_value && array_)
+        {
+            for (auto &value : *array_)
+            {
+                if (IsWeakRef(value) && !IsMarked(value, v))
+                    value.SetNil();
+            }
+        }
+
+        if (hash_)
+        {
+            for (auto it = hash_->begin(); it != hash_->end();)
+            {
+                if ((weak_key && IsWeakRef(it->first) && !IsMarked(it->first, v)) ||
+                    (weak_value && IsWeakRef(it->second) && !IsMarked(it->second, v)))
+                    it = hash_->erase(it);
+                else
+                    ++it;
+            }
+        }
+
+        ReportResize(bytes);
+    }
+
+    void Table::AcceptWeak(GCObjectVisitor *v)
+    {
+        bool weak_key = (weak_mode_ & WeakMode_Key) != 0;
+        bool weak_value = (weak_mode_ & WeakMode_Value) != 0;
+
+        if (array_)
+        {
+            for (const auto &value : *array_)
+            {
+                if (!weak_value || !IsWeakRef(value))
+                    value.Accept(v);
+            }
+        }
+
+        // Values of weak keys are visited by VisitEphemeron
+        // when the keys are marked.
+        if (hash_)
+        {
+            for (auto it = hash_->begin(); it != hash_->end(); ++it)
+            {
+                bool ephemeron = weak_key && IsWeakRef(it->first);
+                if (!ephemeron)
+                    it->first.Accept(v);
+                if (!ephemeron && (!weak_value || !IsWeakRef(it->second)))
+                    it->second.Accept(v);
+            }
+        }
+
+        v->VisitWeakTable(this);
+    }
+
+    Value Table::GetArrayValue(std::size_t index) const
+    {
+        if (num_array_)
+        {
+            Value value;
+            value.num_ = (*num_array_)[index];
+            value.type_ = ValueT_Number;
+            return value;
+        }
+
+        return (*array_)[index];
+    }
+
     void Table::AppendToArray(const Value &value)
     {
-        if (!array_)
-            array_.reset(new Array);
+        // Array part starts as packed number array when the first
+        // value is number.
+        if (!array_ && !num_array_)
+        {
+            if (value.type_ == ValueT_Number)
+                num_array_.reset(new NumberArray);
+            else
+                array_.reset(new Array);
+        }
+
+        if (num_array_)
+        {
+            if (value.type_ == ValueT_Number)
+            {
+                num_array_->push_back(value.num_);
+                return ;
+            }
+
+            UnpackArray();
+        }
+
         array_->push_back(value);
     }
 
+    void Table::UnpackArray()
+    {
+        std::unique_ptr<Array> array(new Array);
+        array->reserve(num_array_->capacity());
+
+        Value value;
+        value.type_ = ValueT_Number;
+        for (auto num : *num_array_)
+        {
+            value.num_ = num;
+            array->push_back(value);
+        }
+
+        array_ = std::move(array);
+        num_array_.reset();
+    }
+
+    void Table::MergeHashToArray()
+    {
+        // move all continuous key from hash to array
+        Value key;
+        key.num_ = ArraySize() + 1;
+        key.type_ = ValueT_Number;
+        while (MoveHashToArray(key))
+            key.num_ = ArraySize() + 1;
+    }
+
     bool Table::MoveHashToArray(const Value &key)
     {
         if (!hash_)
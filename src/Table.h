@@ -9,18 +9,62 @@
 
 namespace luna
 {
+    // Weak mode of table, which is set by '__mode' field of metatable
+    enum WeakMode
+    {
+        WeakMode_None = 0,
+        WeakMode_Key = 1,                               // '__mode' has 'k'
+        WeakMode_Value = 2,                             // '__mode' has 'v'
+        WeakMode_KeyValue = WeakMode_Key | WeakMode_Value,
+    };
+
+    // Events of metamethods
+    enum MetaEvent
+    {
+        MetaEvent_Index,
+        MetaEvent_NewIndex,
+        MetaEvent_Call,
+        MetaEvent_Add,
+        MetaEvent_Sub,
+        MetaEvent_Mul,
+        MetaEvent_Div,
+        MetaEvent_Mod,
+        MetaEvent_Pow,
+        MetaEvent_Unm,
+        MetaEvent_Eq,
+        MetaEvent_Lt,
+        MetaEvent_Le,
+        MetaEvent_Len,
+        MetaEvent_Concat,
+        MetaEvent_Count,
+    };
+
     // Table has array part and hash table part.
+    // Array part is stored as packed doubles while all elements of it are
+    // numbers, and switches to boxed Values on the first non-number store.
+    // Growth of parts is reported to the GC which owns the table.
     class Table : public GCObject
     {
+        friend class ObjectScanner;
     public:
-        Table();
+        explicit Table(GC *owner = nullptr);
 
         virtual void Accept(GCObjectVisitor *v);
 
+        virtual std::size_t GetMemorySize() const;
+
         // Set array value by index, return true if success.
         // 'index' start from 1.
         bool SetArrayValue(std::size_t index, const Value &value);
 
+        // Insert value into array by index, values after 'index' move
+        // backward, return true if success. 'index' start from 1.
+        bool InsertArrayValue(std::size_t index, const Value &value);
+
+        // Remove value of array by index, values after 'index' move
+        // forward, return true if success. 'index' start from 1.
+        bool RemoveArrayValue(std::size_t index);
+
         // Add key-value into table.
         // If key is number and key fit with array, then insert into array,
         // otherwise insert into hash table.
@@ -41,19 +85,111 @@ namespace luna
 
         std::size_t ArraySize() const;
 
+        // Get packed number array of array part, return nullptr when
+        // array part is empty or not packed.
+        double * GetNumberArray();
+        const double * GetNumberArray() const;
+
+        // Get boxed Value array of array part, return nullptr when
+        // array part is empty or packed.
+        Value * GetValueArray();
+
+        // Set and get metatable, nullptr means no metatable.
+        void SetMetatable(Table *metatable);
+        Table * GetMetatable() const
+        { return metatable_; }
+
+        // Return true when this table is used as metatable and
+        // metamethod of 'event' is known to be absent.
+        bool IsMetaEventAbsent(MetaEvent event) const
+        { return (absent_events_ & (1u << event)) != 0; }
+
+        // Get metamethod 'name' of 'event' from this table as metatable,
+        // absence of the metamethod is cached until table is modified.
+        Value GetMetamethod(MetaEvent event, String *name);
+
+        // Set and get weak mode of table, weak references are not
+        // visited by GC, and removed from table after they are collected.
+        // Only tables and functions are weak references, strings are
+        // always strong.
+        void SetWeakMode(unsigned int mode);
+        unsigned int GetWeakMode() const;
+
+        // Freeze table, hash part is converted to a minimal perfect hash
+        // table and array part is shrunk to fit. Frozen table can not be
+        // modified any more, so it never needs GC barrier.
+        void Freeze();
+        bool IsFrozen() const;
+
+        // Visit values of weak keys table which keys are marked by visitor,
+        // return true when any value is visited.
+        bool VisitEphemeron(GCObjectVisitor *v);
+
+        // Remove key-value pairs from weak table which weak key or weak
+        // value is not marked by visitor.
+        void ClearWeakEntries(GCObjectVisitor *v);
+
     private:
         typedef std::vector<Value> Array;
+        typedef std::vector<double> NumberArray;
         typedef std::unordered_map<Value, Value> Hash;
 
+        // Hash part of frozen table. Keys are hashed into buckets, each
+        // bucket has a displacement which places all keys of the bucket
+        // into distinct slots, so every key has exactly one slot.
+        struct FrozenHash
+        {
+            std::size_t seed_;
+            std::vector<std::size_t> disp_;
+            std::vector<std::pair<Value, Value>> slots_;
+
+            FrozenHash() : seed_(0) { }
+
+            // Build perfect hash for all key-value pairs in slots_,
+            // return false when keys can not be placed.
+            bool Build();
+
+            // Get slot index of key, return -1 when key is not existed.
+            int FindSlot(const Value &key) const;
+
+        private:
+            unsigned long long GetHash(const Value &key) const;
+            bool TryBuild(std::vector<std::size_t> &slot_of);
+        };
+
+        // Visit strong references of weak table.
+        void AcceptWeak(GCObjectVisitor *v);
+
+        // Report memory size changed from 'old_bytes' to owner GC.
+        void ReportResize(std::size_t old_bytes)
+        { if (owner_) owner_->ResizeObject(this, old_bytes); }
+
+        // Get value of array part by index, 'index' start from 0.
+        Value GetArrayValue(std::size_t index) const;
+
         // Append value to array.
         void AppendToArray(const Value &value);
 
+        // Convert packed number array to boxed Value array.
+        void UnpackArray();
+
+        // Move all continuous keys after array part from hash table
+        // to array.
+        void MergeHashToArray();
+
         // Move hash table key-value pair to array which key is number and key
         // fit with array, return true if move success.
         bool MoveHashToArray(const Value &key);
 
         std::unique_ptr<Array> array_;              // array part of table
+        std::unique_ptr<NumberArray> num_array_;    // packed array part of table
         std::unique_ptr<Hash> hash_;                // hash table part of table
+        std::unique_ptr<FrozenHash> frozen_hash_;   // hash part of frozen table
+        Table *metatable_;                          // metatable of table
+        GC *owner_;                                 // GC accounts memory of table
+        bool frozen_;                               // table is frozen
+        unsigned int weak_mode_;                    // WeakMode of table
+        unsigned int absent_events_;                // bits of absent MetaEvent
     };
 } // namespace luna
 
@@ -3,20 +3,40 @@
 #include "Table.h"
 #include "Function.h"
 #include "Exception.h"
+#include "Number.h"
 #include <assert.h>
 #include <math.h>
 
 namespace
 {
-    std::string NumberToStr(luna::Value *num)
+    // Return false when table 't' has no metamethod of 'event'
+    inline bool MayHaveMeta(luna::Table *t, luna::MetaEvent event)
     {
-        assert(num->type_ == luna::ValueT_Number);
-        char temp[64];
-        if (floor(num->num_) == num->num_)
-            snprintf(temp, sizeof(temp), "%lld", static_cast<long long>(num->num_));
-        else
-            snprintf(temp, sizeof(temp), "%g", num->num_);
-        return temp;
+        luna::Table *mt = t->GetMetatable();
+        return mt && !mt->IsMetaEventAbsent(event);
+    }
+
+    // Get chars of string or number 'value' for concat, number is
+    // converted into 'buffer' of luna::kNumberBufferSize bytes
+    inline std::size_t GetConcatChars(const luna::Value *value, char *buffer,
+                                      const char **chars)
+    {
+        if (value->type_ == luna::ValueT_String)
+        {
+            *chars = value->str_->GetCStr();
+            return value->str_->GetLength();
+        }
+
+        assert(value->type_ == luna::ValueT_Number);
+        *chars = buffer;
+        return luna::NumberToString(value->num_, buffer);
+    }
+
+    // Value of 'upvalue' is going to be set, barrier the upvalue
+    inline luna::Value * SetUpvalueValue(luna::GC &gc, luna::Upvalue *upvalue)
+    {
+        CHECK_BARRIER(gc, upvalue);
+        return upvalue->GetValue();
     }
 } // namespace
 
@@ -28,6 +48,9 @@ namespace luna
 #define GET_REGISTER_C(i)       (call->register_ + Instruction::GetParamC(i))
 #define GET_UPVALUE_B(i)        (cl->GetUpvalue(Instruction::GetParamB(i)))
 #define GET_REAL_VALUE(a)       (a->type_ == ValueT_Upvalue ? a->upvalue_->GetValue() : a)
+// Get real value of 'a' which is going to be set to a GC object
+#define SET_REAL_VALUE(a)       (a->type_ == ValueT_Upvalue ?               \
+                                 SetUpvalueValue(state_->GetGC(), a->upvalue_) : a)
 
 #define GET_REGISTER_ABC(i)                                 \
     a = GET_REGISTER_A(i);                                  \
@@ -52,6 +75,25 @@ namespace luna
             ExecuteFrame();
     }
 
+    void VM::CallFunction(Value *f, int arg_count, int expect_result)
+    {
+        assert(f->type_ == ValueT_Closure || f->type_ == ValueT_CFunction);
+        state_->stack_.top_ = f + 1 + arg_count;
+
+        if (f->type_ == ValueT_Closure)
+        {
+            // Execute frames until the closure returned
+            auto level = state_->calls_.size();
+            CallClosure(f, expect_result);
+            while (state_->calls_.size() > level)
+                ExecuteFrame();
+        }
+        else
+        {
+            CallCFunction(f, expect_result);
+        }
+    }
+
     void VM::ExecuteFrame()
     {
         CallInfo *call = &state_->calls_.back();
@@ -84,12 +126,12 @@ namespace luna
                 case OpType_LoadConst:
                     a = GET_REGISTER_A(i);
                     b = GET_CONST_VALUE(i);
-                    *GET_REAL_VALUE(a) = *b;
+                    *SET_REAL_VALUE(a) = *b;
                     break;
                 case OpType_Move:
                     a = GET_REGISTER_A(i);
                     b = GET_REGISTER_B(i);
-                    *GET_REAL_VALUE(a) = *GET_REAL_VALUE(b);
+                    *SET_REAL_VALUE(a) = *GET_REAL_VALUE(b);
                     break;
                 case OpType_Call:
                     a = GET_REGISTER_A(i);
@@ -98,22 +140,24 @@ namespace luna
                 case OpType_GetUpvalue:
                     a = GET_REGISTER_A(i);
                     b = GET_UPVALUE_B(i)->GetValue();
-                    *GET_REAL_VALUE(a) = *b;
+                    *SET_REAL_VALUE(a) = *b;
                     break;
                 case OpType_SetUpvalue:
                     a = GET_REGISTER_A(i);
                     b = GET_UPVALUE_B(i)->GetValue();
                     *b = *a;
+                    CHECK_BARRIER(state_->GetGC(), GET_UPVALUE_B(i));
                     break;
                 case OpType_GetGlobal:
                     a = GET_REGISTER_A(i);
                     b = GET_CONST_VALUE(i);
-                    *GET_REAL_VALUE(a) = state_->global_.table_->GetValue(*b);
+                    *SET_REAL_VALUE(a) = state_->global_.table_->GetValue(*b);
                     break;
                 case OpType_SetGlobal:
                     a = GET_REGISTER_A(i);
                     b = GET_CONST_VALUE(i);
                     state_->global_.table_->SetValue(*b, *a);
+                    CHECK_BARRIER(state_->GetGC(), state_->global_.table_);
                     break;
                 case OpType_Closure:
                     a = GET_REGISTER_A(i);
@@ -146,8 +190,10 @@ namespace luna
                     break;
                 case OpType_Neg:
                     a = GET_REGISTER_A(i);
-                    CheckType(a, ValueT_Number, "neg");
-                    a->num_ = -a->num_;
+                    if (a->type_ == ValueT_Number)
+                        a->num_ = -a->num_;
+                    else
+                        UnaryMeta(a, MetaEvent_Unm, "neg");
                     break;
                 case OpType_Not:
                     a = GET_REGISTER_A(i);
@@ -155,6 +201,13 @@ namespace luna
                     break;
                 case OpType_Len:
                     a = GET_REGISTER_A(i);
+                    if (a->type_ == ValueT_Table &&
+                        MayHaveMeta(a->table_, MetaEvent_Len))
+                    {
+                        LenMeta(a);
+                        break;
+                    }
+
                     if (a->type_ == ValueT_Table)
                         a->num_ = a->table_->ArraySize();
                     else if (a->type_ == ValueT_String)
@@ -165,39 +218,75 @@ namespace luna
                     break;
                 case OpType_Add:
                     GET_REGISTER_ABC(i);
-                    CheckArithType(b, c, "add");
-                    a->num_ = b->num_ + c->num_;
-                    a->type_ = ValueT_Number;
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
+                    {
+                        a->num_ = b->num_ + c->num_;
+                        a->type_ = ValueT_Number;
+                    }
+                    else
+                    {
+                        ArithMeta(a, b, c, MetaEvent_Add, "add");
+                    }
                     break;
                 case OpType_Sub:
                     GET_REGISTER_ABC(i);
-                    CheckArithType(b, c, "sub");
-                    a->num_ = b->num_ - c->num_;
-                    a->type_ = ValueT_Number;
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
+                    {
+                        a->num_ = b->num_ - c->num_;
+                        a->type_ = ValueT_Number;
+                    }
+                    else
+                    {
+                        ArithMeta(a, b, c, MetaEvent_Sub, "sub");
+                    }
                     break;
                 case OpType_Mul:
                     GET_REGISTER_ABC(i);
-                    CheckArithType(b, c, "multiply");
-                    a->num_ = b->num_ * c->num_;
-                    a->type_ = ValueT_Number;
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
+                    {
+                        a->num_ = b->num_ * c->num_;
+                        a->type_ = ValueT_Number;
+                    }
+                    else
+                    {
+                        ArithMeta(a, b, c, MetaEvent_Mul, "multiply");
+                    }
                     break;
                 case OpType_Div:
                     GET_REGISTER_ABC(i);
-                    CheckArithType(b, c, "div");
-                    a->num_ = b->num_ / c->num_;
-                    a->type_ = ValueT_Number;
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
+                    {
+                        a->num_ = b->num_ / c->num_;
+                        a->type_ = ValueT_Number;
+                    }
+                    else
+                    {
+                        ArithMeta(a, b, c, MetaEvent_Div, "div");
+                    }
                     break;
                 case OpType_Pow:
                     GET_REGISTER_ABC(i);
-                    CheckArithType(b, c, "power");
-                    a->num_ = pow(b->num_, c->num_);
-                    a->type_ = ValueT_Number;
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
+                    {
+                        a->num_ = pow(b->num_, c->num_);
+                        a->type_ = ValueT_Number;
+                    }
+                    else
+                    {
+                        ArithMeta(a, b, c, MetaEvent_Pow, "power");
+                    }
                     break;
                 case OpType_Mod:
                     GET_REGISTER_ABC(i);
-                    CheckArithType(b, c, "mod");
-                    a->num_ = fmod(b->num_, c->num_);
-                    a->type_ = ValueT_Number;
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
+                    {
+                        a->num_ = fmod(b->num_, c->num_);
+                        a->type_ = ValueT_Number;
+                    }
+                    else
+                    {
+                        ArithMeta(a, b, c, MetaEvent_Mod, "mod");
+                    }
                     break;
                 case OpType_Concat:
                     GET_REGISTER_ABC(i);
@@ -205,58 +294,79 @@ namespace luna
                     break;
                 case OpType_Less:
                     GET_REGISTER_ABC(i);
-                    CheckInequalityType(b, c, "compare(<)");
-                    if (b->type_ == ValueT_Number)
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
                         a->SetBool(b->num_ < c->num_);
-                    else
+                    else if (b->type_ == ValueT_String && c->type_ == ValueT_String)
                         a->SetBool(*b->str_ < *c->str_);
+                    else
+                        a->SetBool(CompareMeta(b, c, MetaEvent_Lt, "compare(<)"));
                     break;
                 case OpType_Greater:
                     GET_REGISTER_ABC(i);
-                    CheckInequalityType(b, c, "compare(>)");
-                    if (b->type_ == ValueT_Number)
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
                         a->SetBool(b->num_ > c->num_);
-                    else
+                    else if (b->type_ == ValueT_String && c->type_ == ValueT_String)
                         a->SetBool(*b->str_ > *c->str_);
+                    else
+                        a->SetBool(CompareMeta(c, b, MetaEvent_Lt, "compare(>)"));
                     break;
                 case OpType_Equal:
                     GET_REGISTER_ABC(i);
-                    a->SetBool(*b == *c);
+                    a->SetBool(*b == *c ||
+                               (b->type_ == ValueT_Table && c->type_ == ValueT_Table &&
+                                EqualMeta(b, c)));
                     break;
                 case OpType_UnEqual:
                     GET_REGISTER_ABC(i);
-                    a->SetBool(*b != *c);
+                    a->SetBool(*b != *c &&
+                               !(b->type_ == ValueT_Table && c->type_ == ValueT_Table &&
+                                 EqualMeta(b, c)));
                     break;
                 case OpType_LessEqual:
                     GET_REGISTER_ABC(i);
-                    CheckInequalityType(b, c, "compare(<=)");
-                    if (b->type_ == ValueT_Number)
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
                         a->SetBool(b->num_ <= c->num_);
-                    else
+                    else if (b->type_ == ValueT_String && c->type_ == ValueT_String)
                         a->SetBool(*b->str_ <= *c->str_);
+                    else
+                        a->SetBool(CompareMeta(b, c, MetaEvent_Le, "compare(<=)"));
                     break;
                 case OpType_GreaterEqual:
                     GET_REGISTER_ABC(i);
-                    CheckInequalityType(b, c, "compare(>=)");
-                    if (b->type_ == ValueT_Number)
+                    if (b->type_ == ValueT_Number && c->type_ == ValueT_Number)
                         a->SetBool(b->num_ >= c->num_);
-                    else
+                    else if (b->type_ == ValueT_String && c->type_ == ValueT_String)
                         a->SetBool(*b->str_ >= *c->str_);
+                    else
+                        a->SetBool(CompareMeta(c, b, MetaEvent_Le, "compare(>=)"));
                     break;
                 case OpType_NewTable:
                     a = GET_REGISTER_A(i);
-                    a->table_ = state_->NewTable();
+                    a->table_ = state_->NewTable(
+                        proto->GetTableSite(Instruction::GetParamBx(i)));
                     a->type_ = ValueT_Table;
                     break;
                 case OpType_SetTable:
                     GET_REGISTER_ABC(i);
                     CheckTableType(a, b, "set", "to");
-                    a->table_->SetValue(*b, *c);
+                    if (MayHaveMeta(a->table_, MetaEvent_NewIndex))
+                    {
+                        SetTableMeta(a, b, c);
+                    }
+                    else
+                    {
+                        CheckTableWritable(a, b);
+                        a->table_->SetValue(*b, *c);
+                        CHECK_BARRIER(state_->GetGC(), a->table_);
+                    }
                     break;
                 case OpType_GetTable:
                     GET_REGISTER_ABC(i);
                     CheckTableType(a, b, "get", "from");
-                    *c = a->table_->GetValue(*b);
+                    if (MayHaveMeta(a->table_, MetaEvent_Index))
+                        GetTableMeta(a, b, c);
+                    else
+                        *c = a->table_->GetValue(*b);
                     break;
                 case OpType_ForInit:
                     GET_REGISTER_ABC(i);
@@ -293,6 +403,17 @@ namespace luna
         if (arg_count != EXP_VALUE_COUNT_ANY)
             state_->stack_.top_ = a + 1 + arg_count;
 
+        // Call metamethod '__call' with table as first argument
+        Value method;
+        if (a->type_ == ValueT_Table && GetMetamethod(a, MetaEvent_Call, &method))
+        {
+            Value *top = state_->stack_.top_;
+            for (Value *v = top; v > a; --v)
+                *v = *(v - 1);
+            state_->stack_.top_ = top + 1;
+            *a = method;
+        }
+
         int expect_result = Instruction::GetParamC(i) - 1;
         if (a->type_ == ValueT_Closure)
         {
@@ -393,13 +514,14 @@ namespace luna
         GET_CALLINFO_AND_PROTO();
         auto a_proto = proto->GetChildFunction(Instruction::GetParamBx(i));
         a->type_ = ValueT_Closure;
-        a->closure_ = state_->NewClosure();
+        a->closure_ = state_->NewClosure(a_proto->GetClosureSite());
         a->closure_->SetPrototype(a_proto);
 
         // Prepare all upvalues
         auto new_closure = a->closure_;
         auto closure = call->func_->closure_;
         auto count = a_proto->GetUpvalueCount();
+        auto bytes = new_closure->GetMemorySize();
         for (std::size_t i = 0; i < count; ++i)
         {
             auto upvalue_info = a_proto->GetUpvalue(i);
@@ -427,6 +549,10 @@ namespace luna
                 new_closure->AddUpvalue(upvalue);
             }
         }
+
+        // Closure of pretenured site is old, barrier it for new upvalues
+        state_->GetGC().ResizeObject(new_closure, bytes);
+        CHECK_BARRIER(state_->GetGC(), new_closure);
     }
 
     void VM::CopyVarArg(Value *a, Instruction i)
@@ -492,23 +618,31 @@ namespace luna
 
     void VM::Concat(Value *dst, Value *op1, Value *op2)
     {
-        if (op1->type_ == ValueT_String && op2->type_ == ValueT_String)
-        {
-            dst->str_ = state_->GetString(op1->str_->GetStdString() +
-                                          op2->str_->GetCStr());
-        }
-        else if (op1->type_ == ValueT_String && op2->type_ == ValueT_Number)
+        bool is_string1 = op1->type_ == ValueT_String;
+        bool is_string2 = op2->type_ == ValueT_String;
+        if ((is_string1 && (is_string2 || op2->type_ == ValueT_Number)) ||
+            (is_string2 && op1->type_ == ValueT_Number))
         {
-            dst->str_ = state_->GetString(op1->str_->GetCStr() +
-                                          NumberToStr(op2));
-        }
-        else if (op1->type_ == ValueT_Number && op2->type_ == ValueT_String)
-        {
-            dst->str_ = state_->GetString(NumberToStr(op1) +
-                                          op2->str_->GetCStr());
+            char buffer1[kNumberBufferSize];
+            char buffer2[kNumberBufferSize];
+            const char *s1 = nullptr;
+            const char *s2 = nullptr;
+            auto len1 = GetConcatChars(op1, buffer1, &s1);
+            auto len2 = GetConcatChars(op2, buffer2, &s2);
+
+            std::string str;
+            str.reserve(len1 + len2);
+            str.append(s1, len1);
+            str.append(s2, len2);
+            dst->str_ = state_->GetString(str.data(), str.size());
         }
         else
         {
+            Value method;
+            if (GetMetamethod(op1, MetaEvent_Concat, &method) ||
+                GetMetamethod(op2, MetaEvent_Concat, &method))
+                return CallMetamethod(method, op1, op2, nullptr, dst);
+
             auto line = GetCurrentInstructionLine();
             throw RuntimeException(op1, op2, "concat", line);
         }
@@ -633,6 +767,11 @@ namespace luna
                      error->arg_index_ + 1, arg->TypeName(),
                      Value::TypeName(error->expect_type_));
         }
+        else if (error->type_ == CFuntionErrorType_ArgValue)
+        {
+            snprintf(buffer, sizeof(buffer), "argument #%d %s",
+                     error->arg_index_ + 1, error->arg_desc_.c_str());
+        }
 
         // Pop the c function CallInfo, then GetCurrentInstructionLine
         // can calculate line number of the call
@@ -641,42 +780,196 @@ namespace luna
         throw RuntimeException(buffer, line);
     }
 
-    void VM::CheckType(const Value *v, ValueT type, const char *op) const
+    void VM::CheckTableType(const Value *t, const Value *k,
+                            const char *op, const char *desc) const
+    {
+        if (t->type_ != ValueT_Table)
+        {
+            auto ns = GetOperandNameAndScope(t);
+            auto line = GetCurrentInstructionLine();
+            auto key_name = k->type_ == ValueT_String ? k->str_->GetCStr() : "?";
+            std::string op_desc = std::string(op) + " table key '" + key_name + "' " + desc;
+            throw RuntimeException(t, ns.first, ns.second, op_desc.c_str(), line);
+        }
+    }
+
+    bool VM::GetMetamethod(const Value *v, MetaEvent event, Value *method)
+    {
+        if (v->type_ != ValueT_Table)
+            return false;
+
+        Table *mt = v->table_->GetMetatable();
+        if (!mt || mt->IsMetaEventAbsent(event))
+            return false;
+
+        *method = mt->GetMetamethod(event, state_->GetMetaEventName(event));
+        return method->type_ != ValueT_Nil;
+    }
+
+    void VM::CallMetamethod(const Value &method, const Value *arg1,
+                            const Value *arg2, const Value *arg3,
+                            Value *result)
+    {
+        if (method.type_ != ValueT_Closure && method.type_ != ValueT_CFunction)
+        {
+            auto line = GetCurrentInstructionLine();
+            std::string desc = std::string("attempt to call metamethod (a ") +
+                method.TypeName() + " value)";
+            throw RuntimeException(desc.c_str(), line);
+        }
+
+        // Call metamethod after all registers of current function
+        Value *top = state_->stack_.top_;
+        Value *base = top;
+        auto call = &state_->calls_.back();
+        if (call->func_ && call->func_->type_ == ValueT_Closure)
+        {
+            auto proto = call->func_->closure_->GetPrototype();
+            base = std::max(base, call->register_ + proto->GetRegisterCount());
+        }
+
+        if (base + 4 > &state_->stack_.stack_.back())
+        {
+            auto line = GetCurrentInstructionLine();
+            throw RuntimeException("stack overflow in metamethod", line);
+        }
+
+        int arg_count = arg3 ? 3 : 2;
+        base[0] = method;
+        base[1] = *arg1;
+        base[2] = *arg2;
+        if (arg3)
+            base[3] = *arg3;
+
+        CallFunction(base, arg_count, 1);
+        if (result)
+            *result = *base;
+
+        // Registers between top and base are still in use
+        state_->stack_.top_ = top;
+    }
+
+    void VM::GetTableMeta(const Value *t, const Value *k, Value *result)
+    {
+        Value table = *t;
+        Value key = *k;
+        for (int loop = 0; loop < kMaxMetaLoop; ++loop)
+        {
+            Value value = table.table_->GetValue(key);
+            Value method;
+            if (value.type_ != ValueT_Nil ||
+                !GetMetamethod(&table, MetaEvent_Index, &method))
+            {
+                *result = value;
+                return ;
+            }
+
+            // Index '__index' table again
+            if (method.type_ != ValueT_Table)
+                return CallMetamethod(method, &table, &key, nullptr, result);
+            table = method;
+        }
+
+        auto line = GetCurrentInstructionLine();
+        throw RuntimeException("'__index' chain is too long", line);
+    }
+
+    void VM::SetTableMeta(const Value *t, const Value *k, const Value *v)
     {
-        if (v->type_ != type)
-            ReportTypeError(v, op);
+        Value table = *t;
+        for (int loop = 0; loop < kMaxMetaLoop; ++loop)
+        {
+            // '__newindex' is used only when key is absent
+            Value method;
+            if (table.table_->GetValue(*k).type_ != ValueT_Nil ||
+                !GetMetamethod(&table, MetaEvent_NewIndex, &method))
+            {
+                CheckTableWritable(&table, k);
+                table.table_->SetValue(*k, *v);
+                CHECK_BARRIER(state_->GetGC(), table.table_);
+                return ;
+            }
+
+            // Assign to '__newindex' table again
+            if (method.type_ != ValueT_Table)
+                return CallMetamethod(method, &table, k, v, nullptr);
+            table = method;
+        }
+
+        auto line = GetCurrentInstructionLine();
+        throw RuntimeException("'__newindex' chain is too long", line);
     }
 
-    void VM::CheckArithType(const Value *v1, const Value *v2, const char *op) const
+    void VM::ArithMeta(Value *dst, const Value *op1, const Value *op2,
+                       MetaEvent event, const char *op)
     {
-        if (v1->type_ != ValueT_Number || v2->type_ != ValueT_Number)
+        Value method;
+        if (!GetMetamethod(op1, event, &method) &&
+            !GetMetamethod(op2, event, &method))
         {
             auto line = GetCurrentInstructionLine();
-            throw RuntimeException(v1, v2, op, line);
+            throw RuntimeException(op1, op2, op, line);
         }
+
+        CallMetamethod(method, op1, op2, nullptr, dst);
     }
 
-    void VM::CheckInequalityType(const Value *v1, const Value *v2,
-                                 const char *op) const
+    void VM::UnaryMeta(Value *a, MetaEvent event, const char *op)
     {
-        if (v1->type_ != v2->type_ ||
-            (v1->type_ != ValueT_Number && v1->type_ != ValueT_String))
+        Value method;
+        if (!GetMetamethod(a, event, &method))
+            ReportTypeError(a, op);
+
+        CallMetamethod(method, a, a, nullptr, a);
+    }
+
+    void VM::LenMeta(Value *a)
+    {
+        Value method;
+        if (GetMetamethod(a, MetaEvent_Len, &method))
+            return CallMetamethod(method, a, a, nullptr, a);
+
+        a->num_ = a->table_->ArraySize();
+        a->type_ = ValueT_Number;
+    }
+
+    bool VM::EqualMeta(const Value *op1, const Value *op2)
+    {
+        Value method;
+        if (!GetMetamethod(op1, MetaEvent_Eq, &method) &&
+            !GetMetamethod(op2, MetaEvent_Eq, &method))
+            return false;
+
+        Value result;
+        CallMetamethod(method, op1, op2, nullptr, &result);
+        return !result.IsFalse();
+    }
+
+    bool VM::CompareMeta(const Value *op1, const Value *op2,
+                         MetaEvent event, const char *op)
+    {
+        Value method;
+        if (!GetMetamethod(op1, event, &method) &&
+            !GetMetamethod(op2, event, &method))
         {
             auto line = GetCurrentInstructionLine();
-            throw RuntimeException(v1, v2, op, line);
+            throw RuntimeException(op1, op2, op, line);
         }
+
+        Value result;
+        CallMetamethod(method, op1, op2, nullptr, &result);
+        return !result.IsFalse();
     }
 
-    void VM::CheckTableType(const Value *t, const Value *k,
-                            const char *op, const char *desc) const
+    void VM::CheckTableWritable(const Value *t, const Value *k) const
     {
-        if (t->type_ != ValueT_Table)
+        if (t->table_->IsFrozen())
         {
-            auto ns = GetOperandNameAndScope(t);
             auto line = GetCurrentInstructionLine();
             auto key_name = k->type_ == ValueT_String ? k->str_->GetCStr() : "?";
-            std::string op_desc = std::string(op) + " table key '" + key_name + "' " + desc;
-            throw RuntimeException(t, ns.first, ns.second, op_desc.c_str(), line);
+            std::string desc = std::string("attempt to set table key '") +
+                key_name + "' to frozen table";
+            throw RuntimeException(desc.c_str(), line);
         }
     }
 
@@ -2,6 +2,7 @@
 #define VM_H
 
 #include "Value.h"
+#include "Table.h"
 #include "OpCode.h"
 #include <utility>
 
@@ -16,6 +17,10 @@ namespace luna
 
         void Execute();
 
+        // Call function 'f' with 'arg_count' args which after 'f' on stack,
+        // results are copied to stack start from 'f'
+        void CallFunction(Value *f, int arg_count, int expect_result);
+
     private:
         void ExecuteFrame();
 
@@ -39,19 +44,40 @@ namespace luna
 
         void CheckCFuntionError() const;
 
-        void CheckType(const Value *v, ValueT type, const char *op) const;
+        void CheckTableType(const Value *t, const Value *k,
+                            const char *op, const char *desc) const;
 
-        void CheckArithType(const Value *v1, const Value *v2,
-                            const char *op) const;
+        // Get metamethod of 'event' from metatable of 'v', return false
+        // when there is no such metamethod
+        bool GetMetamethod(const Value *v, MetaEvent event, Value *method);
 
-        void CheckInequalityType(const Value *v1, const Value *v2,
-                                 const char *op) const;
+        // Call metamethod with args, 'arg3' and 'result' can be nullptr
+        void CallMetamethod(const Value &method, const Value *arg1,
+                            const Value *arg2, const Value *arg3,
+                            Value *result);
 
-        void CheckTableType(const Value *t, const Value *k,
-                            const char *op, const char *desc) const;
+        // Get and set table value through '__index' and '__newindex'
+        void GetTableMeta(const Value *t, const Value *k, Value *result);
+        void SetTableMeta(const Value *t, const Value *k, const Value *v);
+
+        // Operators on values which are not numbers or strings,
+        // report error when there is no metamethod
+        void ArithMeta(Value *dst, const Value *op1, const Value *op2,
+                       MetaEvent event, const char *op);
+        void UnaryMeta(Value *a, MetaEvent event, const char *op);
+        void LenMeta(Value *a);
+        bool EqualMeta(const Value *op1, const Value *op2);
+        bool CompareMeta(const Value *op1, const Value *op2,
+                         MetaEvent event, const char *op);
+
+        // Report error when table 't' is frozen
+        void CheckTableWritable(const Value *t, const Value *k) const;
 
         void ReportTypeError(const Value *v, const char *op) const;
 
+        // Max chain length of '__index' and '__newindex' tables
+        static const int kMaxMetaLoop = 100;
+
         State *state_;
     };
 } // namespace luna
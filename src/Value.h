@@ -2,13 +2,13 @@
 #define VALUE_H
 
 #include "GC.h"
+#include "String.h"
 #include <functional>
 
 namespace luna
 {
 #define EXP_VALUE_COUNT_ANY -1
 
-    class String;
     class Closure;
     class Upvalue;
     class Table;
@@ -66,7 +66,8 @@ namespace luna
                  (left.type_ == ValueT_Bool && left.bvalue_ == right.bvalue_) ||
                  (left.type_ == ValueT_Number && left.num_ == right.num_) ||
                  (left.type_ == ValueT_Obj && left.obj_ == right.obj_) ||
-                 (left.type_ == ValueT_String && left.str_ == right.str_) ||
+                 (left.type_ == ValueT_String && (left.str_ == right.str_ ||
+                    (left.str_->IsLong() && *left.str_ == *right.str_))) ||
                  (left.type_ == ValueT_Closure && left.closure_ == right.closure_) ||
                  (left.type_ == ValueT_Upvalue && left.upvalue_ == right.upvalue_) ||
                  (left.type_ == ValueT_Table && left.table_ == right.table_) ||
@@ -93,7 +94,8 @@ namespace std
             else if (t.type_ == luna::ValueT_Number)
                 return hash<double>()(t.num_);
             else if (t.type_ == luna::ValueT_String)
-                return hash<void *>()(t.str_);
+                return t.str_->IsLong() ? t.str_->GetHash() :
+                    hash<void *>()(t.str_);
             else if (t.type_ == luna::ValueT_Closure)
                 return hash<void *>()(t.closure_);
             else if (t.type_ == luna::ValueT_Upvalue)
@@ -0,0 +1,394 @@
+#include "Benchmark.h"
+#include "../src/GC.h"
+#include "../src/Table.h"
+#include "../src/Function.h"
+#include "../src/Upvalue.h"
+#include "../src/String.h"
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <string>
+
+namespace
+{
+    // Objects are allocated in scopes like test/GCTest.cpp, objects of
+    // current scope are roots, and few of them are moved to globals
+    class GCWorkload
+    {
+    public:
+        GCWorkload() : rng_(0x5EED)
+        {
+            gc_.SetRootTraveller([this](luna::GCObjectVisitor *v) {
+                VisitScope(v);
+            }, [this](luna::GCObjectVisitor *v) {
+                for (auto t : global_tables_)
+                    t->Accept(v);
+                VisitScope(v);
+            });
+            proto_ = gc_.NewFunction();
+            global_tables_.push_back(gc_.NewTable(luna::GCGen2));
+        }
+
+        // Allocate 'count' objects in scopes of 'scope_size' objects
+        void Run(int count, int scope_size, bool mixed)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                if (i % scope_size == 0)
+                {
+                    scope_tables_.clear();
+                    scope_strings_.clear();
+                    scope_closures_.clear();
+                    gc_.CheckGC();
+                }
+
+                if (mixed)
+                    NewRandomObject();
+                else
+                    scope_tables_.push_back(gc_.NewTable());
+            }
+        }
+
+        void NewStrings(int count, int scope_size)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                if (i % scope_size == 0)
+                {
+                    scope_strings_.clear();
+                    gc_.CheckGC();
+                }
+                scope_strings_.push_back(NewString());
+            }
+        }
+
+    private:
+        void VisitScope(luna::GCObjectVisitor *v)
+        {
+            proto_->Accept(v);
+            for (auto t : scope_tables_)
+                t->Accept(v);
+            for (auto s : scope_strings_)
+                s->Accept(v);
+            for (auto c : scope_closures_)
+                c->Accept(v);
+        }
+
+        luna::String * NewString()
+        {
+            static const char kText[] =
+                "the quick brown fox jumps over the lazy dog, "
+                "pack my box with five dozen liquor jugs; "
+                "how vexingly quick daft zebras jump!";
+            auto r = rng_();
+            auto len = 4 + r % 40;
+            auto str = kText + (r >> 8) % (sizeof(kText) - 44);
+            auto hash = luna::String::Hash(str, len, 0);
+            return gc_.NewString(str, len, hash);
+        }
+
+        void NewRandomObject()
+        {
+            auto percent = rng_() % 100;
+            if (percent < 40)
+            {
+                auto t = gc_.NewTable();
+                luna::Value key;
+                key.type_ = luna::ValueT_String;
+                key.str_ = NewString();
+                luna::Value value;
+                value.type_ = luna::ValueT_Number;
+                value.num_ = percent;
+                t->SetValue(key, value);
+                scope_tables_.push_back(t);
+            }
+            else if (percent < 75)
+            {
+                scope_strings_.push_back(NewString());
+            }
+            else if (percent < 95)
+            {
+                auto c = gc_.NewClosure();
+                auto bytes = c->GetMemorySize();
+                c->SetPrototype(proto_);
+                c->AddUpvalue(gc_.NewUpvalue());
+                gc_.ResizeObject(c, bytes);
+                scope_closures_.push_back(c);
+            }
+            else if (!scope_tables_.empty())
+            {
+                // Keep object alive in global table
+                luna::Value key;
+                key.type_ = luna::ValueT_Number;
+                key.num_ = rng_() % 256;
+                luna::Value value;
+                value.type_ = luna::ValueT_Table;
+                value.table_ = scope_tables_.back();
+                global_tables_.front()->SetValue(key, value);
+                CHECK_BARRIER(gc_, global_tables_.front());
+            }
+        }
+
+        std::mt19937 rng_;
+        luna::GC gc_;
+        luna::Function *proto_;
+        std::deque<luna::Table *> global_tables_;
+        std::deque<luna::Table *> scope_tables_;
+        std::deque<luna::String *> scope_strings_;
+        std::deque<luna::Closure *> scope_closures_;
+    };
+} // namespace
+
+BENCHMARK_CASE(gc_alloc)
+{
+    const int kCount = 2000000;
+
+    {
+        GCWorkload workload;
+        BenchmarkTimer timer;
+        workload.Run(kCount, 100, false);
+        Report("alloc empty tables", timer.ElapsedMilliseconds());
+    }
+
+    {
+        GCWorkload workload;
+        BenchmarkTimer timer;
+        workload.NewStrings(kCount, 100);
+        Report("alloc short strings", timer.ElapsedMilliseconds());
+    }
+
+    {
+        GCWorkload workload;
+        BenchmarkTimer timer;
+        workload.Run(kCount, 1000, true);
+        Report("alloc mixed objects", timer.ElapsedMilliseconds());
+    }
+
+    Report("script short-lived objects", RunScript(R"(
+        local n = 0
+        for i = 1, 500000 do
+            local t = { i }
+            local f = function() return t end
+            n = n + #f()
+        end
+    )"));
+}
+
+BENCHMARK_CASE(gc_pause)
+{
+    // Large live heap of old tables of tables, and garbage tables
+    // allocated after it, pause includes allocation which may sweep
+    auto run = [this](bool incremental, luna::GC::SweepMode mode,
+                      const char *name) {
+        luna::GC gc;
+        std::deque<luna::Table *> roots;
+        auto root = [&](luna::GCObjectVisitor *v) {
+            for (auto t : roots)
+                t->Accept(v);
+        };
+        gc.SetRootTraveller(root, root);
+        gc.SetIncremental(incremental);
+        gc.SetSweepMode(mode);
+
+        auto global = gc.NewTable(luna::GCGen2);
+        roots.push_back(global);
+        for (int i = 1; i <= 1000; ++i)
+        {
+            auto t = gc.NewTable(luna::GCGen1);
+            luna::Value value;
+            value.type_ = luna::ValueT_Table;
+            for (int j = 1; j <= 300; ++j)
+            {
+                value.table_ = gc.NewTable(luna::GCGen1);
+                t->SetArrayValue(j, value);
+            }
+            value.table_ = t;
+            global->SetArrayValue(i, value);
+        }
+
+        double max_pause = 0.0;
+        BenchmarkTimer timer;
+        for (int i = 0; i < 2000000; ++i)
+        {
+            BenchmarkTimer pause_timer;
+            gc.NewTable();
+            gc.CheckGC();
+            max_pause = std::max(max_pause, pause_timer.ElapsedMilliseconds());
+        }
+        Report(std::string(name) + " total", timer.ElapsedMilliseconds());
+        Report(std::string(name) + " max pause", max_pause);
+    };
+
+    run(false, luna::GC::SweepMode_Eager, "atomic eager sweep");
+    run(false, luna::GC::SweepMode_Lazy, "atomic lazy sweep");
+    run(false, luna::GC::SweepMode_Background, "atomic background sweep");
+    run(true, luna::GC::SweepMode_Eager, "incremental eager sweep");
+    run(true, luna::GC::SweepMode_Lazy, "incremental lazy sweep");
+}
+
+BENCHMARK_CASE(gc_parallel_mark)
+{
+    // Full GC of large heap of tables of tables by different count of
+    // mark threads
+    auto run = [this](unsigned int threads) {
+        luna::GC gc;
+        std::deque<luna::Table *> roots;
+        auto root = [&](luna::GCObjectVisitor *v) {
+            for (auto t : roots)
+                t->Accept(v);
+        };
+        gc.SetRootTraveller(root, root);
+        gc.SetIncremental(false);
+        gc.SetMarkThreads(threads);
+
+        auto global = gc.NewTable(luna::GCGen2);
+        roots.push_back(global);
+        for (int i = 1; i <= 2000; ++i)
+        {
+            auto t = gc.NewTable(luna::GCGen1);
+            luna::Value value;
+            value.type_ = luna::ValueT_Table;
+            for (int j = 1; j <= 500; ++j)
+            {
+                value.table_ = gc.NewTable(luna::GCGen1);
+                t->SetArrayValue(j, value);
+            }
+            value.table_ = t;
+            global->SetArrayValue(i, value);
+        }
+
+        BenchmarkTimer timer;
+        for (int i = 0; i < 10; ++i)
+            gc.FullGC();
+        Report(std::to_string(threads) + " mark threads full GC",
+               timer.ElapsedMilliseconds() / 10);
+    };
+
+    run(1);
+    run(2);
+    run(4);
+}
+
+BENCHMARK_CASE(gc_mark)
+{
+    // Mark throughput on graph of tables which have array and hash
+    // parts, values are tables, strings and closures
+    const int kTables = 1000;
+    const int kFields = 200;
+    auto build = [](luna::GC &gc, luna::Table *global,
+                    luna::GCGeneration gen) {
+        auto proto = gc.NewFunction(gen);
+        luna::Value key;
+        luna::Value value;
+        for (int i = 1; i <= kTables; ++i)
+        {
+            auto t = gc.NewTable(gen);
+            for (int j = 1; j <= kFields; ++j)
+            {
+                value.type_ = luna::ValueT_Table;
+                value.table_ = gc.NewTable(gen);
+                t->SetArrayValue(j, value);
+
+                auto name = "field" + std::to_string(j);
+                key.type_ = luna::ValueT_String;
+                key.str_ = gc.NewString(name.c_str(), name.size(),
+                    luna::String::Hash(name.c_str(), name.size(), 0), gen);
+                auto c = gc.NewClosure(gen);
+                auto bytes = c->GetMemorySize();
+                c->SetPrototype(proto);
+                c->AddUpvalue(gc.NewUpvalue(gen));
+                gc.ResizeObject(c, bytes);
+                value.type_ = luna::ValueT_Closure;
+                value.closure_ = c;
+                t->SetValue(key, value);
+            }
+            value.type_ = luna::ValueT_Table;
+            value.table_ = t;
+            global->SetArrayValue(i, value);
+        }
+    };
+
+    {
+        luna::GC gc;
+        std::deque<luna::Table *> roots;
+        auto root = [&](luna::GCObjectVisitor *v) {
+            for (auto t : roots)
+                t->Accept(v);
+        };
+        gc.SetRootTraveller(root, root);
+        gc.SetIncremental(false);
+        roots.push_back(gc.NewTable(luna::GCGen2));
+        build(gc, roots.back(), luna::GCGen1);
+
+        BenchmarkTimer timer;
+        for (int i = 0; i < 10; ++i)
+            gc.FullGC();
+        Report("major mark and sweep", timer.ElapsedMilliseconds() / 10);
+    }
+
+    {
+        // Young graph is marked and promoted by minor GC
+        double total = 0.0;
+        for (int i = 0; i < 10; ++i)
+        {
+            luna::GC gc;
+            std::deque<luna::Table *> roots;
+            auto root = [&](luna::GCObjectVisitor *v) {
+                for (auto t : roots)
+                    t->Accept(v);
+            };
+            gc.SetRootTraveller(root, root);
+            gc.SetSweepMode(luna::GC::SweepMode_Eager);
+            roots.push_back(gc.NewTable(luna::GCGen0));
+            build(gc, roots.back(), luna::GCGen0);
+
+            BenchmarkTimer timer;
+            gc.CheckGC();
+            total += timer.ElapsedMilliseconds();
+        }
+        Report("minor mark and sweep", total / 10);
+    }
+}
+
+BENCHMARK_CASE(gc_pretenure)
+{
+    // One site allocates a long list of tables, and another site
+    // allocates garbage tables
+    auto run = [this](bool pretenuring) {
+        luna::GC gc;
+        luna::Table *head = nullptr;
+        auto root = [&](luna::GCObjectVisitor *v) {
+            if (head)
+                head->Accept(v);
+        };
+        gc.SetRootTraveller(root, root);
+        gc.SetPretenuring(pretenuring);
+
+        auto kept_site = gc.NewAllocSite();
+        auto temp_site = gc.NewAllocSite();
+
+        BenchmarkTimer timer;
+        luna::Value value;
+        value.type_ = luna::ValueT_Table;
+        for (int i = 0; i < 2000000; ++i)
+        {
+            auto t = gc.NewTable(gc.GetAllocSiteGen(kept_site), kept_site);
+            if (head)
+            {
+                value.table_ = head;
+                t->SetArrayValue(1, value);
+                CHECK_BARRIER(gc, t);
+            }
+            head = t;
+
+            for (int j = 0; j < 4; ++j)
+                gc.NewTable(gc.GetAllocSiteGen(temp_site), temp_site);
+            gc.CheckGC();
+        }
+        Report(pretenuring ? "pretenuring" : "no pretenuring",
+               timer.ElapsedMilliseconds());
+    };
+
+    run(false);
+    run(true);
+}
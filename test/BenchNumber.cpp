@@ -0,0 +1,113 @@
+#include "Benchmark.h"
+#include "../src/Number.h"
+#include "../src/State.h"
+#include <random>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+    // Integers, short decimals and random doubles
+    std::vector<double> MakeNumbers()
+    {
+        const int kCount = 100000;
+        std::vector<double> numbers;
+        numbers.reserve(kCount * 3);
+
+        std::mt19937_64 rng(0x5EED);
+        for (int i = 0; i < kCount; ++i)
+            numbers.push_back(static_cast<double>(rng() % 1000000));
+        for (int i = 0; i < kCount; ++i)
+            numbers.push_back(static_cast<double>(rng() % 100000) / 100);
+        for (int i = 0; i < kCount; ++i)
+        {
+            std::uniform_real_distribution<double> dis(-1e10, 1e10);
+            numbers.push_back(dis(rng));
+        }
+        return numbers;
+    }
+} // namespace
+
+BENCHMARK_CASE(number_format)
+{
+    auto numbers = MakeNumbers();
+    char buffer[luna::kNumberBufferSize];
+    std::size_t total = 0;
+
+    BenchmarkTimer printf_timer;
+    for (auto num : numbers)
+        total += snprintf(buffer, sizeof(buffer), "%.17g", num);
+    Report("snprintf %.17g", printf_timer.ElapsedMilliseconds());
+
+    BenchmarkTimer short_printf_timer;
+    for (auto num : numbers)
+        total += snprintf(buffer, sizeof(buffer), "%.14g", num);
+    Report("snprintf %.14g", short_printf_timer.ElapsedMilliseconds());
+
+    BenchmarkTimer format_timer;
+    for (auto num : numbers)
+        total += luna::NumberToString(num, buffer);
+    Report("NumberToString", format_timer.ElapsedMilliseconds());
+
+    Report("script concat numbers", RunScript(R"(
+        local s
+        for i = 1, 300000 do
+            s = "n" .. i / 7
+        end
+    )"));
+
+    Report("table.concat numbers", RunScript(R"(
+        local t = {}
+        for i = 1, 100000 do
+            t[i] = i / 7
+        end
+        local s = table.concat(t, ",")
+    )"));
+
+    // Data file of number literals
+    std::string data("local data = {\n");
+    for (std::size_t i = 0; i < numbers.size(); ++i)
+    {
+        luna::NumberToString(numbers[i], buffer);
+        data.append(buffer);
+        data.append(i % 10 == 9 ? ",\n" : ", ");
+    }
+    data.append("}\n");
+    luna::State state;
+    BenchmarkTimer load_timer;
+    state.LoadString(data, "data");
+    Report("load number literals", load_timer.ElapsedMilliseconds());
+
+    std::vector<std::string> texts;
+    texts.reserve(numbers.size());
+    for (auto num : numbers)
+    {
+        luna::NumberToString(num, buffer);
+        texts.push_back(buffer);
+    }
+
+    BenchmarkTimer strtod_timer;
+    double sum = 0.0;
+    for (const auto &text : texts)
+        sum += strtod(text.c_str(), nullptr);
+    Report("strtod", strtod_timer.ElapsedMilliseconds());
+
+    BenchmarkTimer parse_timer;
+    for (const auto &text : texts)
+    {
+        double num = 0.0;
+        luna::StringToNumber(text.data(), text.size(), &num);
+        sum += num;
+    }
+    Report("StringToNumber", parse_timer.ElapsedMilliseconds());
+
+    Report("tonumber", RunScript(R"(
+        local tonumber = tonumber
+        local sum = 0
+        for i = 1, 300000 do
+            sum = sum + tonumber("12345.678")
+        end
+    )"));
+}
@@ -0,0 +1,333 @@
+#include "Benchmark.h"
+#include "../src/String.h"
+#include "../src/StringPool.h"
+#include "../src/LibUtf8.h"
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+BENCHMARK_CASE(string_pool)
+{
+    const int kCount = 200000;
+    const int kLookupRounds = 10;
+
+    std::vector<std::string> keys;
+    keys.reserve(kCount);
+    for (int i = 0; i < kCount; ++i)
+        keys.push_back("key_" + std::to_string(i * 7919));
+
+    luna::StringPool pool(0x5EED);
+    std::vector<std::unique_ptr<luna::String>> strings;
+    strings.reserve(kCount);
+
+    // Longest insert shows the pause of growing pool
+    double max_pause = 0.0;
+    BenchmarkTimer insert_timer;
+    for (const auto &key : keys)
+    {
+        BenchmarkTimer pause_timer;
+        if (!pool.GetString(key))
+        {
+            auto hash = luna::String::Hash(key.c_str(), key.size(),
+                                           pool.GetSeed());
+            strings.emplace_back(luna::String::Create(key.c_str(),
+                                                      key.size(), hash));
+            pool.AddString(strings.back().get());
+        }
+        max_pause = std::max(max_pause, pause_timer.ElapsedMilliseconds());
+    }
+    Report("insert short strings", insert_timer.ElapsedMilliseconds());
+    Report("max insert pause", max_pause);
+
+    // Pause of rehashing all entries at once
+    std::unordered_map<std::string, luna::String *> map;
+    max_pause = 0.0;
+    for (std::size_t i = 0; i < strings.size(); ++i)
+    {
+        BenchmarkTimer pause_timer;
+        map.emplace(keys[i], strings[i].get());
+        max_pause = std::max(max_pause, pause_timer.ElapsedMilliseconds());
+    }
+    Report("unordered_map max insert pause", max_pause);
+
+    BenchmarkTimer lookup_timer;
+    std::size_t found = 0;
+    for (int r = 0; r < kLookupRounds; ++r)
+    {
+        for (const auto &key : keys)
+            found += pool.GetString(key) ? 1 : 0;
+    }
+    Report("lookup short strings", lookup_timer.ElapsedMilliseconds());
+
+    // Identifiers of script are few and looked up frequently
+    std::vector<std::string> names;
+    for (int i = 0; i < 1000; ++i)
+        names.push_back("identifier_name_" + std::to_string(i));
+    for (const auto &name : names)
+    {
+        auto hash = luna::String::Hash(name.c_str(), name.size(),
+                                       pool.GetSeed());
+        strings.emplace_back(luna::String::Create(name.c_str(),
+                                                  name.size(), hash));
+        pool.AddString(strings.back().get());
+    }
+
+    BenchmarkTimer name_timer;
+    for (int r = 0; r < 2000; ++r)
+    {
+        for (const auto &name : names)
+            found += pool.GetString(name) ? 1 : 0;
+    }
+    Report("lookup identifiers", name_timer.ElapsedMilliseconds());
+
+    for (const auto &s : strings)
+        pool.DeleteString(s.get());
+
+    // Long strings hash every byte by four lanes of words
+    std::string long_str(1024 * 1024, 'x');
+    BenchmarkTimer long_timer;
+    for (int i = 0; i < 100; ++i)
+    {
+        long_str[i] = 'y';
+        found += luna::String::Hash(long_str.c_str(), long_str.size(),
+                                    pool.GetSeed()) & 1;
+    }
+    Report("hash 1MB strings", long_timer.ElapsedMilliseconds());
+
+    // Keep results alive
+    volatile std::size_t sink = found;
+    (void)sink;
+}
+
+BENCHMARK_CASE(string_long)
+{
+    Report("build long strings", RunScript(R"(
+        local s = ""
+        local line = "this is a line of text which is not short, "
+        for i = 1, 20000 do
+            local l = line .. i
+            s = l .. line
+        end
+    )"));
+
+    Report("long string keys", RunScript(R"(
+        local t = {}
+        local prefix = "a long prefix of table keys, longer than short strings "
+        for i = 1, 1000 do t[prefix .. i] = i end
+        local n = 0
+        for r = 1, 20 do
+            for i = 1, 1000 do n = n + t[prefix .. i] end
+        end
+    )"));
+}
+
+BENCHMARK_CASE(string_lib)
+{
+    std::string prepare = R"(
+        local words = { "alpha", "beta", "gamma", "delta", "epsilon" }
+        local t = {}
+        for i = 1, 20000 do
+            t[i] = words[i % 5 + 1] .. "=" .. i
+        end
+        text = table.concat(t, " ")
+    )";
+
+    Report("script upper", RunScript(R"(
+        local text = text
+        local t = {}
+        for i = 1, #text do
+            local c = string.byte(text, i)
+            if c >= 97 and c <= 122 then c = c - 32 end
+            t[i] = string.char(c)
+        end
+        local s = table.concat(t)
+    )", prepare));
+
+    Report("string.upper", RunScript(R"(
+        local text = text
+        local s = string.upper(text)
+    )", prepare));
+
+    Report("script find", RunScript(R"(
+        local text = text
+        local sub = string.sub
+        local count = 0
+        for i = 1, #text - 6 do
+            if sub(text, i, i + 6) == "epsilon" then count = count + 1 end
+        end
+    )", prepare));
+
+    Report("string.find plain", RunScript(R"(
+        local text = text
+        local find = string.find
+        local count = 0
+        local pos = 1
+        while true do
+            local s, e = find(text, "epsilon", pos, true)
+            if not s then break end
+            count = count + 1
+            pos = e + 1
+        end
+    )", prepare));
+
+    Report("string.find prefix", RunScript(R"lua(
+        local text = text
+        local find = string.find
+        local count = 0
+        local pos = 1
+        while true do
+            local s, e = find(text, "epsilon=%d+", pos)
+            if not s then break end
+            count = count + 1
+            pos = e + 1
+        end
+    )lua", prepare));
+
+    Report("script rep", RunScript(R"(
+        for r = 1, 100 do
+            local s = ""
+            for i = 1, 1000 do s = s .. "abc," end
+        end
+    )"));
+
+    Report("string.rep", RunScript(R"(
+        for r = 1, 100 do local s = string.rep("abc", 1000, ",") end
+    )"));
+
+    Report("string.gmatch", RunScript(R"lua(
+        local text = text
+        local sum = 0
+        for k, v in string.gmatch(text, "(%a+)=(%d+)") do
+            sum = sum + #v
+        end
+    )lua", prepare));
+
+    Report("string.gsub", RunScript(R"lua(
+        local text = text
+        local s, n = string.gsub(text, "(%a+)=(%d+)", "%2:%1")
+    )lua", prepare));
+
+    std::string log = R"lua(
+        local levels = { "INFO", "WARN", "ERROR" }
+        local t = {}
+        for i = 1, 5000 do
+            t[i] = "2024-01-15 10:20:" .. i % 60 .. " [" .. levels[i % 3 + 1] ..
+                "] request id=" .. i .. " took " .. i % 97 .. "ms"
+        end
+        lines = t
+    )lua";
+
+    Report("string.gmatch log", RunScript(R"lua(
+        local lines = lines
+        local gmatch = string.gmatch
+        local match = string.match
+        local errors, total = 0, 0
+        for i = 1, #lines do
+            local line = lines[i]
+            for level in gmatch(line, "%[(%u+)%]") do
+                if level == "ERROR" then errors = errors + 1 end
+            end
+            for k, v in gmatch(line, "(%a+)=(%d+)") do
+                total = total + #v
+            end
+            local ms = match(line, "took (%d+)ms$")
+        end
+    )lua", log));
+}
+
+namespace
+{
+    // Count UTF-8 characters byte by byte, return -1 when invalid
+    long long CountCharsByByte(const std::string &text)
+    {
+        long long count = 0;
+        std::size_t i = 0;
+        while (i < text.size())
+        {
+            auto c = static_cast<unsigned char>(text[i]);
+            int extra = c < 0x80 ? 0 : c < 0xC2 ? -1 : c < 0xE0 ? 1 :
+                c < 0xF0 ? 2 : c < 0xF5 ? 3 : -1;
+            if (extra < 0 || i + extra >= text.size() + (extra == 0 ? 1 : 0))
+                return -1;
+            for (int k = 1; k <= extra; ++k)
+            {
+                if ((static_cast<unsigned char>(text[i + k]) & 0xC0) != 0x80)
+                    return -1;
+            }
+            i += extra + 1;
+            ++count;
+        }
+        return count;
+    }
+
+    // Text of 'size' bytes which repeats 'unit'
+    std::string RepeatText(const std::string &unit, std::size_t size)
+    {
+        std::string text;
+        text.reserve(size + unit.size());
+        while (text.size() < size)
+            text.append(unit);
+        return text;
+    }
+} // namespace
+
+BENCHMARK_CASE(utf8)
+{
+    const std::size_t kSize = 8 * 1024 * 1024;
+    const int kRounds = 4;
+
+    struct Input
+    {
+        const char *name_;
+        std::string text_;
+    } inputs[] = {
+        { "ascii", RepeatText("The quick brown fox jumps over the lazy dog. ", kSize) },
+        { "mixed", RepeatText("Gr\xC3\xBC\xC3\x9F Gott, caf\xC3\xA9 na\xC3\xAFve r\xC3\xA9sum\xC3\xA9. ", kSize) },
+        { "cjk", RepeatText("\xE4\xBD\xA0\xE5\xA5\xBD\xE4\xB8\x96\xE7\x95\x8C\xEF\xBC\x8C", kSize) },
+    };
+
+    for (const auto &input : inputs)
+    {
+        long long total = 0;
+        BenchmarkTimer byte_timer;
+        for (int r = 0; r < kRounds; ++r)
+            total += CountCharsByByte(input.text_);
+        Report(std::string("byte loop ") + input.name_,
+               byte_timer.ElapsedMilliseconds());
+
+        const char *s = input.text_.data();
+        const char *end = s + input.text_.size();
+        BenchmarkTimer word_timer;
+        for (int r = 0; r < kRounds; ++r)
+        {
+            std::size_t count = 0;
+            lib::utf8::CountChars(s, end, end, &count);
+            total -= count;
+        }
+        Report(std::string("utf8 kernel ") + input.name_,
+               word_timer.ElapsedMilliseconds());
+
+        if (total != 0)
+            Report("count mismatch", 0);
+    }
+
+    std::string prepare = R"(
+        local t = {}
+        for i = 1, 20000 do
+            t[i] = "caf\xC3\xA9 \xE4\xBD\xA0\xE5\xA5\xBD ascii text "
+        end
+        text = table.concat(t)
+    )";
+
+    Report("utf8.len", RunScript(R"(
+        local len = utf8.len
+        local n = 0
+        for i = 1, 20 do n = n + len(text) end
+    )", prepare));
+
+    Report("utf8.codes", RunScript(R"(
+        local sum = 0
+        for p, c in utf8.codes(text) do sum = sum + c end
+    )", prepare));
+}
@@ -0,0 +1,152 @@
+#include "Benchmark.h"
+
+BENCHMARK_CASE(table_sort)
+{
+    std::string prepare = R"(
+        math.randomseed(1)
+        t = {}
+        for i = 1, 50000 do t[i] = math.random(1, 1000000) end
+    )";
+
+    Report("script quick sort", RunScript(R"(
+        local t = t
+        local function sort(t, lo, hi)
+            while lo < hi do
+                local p = t[lo]
+                local i = lo
+                for j = lo + 1, hi do
+                    if t[j] < p then
+                        i = i + 1
+                        t[i], t[j] = t[j], t[i]
+                    end
+                end
+                t[lo], t[i] = t[i], t[lo]
+                sort(t, lo, i - 1)
+                lo = i + 1
+            end
+        end
+        sort(t, 1, #t)
+    )", prepare));
+
+    Report("table.sort", RunScript(R"(
+        local t = t
+        table.sort(t)
+    )", prepare));
+
+    Report("table.sort with comparator", RunScript(R"(
+        local t = t
+        table.sort(t, function(a, b) return a < b end)
+    )", prepare));
+}
+
+BENCHMARK_CASE(table_concat)
+{
+    std::string prepare = R"(
+        t = {}
+        for i = 1, 5000 do t[i] = "item" .. i end
+    )";
+
+    Report("script concat", RunScript(R"(
+        local t = t
+        local s = ""
+        for i = 1, #t do s = s .. t[i] .. "," end
+    )", prepare));
+
+    Report("table.concat", RunScript(R"(
+        local t = t
+        local s = table.concat(t, ",")
+    )", prepare));
+}
+
+BENCHMARK_CASE(table_insert_remove)
+{
+    std::string prepare = R"(
+        t = {}
+        for i = 1, 2000 do t[i] = i end
+    )";
+
+    Report("script insert/remove at front", RunScript(R"(
+        local t = t
+        for n = 1, 500 do
+            for i = #t, 1, -1 do t[i + 1] = t[i] end
+            t[1] = n
+        end
+        for n = 1, 500 do
+            for i = 1, #t - 1 do t[i] = t[i + 1] end
+            t[#t] = nil
+        end
+    )", prepare));
+
+    Report("table.insert/table.remove at front", RunScript(R"(
+        local t = t
+        for n = 1, 500 do table.insert(t, 1, n) end
+        for n = 1, 500 do table.remove(t, 1) end
+    )", prepare));
+}
+
+BENCHMARK_CASE(table_frozen_lookup)
+{
+    std::string prepare = R"(
+        t = {}
+        keys = {}
+        for i = 1, 1000 do
+            keys[i] = "key" .. i
+            t[keys[i]] = i
+        end
+    )";
+
+    std::string lookup = R"(
+        local t = t
+        local keys = keys
+        local sum = 0
+        for n = 1, 1000 do
+            for i = 1, 1000 do sum = sum + t[keys[i]] end
+        end
+    )";
+
+    Report("lookup in table", RunScript(lookup, prepare));
+    Report("lookup in frozen table",
+           RunScript(lookup, prepare + "table.freeze(t)"));
+}
+
+BENCHMARK_CASE(table_metatable)
+{
+    std::string prepare = R"(
+        Point = {}
+        Point.__index = Point
+        function Point.new(x, y)
+            return setmetatable({ x = x, y = y }, Point)
+        end
+        function Point.sum(p) return p.x + p.y end
+
+        function NewWrapped(x, y)
+            local p = { x = x, y = y }
+            p.sum = function(p) return p.x + p.y end
+            return p
+        end
+    )";
+
+    Report("field access without metatable", RunScript(R"(
+        local p = NewWrapped(1, 2)
+        local s = 0
+        for i = 1, 1000000 do s = s + p.x end
+    )", prepare));
+
+    Report("field access with metatable", RunScript(R"(
+        local p = Point.new(1, 2)
+        local s = 0
+        for i = 1, 1000000 do s = s + p.x end
+    )", prepare));
+
+    Report("method by closure field", RunScript(R"(
+        local p = NewWrapped(1, 2)
+        local s = 0
+        for i = 1, 1000000 do s = s + p:sum() end
+    )", prepare));
+
+    Report("method by __index", RunScript(R"(
+        local p = Point.new(1, 2)
+        local s = 0
+        for i = 1, 1000000 do s = s + p:sum() end
+    )", prepare));
+}
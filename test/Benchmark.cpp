@@ -0,0 +1,105 @@
+#include "Benchmark.h"
+#include "../src/State.h"
+#include "../src/VM.h"
+#include "../src/Bootstrap.h"
+#include "../src/Exception.h"
+#include "../src/LibBase.h"
+#include "../src/LibMath.h"
+#include "../src/LibString.h"
+#include "../src/LibTable.h"
+#include "../src/LibUtf8.h"
+#include <stdio.h>
+#include <vector>
+
+class BenchmarkManager
+{
+public:
+    BenchmarkManager(const BenchmarkManager&) = delete;
+    void operator = (const BenchmarkManager&) = delete;
+
+    static BenchmarkManager& GetInstance()
+    {
+        static BenchmarkManager instance;
+        return instance;
+    }
+
+    void AddBenchmark(BenchmarkBase *benchmark)
+    {
+        all_.push_back(benchmark);
+    }
+
+    void RunAllBenchmark(const char *filter)
+    {
+        for (auto benchmark : all_)
+        {
+            auto name = benchmark->GetBenchmarkName();
+            if (filter && name.find(filter) == std::string::npos)
+                continue;
+
+            printf("[%s]\n", name.c_str());
+            try
+            {
+                benchmark->Run();
+            }
+            catch (const luna::Exception &exp)
+            {
+                printf("\033[31m\t%s\033[0m\n", exp.What().c_str());
+            }
+        }
+    }
+
+private:
+    BenchmarkManager() { }
+
+    std::vector<BenchmarkBase *> all_;
+};
+
+BenchmarkBase::BenchmarkBase()
+{
+    BenchmarkManager::GetInstance().AddBenchmark(this);
+}
+
+std::string BenchmarkBase::GetBenchmarkName() const
+{
+    return benchmark_name_;
+}
+
+void BenchmarkBase::Report(const std::string &item, double milliseconds)
+{
+    printf("\t%-40s %12.3f ms\n", item.c_str(), milliseconds);
+}
+
+double BenchmarkBase::RunScript(const std::string &script,
+                                const std::string &prepare)
+{
+    luna::State state;
+    luna::VM vm(&state);
+    luna::Bootstrap bootstrap(&state);
+
+    lib::base::RegisterLibBase(&state);
+    lib::math::RegisterLibMath(&state);
+    lib::string::RegisterLibString(&state);
+    lib::table::RegisterLibTable(&state);
+    lib::utf8::RegisterLibUtf8(&state);
+
+    if (!prepare.empty())
+    {
+        state.LoadString(prepare, benchmark_name_);
+        bootstrap.Prepare();
+        vm.Execute();
+    }
+
+    state.LoadString(script, benchmark_name_);
+    bootstrap.Prepare();
+
+    BenchmarkTimer timer;
+    vm.Execute();
+    return timer.ElapsedMilliseconds();
+}
+
+int main(int argc, const char **argv)
+{
+    // Run benchmarks which name contains argv[1] when it is present
+    BenchmarkManager::GetInstance().RunAllBenchmark(argc > 1 ? argv[1] : nullptr);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <string>
+
+class BenchmarkBase
+{
+public:
+    BenchmarkBase();
+
+    BenchmarkBase(const BenchmarkBase&) = delete;
+    void operator = (const BenchmarkBase&) = delete;
+
+    std::string GetBenchmarkName() const;
+    virtual void Run() = 0;
+
+protected:
+    // Report the result of one measured item
+    void Report(const std::string &item, double milliseconds);
+
+    // Run script with all libraries, return elapsed milliseconds,
+    // 'prepare' script runs before 'script' and is not measured
+    double RunScript(const std::string &script,
+                     const std::string &prepare = std::string());
+
+    std::string benchmark_name_;
+};
+
+// Timer for measuring elapsed time
+class BenchmarkTimer
+{
+public:
+    BenchmarkTimer() : start_(std::chrono::steady_clock::now()) { }
+
+    double ElapsedMilliseconds() const
+    {
+        auto duration = std::chrono::steady_clock::now() - start_;
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+#define BENCHMARK_CASE(case_name)                           \
+    class Benchmark_##case_name : public BenchmarkBase      \
+    {                                                       \
+    public:                                                 \
+        Benchmark_##case_name();                            \
+        virtual void Run();                                 \
+    } benchmark_##case_name##obj;                           \
+                                                            \
+    Benchmark_##case_name::Benchmark_##case_name()          \
+    {                                                       \
+        benchmark_name_ = #case_name;                       \
+    }                                                       \
+                                                            \
+    void Benchmark_##case_name::Run()
+
+#endif // BENCHMARK_H
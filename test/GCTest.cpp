@@ -10,10 +10,13 @@
 #include <unistd.h>
 #endif // _MSC_VER
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <deque>
 #include <string>
+#include <unordered_set>
 
 luna::GC g_gc(luna::GC::DefaultDeleter(), true);
 std::deque<luna::Table *> g_globalTable;
@@ -63,10 +66,29 @@ void MajorRoot(luna::GCObjectVisitor *v)
     MinorRoot(v);
 }
 
+// Serial reachability of objects from major roots
+class ReachableVisitor : public luna::GCObjectVisitor
+{
+public:
+    virtual bool Visit(luna::Table *t) { return Add(t); }
+    virtual bool Visit(luna::Function *f) { return Add(f); }
+    virtual bool Visit(luna::Closure *c) { return Add(c); }
+    virtual bool Visit(luna::Upvalue *u) { return Add(u); }
+    virtual bool Visit(luna::String *s) { return Add(s); }
+
+    std::unordered_set<luna::GCObject *> objects_;
+
+private:
+    bool Add(luna::GCObject *obj)
+    {
+        return objects_.insert(obj).second;
+    }
+};
+
 luna::Table * RandomTable();
 luna::Function * RandomFunction();
 luna::Closure * RandomClosure();
-luna::String * RandomString();
+luna::String * RandomString(luna::GCGeneration gen = luna::GCGen0);
 luna::Value RandomValue(bool exclude_table = false);
 
 luna::Table * RandomTable()
@@ -87,6 +109,7 @@ luna::Table * RandomTable()
 luna::Function * RandomFunction()
 {
     auto f = g_gc.NewFunction();
+    auto bytes = f->GetMemorySize();
 
     auto s = RandomString();
     f->SetModuleName(s);
@@ -110,6 +133,7 @@ luna::Function * RandomFunction()
     for (int i = 0; i < const_str; ++i)
         f->AddConstString(RandomString());
 
+    g_gc.ResizeObject(f, bytes);
     CHECK_BARRIER(g_gc, f);
 
     return f;
@@ -128,16 +152,15 @@ luna::Closure * RandomClosure()
     return c;
 }
 
-luna::String * RandomString()
+luna::String * RandomString(luna::GCGeneration gen)
 {
     std::string str;
     int count = RandomRange(1, 150);
     for (int i = 0; i < count; ++i)
         str.push_back(RandomRange('a', 'z'));
 
-    auto s = g_gc.NewString();
-    s->SetValue(str);
-    return s;
+    auto hash = luna::String::Hash(str.c_str(), str.size(), 0);
+    return g_gc.NewString(str.c_str(), str.size(), hash, gen);
 }
 
 luna::Value RandomValue(bool exclude_table)
@@ -201,7 +224,7 @@ void NewObjInGlobal()
     }
     else if (percent <= 50)
     {
-        g_globalString.push_back(g_gc.NewString(luna::GCGen2));
+        g_globalString.push_back(RandomString(luna::GCGen2));
     }
     else if (percent <= 60)
     {
@@ -321,7 +344,38 @@ void FreeGlobal(int count)
     }
 }
 
-void RandomLoop()
+// Run full GC with parallel mark, reachable objects must be alive and
+// all other objects must be deleted
+void CheckParallelMark()
+{
+    ReachableVisitor reachable;
+    MajorRoot(&reachable);
+
+    std::unordered_set<luna::GCObject *> deleted;
+    g_gc.ResetDeleter([&](luna::GCObject *obj, unsigned int) {
+        deleted.insert(obj);
+    });
+    g_gc.FullGC();
+    g_gc.ResetDeleter();
+
+    std::size_t lost = 0;
+    for (auto obj : reachable.objects_)
+    {
+        if (deleted.count(obj))
+            ++lost;
+    }
+
+    auto alive = g_gc.GetObjectCount();
+    printf("parallel mark: %zu reachable, %zu alive, %zu deleted\n",
+           reachable.objects_.size(), alive, deleted.size());
+    if (lost != 0 || alive != reachable.objects_.size())
+    {
+        printf("parallel mark mismatch: %zu reachable objects deleted\n", lost);
+        abort();
+    }
+}
+
+void RandomLoop(bool stress)
 {
     int free_global_count_max = 20;
 
@@ -343,6 +397,13 @@ void RandomLoop()
             free_global_count_max = 20;
 
         g_gc.CheckGC();
+        if (stress)
+        {
+            if (RandomNum(10) == 0)
+                CheckParallelMark();
+            continue;
+        }
+
 #ifdef _MSC_VER
         Sleep(RandomRange(1, 20));
 #else
@@ -351,10 +412,33 @@ void RandomLoop()
     }
 }
 
-int main()
+// Run with "parallel [threads]" to stress parallel mark, and with
+// "eager", "lazy" or "background" to select sweep mode
+int main(int argc, const char **argv)
 {
     srand(static_cast<unsigned int>(time(nullptr)));
     g_gc.SetRootTraveller(MinorRoot, MajorRoot);
-    RandomLoop();
+
+    bool stress = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "parallel") == 0)
+        {
+            stress = true;
+            g_gc.SetIncremental(false);
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+                g_gc.SetMarkThreads(atoi(argv[++i]));
+            else
+                g_gc.SetMarkThreads(4);
+        }
+        else if (strcmp(argv[i], "eager") == 0)
+            g_gc.SetSweepMode(luna::GC::SweepMode_Eager);
+        else if (strcmp(argv[i], "lazy") == 0)
+            g_gc.SetSweepMode(luna::GC::SweepMode_Lazy);
+        else if (strcmp(argv[i], "background") == 0)
+            g_gc.SetSweepMode(luna::GC::SweepMode_Background);
+    }
+
+    RandomLoop(stress);
     return 0;
 }
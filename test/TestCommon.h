@@ -8,15 +8,33 @@
 #include "../src/TextInStream.h"
 #include "../src/Exception.h"
 #include "../src/Visitor.h"
+#include "../src/VM.h"
+#include "../src/Bootstrap.h"
+#include "../src/Table.h"
+#include "../src/LibBase.h"
+#include "../src/LibMath.h"
+#include "../src/LibString.h"
+#include "../src/LibTable.h"
+#include "../src/LibUtf8.h"
 #include <functional>
+#include <memory>
 #include <type_traits>
 
+// Create string which is not managed by GC
+inline std::unique_ptr<luna::String> MakeString(const std::string &str,
+                                                std::size_t seed = 0)
+{
+    auto hash = luna::String::Hash(str.c_str(), str.size(), seed);
+    return std::unique_ptr<luna::String>(
+        luna::String::Create(str.c_str(), str.size(), hash));
+}
+
 class ParserWrapper
 {
 public:
     explicit ParserWrapper(const std::string &str = "")
-        : iss_(str), state_(), name_("parser"),
-          lexer_(&state_, &name_, std::bind(&io::text::InStringStream::GetChar, &iss_))
+        : iss_(str), state_(), name_(state_.GetString("parser")),
+          lexer_(&state_, name_, std::bind(&io::text::InStringStream::GetChar, &iss_))
     {
     }
 
@@ -44,7 +62,7 @@ public:
 private:
     io::text::InStringStream iss_;
     luna::State state_;
-    luna::String name_;
+    luna::String *name_;
     luna::Lexer lexer_;
     luna::Parser parser_;
 };
@@ -385,4 +403,64 @@ struct AcceptAST
     { return true; }
 };
 
+// Run scripts with all libraries, results are read from globals
+class ScriptRunner
+{
+public:
+    ScriptRunner()
+        : state_(), vm_(&state_), bootstrap_(&state_)
+    {
+        lib::base::RegisterLibBase(&state_);
+        lib::math::RegisterLibMath(&state_);
+        lib::string::RegisterLibString(&state_);
+        lib::table::RegisterLibTable(&state_);
+        lib::utf8::RegisterLibUtf8(&state_);
+    }
+
+    // Run 'script', exceptions of errors are thrown
+    void Run(const std::string &script)
+    {
+        state_.LoadString(script, "test");
+        bootstrap_.Prepare();
+        vm_.Execute();
+    }
+
+    luna::Value GetGlobal(const char *name)
+    {
+        luna::Value key;
+        key.type_ = luna::ValueT_String;
+        key.str_ = state_.GetString(name);
+        return state_.GetGlobal()->table_->GetValue(key);
+    }
+
+    double GetNumber(const char *name)
+    {
+        auto value = GetGlobal(name);
+        return value.type_ == luna::ValueT_Number ? value.num_ : -1.0;
+    }
+
+    std::string GetString(const char *name)
+    {
+        auto value = GetGlobal(name);
+        return value.type_ == luna::ValueT_String ?
+            value.str_->GetStdString() : "<not string>";
+    }
+
+    bool GetBool(const char *name)
+    {
+        auto value = GetGlobal(name);
+        return value.type_ == luna::ValueT_Bool && value.bvalue_;
+    }
+
+    luna::State * GetState()
+    {
+        return &state_;
+    }
+
+private:
+    luna::State state_;
+    luna::VM vm_;
+    luna::Bootstrap bootstrap_;
+};
+
 #endif // TEST_COMMON_H
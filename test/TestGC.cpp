@@ -0,0 +1,488 @@
+#include "UnitTest.h"
+#include "../src/GC.h"
+#include "../src/Table.h"
+#include "../src/String.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    // GC with table roots, which records sequence of allocating and
+    // deleting objects, since memory of deleted object may be reused
+    class GCWrapper
+    {
+    public:
+        GCWrapper()
+            : sequence_(0),
+              gc_([this](luna::GCObject *obj, unsigned int) {
+                  delete_sequence_[obj] = ++sequence_;
+              })
+        {
+            auto root = [this](luna::GCObjectVisitor *v) {
+                for (auto t : roots_)
+                    t->Accept(v);
+            };
+            gc_.SetRootTraveller(root, root);
+        }
+
+        luna::GC& GetGC()
+        { return gc_; }
+
+        luna::Table * NewTable(luna::GCGeneration gen = luna::GCGen0)
+        {
+            auto t = gc_.NewTable(gen);
+            alloc_sequence_[t] = ++sequence_;
+            return t;
+        }
+
+        void AddRoot(luna::Table *t)
+        { roots_.push_back(t); }
+
+        unsigned int GetSequence() const
+        { return sequence_; }
+
+        // The last object allocated at 'obj' is not deleted
+        bool IsAlive(luna::GCObject *obj) const
+        {
+            auto it = delete_sequence_.find(obj);
+            return it == delete_sequence_.end() ||
+                it->second < alloc_sequence_.at(obj);
+        }
+
+        // Object at 'obj' is deleted after 'sequence'
+        bool IsDeletedAfter(luna::GCObject *obj, unsigned int sequence) const
+        {
+            auto it = delete_sequence_.find(obj);
+            return it != delete_sequence_.end() && it->second > sequence;
+        }
+
+        // Allocate garbage and check GC
+        void Allocate(int count)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                NewTable();
+                gc_.CheckGC();
+            }
+        }
+
+    private:
+        std::vector<luna::Table *> roots_;
+        unsigned int sequence_;
+        std::unordered_map<luna::GCObject *, unsigned int> alloc_sequence_;
+        std::unordered_map<luna::GCObject *, unsigned int> delete_sequence_;
+        luna::GC gc_;
+    };
+
+    void SetArray(luna::GC &gc, luna::Table *t, std::size_t index,
+                  luna::Table *value)
+    {
+        luna::Value v;
+        v.type_ = luna::ValueT_Table;
+        v.table_ = value;
+        t->SetArrayValue(index, v);
+        CHECK_BARRIER(gc, t);
+    }
+} // namespace
+
+TEST_CASE(gc1)
+{
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    gc.SetStepBudget(64);
+
+    // Old objects which are enough to run major GC
+    auto sequence = wrapper.GetSequence();
+    auto root = wrapper.NewTable(luna::GCGen1);
+    wrapper.AddRoot(root);
+    std::vector<luna::Table *> alive;
+    std::vector<luna::Table *> garbage;
+    for (int i = 0; i < 1000; ++i)
+    {
+        alive.push_back(wrapper.NewTable(luna::GCGen1));
+        SetArray(gc, root, i + 1, alive.back());
+        garbage.push_back(wrapper.NewTable(luna::GCGen1));
+    }
+
+    while (!gc.IsMajorGCRunning())
+        wrapper.Allocate(1);
+
+    // Store new objects to marked objects while major GC is running,
+    // barrier keeps them alive
+    std::size_t index = 0;
+    while (gc.IsMajorGCRunning())
+    {
+        auto t = wrapper.NewTable();
+        SetArray(gc, alive[index % alive.size()], 1, t);
+        alive.push_back(t);
+        ++index;
+        wrapper.Allocate(16);
+    }
+
+    for (auto t : alive)
+        EXPECT_TRUE(wrapper.IsAlive(t));
+    for (auto t : garbage)
+        EXPECT_TRUE(wrapper.IsDeletedAfter(t, sequence));
+
+    // Objects stored while sweeping are kept by minor GC
+    wrapper.Allocate(10000);
+    for (auto t : alive)
+        EXPECT_TRUE(wrapper.IsAlive(t));
+}
+
+TEST_CASE(gc2)
+{
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+
+    auto sequence = wrapper.GetSequence();
+    auto root = wrapper.NewTable(luna::GCGen1);
+    wrapper.AddRoot(root);
+    std::vector<luna::Table *> garbage;
+    for (int i = 0; i < 1000; ++i)
+        garbage.push_back(wrapper.NewTable(luna::GCGen1));
+
+    while (!gc.IsMajorGCRunning())
+        wrapper.Allocate(1);
+
+    // Disable incremental GC finishes current major GC
+    gc.SetIncremental(false);
+    EXPECT_TRUE(!gc.IsMajorGCRunning());
+    EXPECT_TRUE(wrapper.IsAlive(root));
+    for (auto t : garbage)
+        EXPECT_TRUE(wrapper.IsDeletedAfter(t, sequence));
+}
+
+TEST_CASE(gc3)
+{
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    gc.SetSweepMode(luna::GC::SweepMode_Lazy);
+
+    // Garbage is not deleted in GC pause
+    auto sequence = wrapper.GetSequence();
+    std::vector<luna::Table *> garbage;
+    while (!gc.IsSweeping())
+    {
+        garbage.push_back(wrapper.NewTable());
+        gc.CheckGC();
+    }
+    for (auto t : garbage)
+        EXPECT_TRUE(!wrapper.IsDeletedAfter(t, sequence));
+
+    // Allocations sweep garbage
+    while (gc.IsSweeping())
+        wrapper.NewTable();
+    for (auto t : garbage)
+        EXPECT_TRUE(wrapper.IsDeletedAfter(t, sequence));
+}
+
+TEST_CASE(gc4)
+{
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    gc.SetSweepMode(luna::GC::SweepMode_Background);
+
+    auto sequence = wrapper.GetSequence();
+    auto root = wrapper.NewTable(luna::GCGen1);
+    wrapper.AddRoot(root);
+    std::vector<luna::Table *> alive;
+    std::vector<luna::Table *> garbage;
+    for (int i = 0; i < 1000; ++i)
+    {
+        alive.push_back(wrapper.NewTable());
+        SetArray(gc, root, i + 1, alive.back());
+        garbage.push_back(wrapper.NewTable());
+    }
+
+    wrapper.Allocate(100000);
+    gc.FullGC();
+    EXPECT_TRUE(gc.GetObjectCount() == alive.size() + 1);
+    EXPECT_TRUE(wrapper.IsAlive(root));
+    for (auto t : alive)
+        EXPECT_TRUE(wrapper.IsAlive(t));
+    for (auto t : garbage)
+        EXPECT_TRUE(wrapper.IsDeletedAfter(t, sequence));
+
+    gc.SetSweepMode(luna::GC::SweepMode_Eager);
+    EXPECT_TRUE(!gc.IsSweeping());
+}
+
+TEST_CASE(gc5)
+{
+    // Long chain of nested tables is marked without recursion
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    auto root = wrapper.NewTable();
+    wrapper.AddRoot(root);
+
+    const int kDepth = 1000000;
+    auto t = root;
+    for (int i = 0; i < kDepth; ++i)
+    {
+        auto next = wrapper.NewTable();
+        SetArray(gc, t, 1, next);
+        t = next;
+    }
+
+    // Minor GC marks the chain in GCGen0, and major GC marks it in
+    // GCGen1
+    gc.CheckGC();
+    gc.FullGC();
+    EXPECT_TRUE(gc.GetObjectCount() == kDepth + 1);
+
+    root->SetArrayValue(1, luna::Value());
+    gc.FullGC();
+    EXPECT_TRUE(gc.GetObjectCount() == 1);
+    EXPECT_TRUE(wrapper.IsAlive(root));
+}
+
+TEST_CASE(gc6)
+{
+    // GC is triggered by allocated bytes, not count of objects
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    gc.SetSweepMode(luna::GC::SweepMode_Lazy);
+
+    std::string large(1024 * 1024, 'x');
+    gc.NewString(large.c_str(), large.size(),
+                 luna::String::Hash(large.c_str(), large.size(), 0));
+    EXPECT_TRUE(gc.GetTotalBytes() >= large.size());
+    gc.CheckGC();
+    EXPECT_TRUE(gc.IsSweeping());
+
+    gc.FullGC();
+    EXPECT_TRUE(gc.GetTotalBytes() < large.size());
+
+    // Memory of array part is counted
+    auto root = wrapper.NewTable();
+    wrapper.AddRoot(root);
+    luna::Value value;
+    value.type_ = luna::ValueT_Number;
+    for (int i = 1; i <= 10000; ++i)
+    {
+        value.num_ = i;
+        root->SetArrayValue(i, value);
+    }
+    gc.FullGC();
+    EXPECT_TRUE(gc.GetTotalBytes() >= 10000 * sizeof(double));
+}
+
+TEST_CASE(gc7)
+{
+    // Old object is remembered once until next GC, stores after GC
+    // remember it again
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    gc.SetSweepMode(luna::GC::SweepMode_Lazy);
+    auto root = wrapper.NewTable(luna::GCGen1);
+    wrapper.AddRoot(root);
+
+    std::vector<luna::Table *> alive;
+    for (int round = 0; round < 3; ++round)
+    {
+        EXPECT_TRUE(luna::CheckBarrier(root));
+        for (int i = 1; i <= 100; ++i)
+        {
+            alive.push_back(wrapper.NewTable());
+            SetArray(gc, root, alive.size(), alive.back());
+        }
+        EXPECT_TRUE(!luna::CheckBarrier(root));
+
+        while (!gc.IsSweeping())
+            wrapper.Allocate(1);
+        while (gc.IsSweeping())
+            wrapper.NewTable();
+    }
+
+    for (auto t : alive)
+        EXPECT_TRUE(wrapper.IsAlive(t));
+}
+
+TEST_CASE(gc8)
+{
+    // Objects of site which survive are allocated in GCGen1, and the
+    // site is not pretenured any more when its objects die
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    auto root = wrapper.NewTable(luna::GCGen1);
+    wrapper.AddRoot(root);
+    auto site = gc.NewAllocSite();
+    EXPECT_TRUE(site != 0);
+
+    std::size_t index = 0;
+    while (!gc.IsPretenured(site) && index < 100000)
+    {
+        auto t = gc.NewTable(gc.GetAllocSiteGen(site), site);
+        SetArray(gc, root, ++index, t);
+        gc.CheckGC();
+    }
+    EXPECT_TRUE(gc.IsPretenured(site));
+
+    int gen1 = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        if (gc.GetAllocSiteGen(site) == luna::GCGen1)
+            ++gen1;
+    }
+    EXPECT_TRUE(gen1 > 0 && gen1 < 100);
+
+    for (int i = 0; i < 1000000 && gc.IsPretenured(site); ++i)
+    {
+        gc.NewTable(gc.GetAllocSiteGen(site), site);
+        gc.CheckGC();
+    }
+    EXPECT_TRUE(!gc.IsPretenured(site));
+
+    gc.FreeAllocSite(site);
+    EXPECT_TRUE(gc.NewAllocSite() == site);
+}
+
+TEST_CASE(gc9)
+{
+    // Stopped GC does not collect garbage when checked, but steps and
+    // full GC still collect it
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    gc.SetSweepMode(luna::GC::SweepMode_Eager);
+    auto root = wrapper.NewTable();
+    wrapper.AddRoot(root);
+
+    gc.SetStopped(true);
+    auto sequence = wrapper.GetSequence();
+    std::vector<luna::Table *> garbage;
+    for (int i = 0; i < 10000; ++i)
+    {
+        garbage.push_back(wrapper.NewTable());
+        gc.CheckGC();
+    }
+    EXPECT_TRUE(gc.GetObjectCount() == garbage.size() + 1);
+
+    EXPECT_TRUE(gc.Step());
+    EXPECT_TRUE(gc.GetObjectCount() == 1);
+    for (auto t : garbage)
+        EXPECT_TRUE(wrapper.IsDeletedAfter(t, sequence));
+    EXPECT_TRUE(wrapper.IsAlive(root));
+
+    wrapper.Allocate(10000);
+    EXPECT_TRUE(gc.GetObjectCount() == 10001);
+
+    gc.SetStopped(false);
+    wrapper.Allocate(1);
+    EXPECT_TRUE(gc.GetObjectCount() < 10001);
+}
+
+TEST_CASE(gc10)
+{
+    // Strings found by weak reference are kept alive only when they are
+    // left in sweep lists, other strings are collected as usual
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    gc.SetStopped(true);
+    auto root = wrapper.NewTable(luna::GCGen1);
+    wrapper.AddRoot(root);
+
+    luna::Value v;
+    v.type_ = luna::ValueT_String;
+    v.str_ = gc.NewString("old", 3, 0);
+    auto old = v.str_;
+    root->SetArrayValue(1, v);
+    CHECK_BARRIER(gc, root);
+    gc.FullGC();
+    v.type_ = luna::ValueT_Nil;
+    root->SetArrayValue(1, v);
+
+    auto dead = gc.NewString("dead", 4, 0);
+    for (int i = 0; i < 10000; ++i)
+        wrapper.NewTable();
+    gc.Step();
+    EXPECT_TRUE(gc.IsSweeping());
+    auto fresh = gc.NewString("fresh", 5, 0);
+    EXPECT_TRUE(gc.IsSweeping());
+
+    auto sequence = wrapper.GetSequence();
+    gc.KeepAlive(old);
+    gc.KeepAlive(dead);
+    gc.KeepAlive(fresh);
+    gc.SetSweepMode(luna::GC::SweepMode_Eager);
+    EXPECT_TRUE(!gc.IsSweeping());
+    EXPECT_TRUE(!wrapper.IsDeletedAfter(dead, sequence));
+
+    gc.Step();
+    EXPECT_TRUE(wrapper.IsDeletedAfter(fresh, sequence));
+    EXPECT_TRUE(!wrapper.IsDeletedAfter(dead, sequence));
+
+    gc.FullGC();
+    EXPECT_TRUE(wrapper.IsDeletedAfter(old, sequence));
+    EXPECT_TRUE(wrapper.IsDeletedAfter(dead, sequence));
+    EXPECT_TRUE(gc.GetObjectCount() == 1);
+}
+
+TEST_CASE(gc11)
+{
+    // Growth of tables counts as allocation, growing one old table
+    // runs GC, and total bytes count the growth before any full GC
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    auto root = wrapper.NewTable(luna::GCGen1);
+    wrapper.AddRoot(root);
+    auto garbage = wrapper.NewTable();
+    auto sequence = wrapper.GetSequence();
+    auto bytes = gc.GetTotalBytes();
+
+    luna::Value key;
+    luna::Value value;
+    value.type_ = luna::ValueT_Number;
+    for (int i = 1; i <= 100000; ++i)
+    {
+        value.num_ = i;
+        root->SetArrayValue(i, value);
+        gc.CheckGC();
+    }
+    EXPECT_TRUE(wrapper.IsDeletedAfter(garbage, sequence));
+    EXPECT_TRUE(gc.GetTotalBytes() >= bytes + 100000 * sizeof(double));
+
+    key.type_ = luna::ValueT_Number;
+    for (int i = 1; i <= 1000; ++i)
+    {
+        key.num_ = -i;
+        root->SetValue(key, value);
+        gc.CheckGC();
+    }
+
+    bytes = gc.GetTotalBytes();
+    gc.FullGC();
+    EXPECT_TRUE(gc.GetTotalBytes() == bytes);
+}
+
+TEST_CASE(gc12)
+{
+    // Growth of table which is left in sweep list is counted by bytes
+    // of the sweep, and by its generation after it is swept
+    GCWrapper wrapper;
+    auto &gc = wrapper.GetGC();
+    gc.SetStopped(true);
+    auto root = wrapper.NewTable(luna::GCGen1);
+    wrapper.AddRoot(root);
+    auto t = wrapper.NewTable();
+    SetArray(gc, root, 1, t);
+    wrapper.Allocate(10000);
+
+    gc.Step();
+    EXPECT_TRUE(gc.IsSweeping());
+    luna::Value value;
+    value.type_ = luna::ValueT_Number;
+    for (int i = 1; i <= 10000; ++i)
+    {
+        value.num_ = i;
+        t->SetArrayValue(i, value);
+    }
+    EXPECT_TRUE(!gc.IsSweeping());
+
+    auto bytes = gc.GetTotalBytes();
+    EXPECT_TRUE(bytes >= 10000 * sizeof(double));
+    gc.FullGC();
+    EXPECT_TRUE(gc.GetTotalBytes() == bytes);
+    EXPECT_TRUE(wrapper.IsAlive(t));
+}
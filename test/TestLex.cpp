@@ -14,8 +14,8 @@ namespace
         explicit LexerWrapper(const std::string &str)
             : iss_(str),
               state_(),
-              name_("lex"),
-              lexer_(&state_, &name_, std::bind(&io::text::InStringStream::GetChar, &iss_))
+              name_(state_.GetString("lex")),
+              lexer_(&state_, name_, std::bind(&io::text::InStringStream::GetChar, &iss_))
         {
         }
 
@@ -28,7 +28,7 @@ namespace
     private:
         io::text::InStringStream iss_;
         luna::State state_;
-        luna::String name_;
+        luna::String *name_;
         luna::Lexer lexer_;
     };
 } // namespace
@@ -0,0 +1,51 @@
+#include "UnitTest.h"
+#include "TestCommon.h"
+
+TEST_CASE(libbase1)
+{
+    // Count rises when a table grows, not only after a full GC
+    ScriptRunner runner;
+    runner.Run(R"(
+        collectgarbage()
+        c1 = collectgarbage("count")
+        local t = {}
+        for i = 1, 100000 do t[i] = i end
+        keep = t
+        c2 = collectgarbage("count")
+        collectgarbage()
+        c3 = collectgarbage("count")
+    )");
+    auto c1 = runner.GetNumber("c1");
+    auto c2 = runner.GetNumber("c2");
+    auto c3 = runner.GetNumber("c3");
+    EXPECT_TRUE(c2 - c1 > 700);
+    EXPECT_TRUE(c3 > c2 - 64 && c3 < c2 + 64);
+}
+
+TEST_CASE(libbase2)
+{
+    ScriptRunner runner;
+    runner.Run(R"(
+        s1 = collectgarbage("step")
+        s2 = collectgarbage("step", 1e9)
+        collectgarbage("stop")
+        r1 = collectgarbage("isrunning")
+        collectgarbage("restart")
+        r2 = collectgarbage("isrunning")
+        m1 = collectgarbage("generational")
+        m2 = collectgarbage("incremental")
+    )");
+    EXPECT_TRUE(runner.GetGlobal("s1").type_ == luna::ValueT_Bool);
+    EXPECT_TRUE(runner.GetBool("s2"));
+    EXPECT_TRUE(!runner.GetBool("r1"));
+    EXPECT_TRUE(runner.GetBool("r2"));
+    EXPECT_TRUE(runner.GetString("m1") == "incremental");
+    EXPECT_TRUE(runner.GetString("m2") == "generational");
+
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("collectgarbage('step', -1)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("collectgarbage('bad')");
+    });
+}
@@ -0,0 +1,189 @@
+#include "UnitTest.h"
+#include "TestCommon.h"
+
+TEST_CASE(libstring1)
+{
+    // Case conversion of every length around the word size and every
+    // alignment, non-ASCII bytes are kept
+    ScriptRunner runner;
+    runner.Run(R"(
+        local src = "aZ" .. string.char(200) .. "mQ{@`zA~1 bY" ..
+                    string.char(255) .. "xyzKLM[]" .. string.char(128)
+        ok = true
+        for n = 0, 17 do
+            for off = 1, 4 do
+                local s = string.sub(src, off, off + n - 1)
+                local up = ""
+                local low = ""
+                for i = 1, #s do
+                    local b = string.byte(s, i)
+                    up = up .. string.char(b >= 97 and b <= 122 and b - 32 or b)
+                    low = low .. string.char(b >= 65 and b <= 90 and b + 32 or b)
+                end
+                if #s ~= n or string.upper(s) ~= up or string.lower(s) ~= low then
+                    ok = false
+                end
+            end
+        end
+    )");
+    EXPECT_TRUE(runner.GetBool("ok"));
+}
+
+TEST_CASE(libstring2)
+{
+    ScriptRunner runner;
+    runner.Run(R"(
+        r1 = string.rep("ab", 3, ",")
+        r2 = string.rep("ab", 1, ",")
+        r3 = string.rep("x", 0)
+        r4 = string.rep("", 5, "-")
+        r5 = string.rep("abc", 4)
+        r6 = string.rep("x", -1, ",")
+    )");
+    EXPECT_TRUE(runner.GetString("r1") == "ab,ab,ab");
+    EXPECT_TRUE(runner.GetString("r2") == "ab");
+    EXPECT_TRUE(runner.GetString("r3") == "");
+    EXPECT_TRUE(runner.GetString("r4") == "----");
+    EXPECT_TRUE(runner.GetString("r5") == "abcabcabcabc");
+    EXPECT_TRUE(runner.GetString("r6") == "");
+
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.rep('x', 2^31)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.rep('x', 2^30, 'yy')");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.rep('x', 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.rep('x', 1.5)");
+    });
+}
+
+TEST_CASE(libstring3)
+{
+    ScriptRunner runner;
+    runner.Run(R"(
+        s1 = string.sub("hello", -3)
+        s2 = string.sub("hello", 2, -2)
+        s3 = string.sub("hello", -100, 2)
+        s4 = string.sub("hello", 0)
+        s5 = string.sub("hello", 4, 2)
+        s6 = string.sub("hello", 2, 100)
+        f1, f2 = string.find("a.b.c", ".", 3, true)
+        f3 = string.find("a+b", "+", 1, true)
+        f4 = string.find("abc", "", 4)
+        f5 = string.find("abc", "", 10)
+        f6 = string.find("xxxxxxxxxxneedleneedle", "needle", -6, true)
+        s7 = string.sub("hello", 2^53)
+        s8 = string.sub("hello", -2^53, 2^53)
+        f7 = string.find("abc", "b", -2^53)
+    )");
+    EXPECT_TRUE(runner.GetString("s1") == "llo");
+    EXPECT_TRUE(runner.GetString("s2") == "ell");
+    EXPECT_TRUE(runner.GetString("s3") == "he");
+    EXPECT_TRUE(runner.GetString("s4") == "hello");
+    EXPECT_TRUE(runner.GetString("s5") == "");
+    EXPECT_TRUE(runner.GetString("s6") == "ello");
+    EXPECT_TRUE(runner.GetNumber("f1") == 4);
+    EXPECT_TRUE(runner.GetNumber("f2") == 4);
+    EXPECT_TRUE(runner.GetNumber("f3") == 2);
+    EXPECT_TRUE(runner.GetNumber("f4") == 4);
+    EXPECT_TRUE(runner.GetGlobal("f5").type_ == luna::ValueT_Nil);
+    EXPECT_TRUE(runner.GetNumber("f6") == 17);
+    EXPECT_TRUE(runner.GetString("s7") == "");
+    EXPECT_TRUE(runner.GetString("s8") == "hello");
+    EXPECT_TRUE(runner.GetNumber("f7") == 2);
+
+    // Positions must be integers
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.sub('abc', 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.sub('abc', 1, 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.sub('abc', 1.5)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.find('abc', 'b', 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.gsub('abc', 'b', 'x', 0/0)");
+    });
+}
+
+TEST_CASE(libstring4)
+{
+    ScriptRunner runner;
+    runner.Run(R"(
+        d = string.format("%d|%5d|%-5d|%05d|%+d|%i", 42, 42, 42, -42, 7, 3)
+        x = string.format("%x|%X|%#x|%o|%c%c", 255, 255, 255, 8, 72, 105)
+        f = string.format("%.2f|%8.3f|%e|%g|%g", 3.14159, -2.5, 1234.5, 0.0001, 1e20)
+        s = string.format("%s|%10s|%-4s|%.2s|%s", "abc", "right", "l", "cut", 1.5)
+        q = string.format("%q", 'a\n"b"\\' .. string.char(0) .. "1")
+        p = string.format("100%% %s", "done")
+        long = string.format("%s", string.rep("y", 300))
+        z1 = string.format("%s|%s", "a\0b", "c")
+        z2 = string.format("%s", string.rep("\0", 150))
+    )");
+    EXPECT_TRUE(runner.GetString("d") == "42|   42|42   |-0042|+7|3");
+    EXPECT_TRUE(runner.GetString("x") == "ff|FF|0xff|10|Hi");
+    EXPECT_TRUE(runner.GetString("f") == "3.14|  -2.500|1.234500e+03|0.0001|1e+20");
+    EXPECT_TRUE(runner.GetString("s") == "abc|     right|l   |cu|1.5");
+    EXPECT_TRUE(runner.GetString("q") == "\"a\\\n\\\"b\\\"\\\\\\0001\"");
+    EXPECT_TRUE(runner.GetString("p") == "100% done");
+    EXPECT_TRUE(runner.GetString("long") == std::string(300, 'y'));
+    EXPECT_TRUE(runner.GetString("z1") == std::string("a\0b|c", 5));
+    EXPECT_TRUE(runner.GetString("z2") == std::string(150, '\0'));
+
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.format('%y', 1)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.format('%d')");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.format('%d', 2^63)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.format('%123d', 1)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.format('abc%')");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.format('%5s', 'a\\0b')");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("string.format('%.2s', 'a\\0b')");
+    });
+}
+
+TEST_CASE(libstring5)
+{
+    // '^' is a literal char in gmatch, not an anchor
+    ScriptRunner runner;
+    runner.Run(R"(
+        local r = {}
+        for w in string.gmatch("^a ^b c ^d", "^%a") do
+            r[#r + 1] = w
+        end
+        s1 = table.concat(r, ",")
+        n = 0
+        for w in string.gmatch("abc abc", "^abc") do
+            n = n + 1
+        end
+        r = {}
+        for w in string.gmatch("one two", "%a+") do
+            r[#r + 1] = w
+        end
+        s2 = table.concat(r, ",")
+        f = string.find("^abc", "^abc")
+    )");
+    EXPECT_TRUE(runner.GetString("s1") == "^a,^b,^d");
+    EXPECT_TRUE(runner.GetNumber("n") == 0);
+    EXPECT_TRUE(runner.GetString("s2") == "one,two");
+    EXPECT_TRUE(runner.GetGlobal("f").type_ == luna::ValueT_Nil);
+}
@@ -0,0 +1,113 @@
+#include "UnitTest.h"
+#include "TestCommon.h"
+
+TEST_CASE(libtable1)
+{
+    ScriptRunner runner;
+    runner.Run(R"(
+        local t = { 1, 2, 3, 4, 5 }
+        table.move(t, 1, 3, 3)
+        s1 = table.concat(t, ",")
+        t = { 1, 2, 3, 4, 5 }
+        table.move(t, 3, 5, 1)
+        s2 = table.concat(t, ",")
+        local t2 = table.move({ 1, 2, 3 }, 1, 3, 2, {})
+        n = t2[1] == nil and t2[2] + t2[3] + t2[4]
+        e = #table.move({ 1 }, 2, 1, 1)
+    )");
+    EXPECT_TRUE(runner.GetString("s1") == "1,2,1,2,3");
+    EXPECT_TRUE(runner.GetString("s2") == "3,4,5,4,5");
+    EXPECT_TRUE(runner.GetNumber("n") == 6);
+    EXPECT_TRUE(runner.GetNumber("e") == 1);
+}
+
+TEST_CASE(libtable2)
+{
+    // Ranges which can not be moved are errors instead of endless loops
+    ScriptRunner runner;
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.move({ 1 }, -2^53, 2^53, 1)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.move({ 1 }, 1, 2, 2^53)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.move({ 1 }, 1.5, 2, 1)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.move({ 1 }, 1, 2^60, 1)");
+    });
+    runner.Run("n = #table.move({ 1 }, 1, 1, 2^53)");
+    EXPECT_TRUE(runner.GetNumber("n") == 1);
+}
+
+TEST_CASE(libtable3)
+{
+    // Tables are sorted by '__lt' metamethod without comparator
+    ScriptRunner runner;
+    runner.Run(R"(
+        local mt = { __lt = function(a, b) return a.v < b.v end }
+        local t = {}
+        for i = 1, 100 do
+            t[i] = setmetatable({ v = (i * 37) % 101 }, mt)
+        end
+        table.sort(t)
+        sorted = true
+        for i = 2, #t do
+            if t[i].v < t[i - 1].v then sorted = false end
+        end
+        local s = { "b", "c", "a" }
+        table.sort(s)
+        str = table.concat(s)
+    )");
+    EXPECT_TRUE(runner.GetBool("sorted"));
+    EXPECT_TRUE(runner.GetString("str") == "abc");
+
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.sort({ {}, {}, {} })");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.sort({ 1, 'a', 2 })");
+    });
+}
+
+TEST_CASE(libtable4)
+{
+    // Ranges of concat and unpack are integers
+    ScriptRunner runner;
+    runner.Run(R"(
+        s1 = table.concat({ 1, 2, 3 }, ",", 2)
+        s2 = table.concat({ [2^53] = "a", [2^53 - 1] = "b" }, ",", 2^53 - 1, 2^53)
+        s3 = table.concat({ 1, 2 }, ",", 2^53, -2^53)
+        local a, b, c = table.unpack({ 1, 2, 3 }, 2)
+        u = a + b + (c or 10)
+        e = table.unpack({ 1 }, 2^53, -2^53) == nil
+    )");
+    EXPECT_TRUE(runner.GetString("s1") == "2,3");
+    EXPECT_TRUE(runner.GetString("s2") == "b,a");
+    EXPECT_TRUE(runner.GetString("s3") == "");
+    EXPECT_TRUE(runner.GetNumber("u") == 15);
+    EXPECT_TRUE(runner.GetBool("e"));
+
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.concat({ [2^53] = 'a' }, '', 2^53, 2^53 + 2)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.concat({ 1, 2, 3 }, ',', 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.concat({ 1, 2, 3 }, ',', 1.5)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.concat({ 1, 2, 3 }, ',', -2^53, 2^53)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.unpack({ 1, 2, 3 }, 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.unpack({ 1, 2, 3 }, 1, 2.5)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("table.unpack({}, -2^53, 2^53)");
+    });
+}
@@ -0,0 +1,249 @@
+#include "UnitTest.h"
+#include "TestCommon.h"
+#include <string>
+
+namespace
+{
+    // Invalid sequences, including overlong forms, surrogates, code
+    // points beyond 0x10FFFF and truncated sequences
+    const char *kInvalid[] = {
+        "\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xE0\x80\x80",
+        "\xE0\x9F\xBF", "\xED\xA0\x80", "\xED\xBF\xBF", "\xF0\x80\x80\x80",
+        "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF",
+        "\xC3", "\xE2\x82", "\xF0\x9F\x98", "\xC3" "a", "\xE2\x82" "a",
+        "\xE2" "a" "\xAC", "\xF0\x9F\x98" "a"
+    };
+
+    // Valid sequences at the boundaries of the ranges
+    const char *kValid[] = {
+        "\x7F", "\xC2\x80", "\xDF\xBF", "\xE0\xA0\x80", "\xED\x9F\xBF",
+        "\xEE\x80\x80", "\xEF\xBF\xBF", "\xF0\x90\x80\x80",
+        "\xF4\x8F\xBF\xBF"
+    };
+
+    // Return true when CountChars finds the first invalid byte of
+    // 'str' at 'pos' after counting 'pos' ASCII characters
+    bool IsInvalidAt(const std::string &str, std::size_t pos)
+    {
+        std::size_t count = 0;
+        const char *s = str.c_str();
+        const char *end = s + str.size();
+        return lib::utf8::CountChars(s, end, end, &count) == s + pos &&
+            count == pos;
+    }
+
+    bool IsValid(const std::string &str, std::size_t expect)
+    {
+        std::size_t count = 0;
+        const char *s = str.c_str();
+        const char *end = s + str.size();
+        return !lib::utf8::CountChars(s, end, end, &count) &&
+            count == expect;
+    }
+} // namespace
+
+TEST_CASE(libutf81)
+{
+    // Bad sequence at each position of strings which end in words,
+    // just before and just after a word
+    for (std::size_t size = 7; size <= 9; ++size)
+    {
+        for (auto bad : kInvalid)
+        {
+            std::string seq(bad);
+            for (std::size_t pos = 0; pos + seq.size() <= size; ++pos)
+            {
+                std::string str(size, 'a');
+                str.replace(pos, seq.size(), seq);
+                EXPECT_TRUE(IsInvalidAt(str, pos));
+            }
+        }
+
+        for (auto good : kValid)
+        {
+            std::string seq(good);
+            for (std::size_t pos = 0; pos + seq.size() <= size; ++pos)
+            {
+                std::string str(size, 'a');
+                str.replace(pos, seq.size(), seq);
+                EXPECT_TRUE(IsValid(str, size - seq.size() + 1));
+            }
+        }
+    }
+
+    // Characters which start before limit may end after it
+    std::string str = "aaaaaaa\xF0\x9F\x98\x80";
+    const char *s = str.c_str();
+    std::size_t count = 0;
+    EXPECT_TRUE(!lib::utf8::CountChars(s, s + 8, s + str.size(), &count));
+    EXPECT_TRUE(count == 8);
+    EXPECT_TRUE(lib::utf8::CountChars(s, s + 8, s + 9, &count) == s + 7);
+    EXPECT_TRUE(count == 7);
+    EXPECT_TRUE(IsValid("", 0));
+}
+
+TEST_CASE(libutf82)
+{
+    ScriptRunner runner;
+    runner.Run(R"(
+        local s = "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"
+        n1 = utf8.len(s)
+        n2 = utf8.len(s, 2, 3)
+        n3 = utf8.len(s, -4)
+        n4, p4 = utf8.len("ab\xC0\x80")
+        n5, p5 = utf8.len("abc\xED\xA0\x80")
+        n6, p6 = utf8.len("abcd\xF4\x90\x80\x80")
+        n7, p7 = utf8.len("abcdefg\xE2\x82")
+        c = utf8.char(0x61, 0xE9, 0x20AC, 0x1F600, 0x10FFFF) ==
+            s .. "\xF4\x8F\xBF\xBF"
+        c1, c2, c3, c4 = utf8.codepoint(s, 1, -1)
+        local sum = 0
+        for p, code in utf8.codes(s) do
+            sum = sum + p * code
+        end
+        cs = sum
+        o1 = utf8.offset(s, 3)
+        o2 = utf8.offset(s, -1)
+        o3 = utf8.offset(s, 0, 5)
+        o4 = utf8.offset(s, 5)
+        o5 = utf8.offset(s, 6)
+    )");
+    EXPECT_TRUE(runner.GetNumber("n1") == 4);
+    EXPECT_TRUE(runner.GetNumber("n2") == 1);
+    EXPECT_TRUE(runner.GetNumber("n3") == 1);
+    EXPECT_TRUE(runner.GetGlobal("n4").type_ == luna::ValueT_Nil);
+    EXPECT_TRUE(runner.GetNumber("p4") == 3);
+    EXPECT_TRUE(runner.GetNumber("p5") == 4);
+    EXPECT_TRUE(runner.GetNumber("p6") == 5);
+    EXPECT_TRUE(runner.GetNumber("p7") == 8);
+    EXPECT_TRUE(runner.GetBool("c"));
+    EXPECT_TRUE(runner.GetNumber("c1") == 97);
+    EXPECT_TRUE(runner.GetNumber("c2") == 233);
+    EXPECT_TRUE(runner.GetNumber("c3") == 8364);
+    EXPECT_TRUE(runner.GetNumber("c4") == 128512);
+    EXPECT_TRUE(runner.GetNumber("cs") ==
+                1 * 97 + 2 * 233 + 4 * 8364 + 7 * 128512);
+    EXPECT_TRUE(runner.GetNumber("o1") == 4);
+    EXPECT_TRUE(runner.GetNumber("o2") == 7);
+    EXPECT_TRUE(runner.GetNumber("o3") == 4);
+    EXPECT_TRUE(runner.GetNumber("o4") == 11);
+    EXPECT_TRUE(runner.GetGlobal("o5").type_ == luna::ValueT_Nil);
+}
+
+TEST_CASE(libutf83)
+{
+    ScriptRunner runner;
+
+    // Invalid code points
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.char(0x110000)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.char(-1)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.char('a')");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.len('abc', 5)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.len('abc', 1, 4)");
+    });
+
+    // Arguments of codepoint
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint()");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint({})");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint('abc', {})");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint('abc', 0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint('abc', 1, 4)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint('a\\xE0\\x80\\x80', 1, -1)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint('\\xED\\xBF\\xBF', 1)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint('\\xC3', 1)");
+    });
+
+    // Arguments of offset
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset('abc')");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset({}, 1)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset('abc', 'x')");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset('abc', 1, {})");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset('abc', 1, 5)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset('abc', 1, 0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset('a\\xC3\\xA9', 1, 3)");
+    });
+
+    // Positions and code points must be integers
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.char(0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.char(65.5)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint('abc', 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint('abc', 1, 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.len('abc', 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.len('abc', 1, 1.5)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset('abc', 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset('abc', 1, 0/0)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.offset('abc', 1, 2^53)");
+    });
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("utf8.codepoint('abc', 1, 2^53)");
+    });
+
+    runner.Run(R"(
+        n = utf8.len('abc', 1, -2^53)
+        o = utf8.offset('abc', 2^53)
+    )");
+    EXPECT_TRUE(runner.GetNumber("n") == 0);
+    EXPECT_TRUE(runner.GetGlobal("o").type_ == luna::ValueT_Nil);
+
+    runner.Run("x = utf8.codepoint('abc', 3, 2)");
+    EXPECT_TRUE(runner.GetGlobal("x").type_ == luna::ValueT_Nil);
+
+    // Invalid characters stop the iteration of codes
+    EXPECT_EXCEPTION(luna::RuntimeException, {
+        runner.Run("for p, c in utf8.codes('ab\\xFF') do end");
+    });
+}
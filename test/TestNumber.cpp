@@ -0,0 +1,234 @@
+#include "UnitTest.h"
+#include "TestCommon.h"
+#include "../src/Number.h"
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    std::string ToString(double num)
+    {
+        char buffer[luna::kNumberBufferSize];
+        auto len = luna::NumberToString(num, buffer);
+        if (len != strlen(buffer))
+            return "<bad length>";
+        return std::string(buffer, len);
+    }
+
+    // Convert 'str' by StringToNumber, return true when it is 'expect'
+    bool IsNumber(const std::string &str, double expect)
+    {
+        double num = 0.0;
+        return luna::StringToNumber(str.c_str(), str.size(), &num) &&
+            num == expect && (num != 0.0 || std::signbit(num) == std::signbit(expect));
+    }
+
+    bool IsNotNumber(const std::string &str)
+    {
+        double num = 0.0;
+        return !luna::StringToNumber(str.c_str(), str.size(), &num);
+    }
+} // namespace
+
+TEST_CASE(number1)
+{
+    // Integers are converted without exponent below 1e17
+    EXPECT_TRUE(ToString(0.0) == "0");
+    EXPECT_TRUE(ToString(-0.0) == "-0");
+    EXPECT_TRUE(ToString(1.0) == "1");
+    EXPECT_TRUE(ToString(-123.0) == "-123");
+    EXPECT_TRUE(ToString(999999999999999.0) == "999999999999999");
+    EXPECT_TRUE(ToString(1e15) == "1000000000000000");
+    EXPECT_TRUE(ToString(1e15 + 1) == "1000000000000001");
+    EXPECT_TRUE(ToString(9007199254740992.0) == "9007199254740992");
+    EXPECT_TRUE(ToString(1e16) == "10000000000000000");
+    EXPECT_TRUE(ToString(12345678901234567.0) == "12345678901234568");
+    EXPECT_TRUE(ToString(1e17) == "1e+17");
+    EXPECT_TRUE(ToString(2e17) == "2e+17");
+    EXPECT_TRUE(ToString(1e22) == "1e+22");
+    EXPECT_TRUE(ToString(1e100) == "1e+100");
+}
+
+TEST_CASE(number2)
+{
+    // Shortest digits which read back to the same number
+    EXPECT_TRUE(ToString(0.1) == "0.1");
+    EXPECT_TRUE(ToString(1.0 / 3) == "0.3333333333333333");
+    EXPECT_TRUE(ToString(123.456) == "123.456");
+    EXPECT_TRUE(ToString(-2.5) == "-2.5");
+    EXPECT_TRUE(ToString(0.0001) == "0.0001");
+    EXPECT_TRUE(ToString(1e-5) == "1e-05");
+    EXPECT_TRUE(ToString(5e-324) == "5e-324");
+    EXPECT_TRUE(ToString(DBL_MAX) == "1.7976931348623157e+308");
+    EXPECT_TRUE(ToString(std::numeric_limits<double>::infinity()) == "inf");
+    EXPECT_TRUE(ToString(-std::numeric_limits<double>::infinity()) == "-inf");
+    EXPECT_TRUE(ToString(std::numeric_limits<double>::quiet_NaN()) == "nan");
+
+    // Random numbers of all exponents round trip
+    std::mt19937_64 rng(0x5EED);
+    for (int i = 0; i < 100000; ++i)
+    {
+        unsigned long long bits = rng();
+        double num = 0.0;
+        memcpy(&num, &bits, sizeof(num));
+        if (num != num || num - num != 0.0)
+            continue;
+
+        auto str = ToString(num);
+        if (strtod(str.c_str(), nullptr) != num)
+        {
+            EXPECT_TRUE(strtod(str.c_str(), nullptr) == num);
+            break;
+        }
+    }
+}
+
+TEST_CASE(number3)
+{
+    // Exact fast path at its boundaries
+    EXPECT_TRUE(IsNumber("0", 0.0));
+    EXPECT_TRUE(IsNumber("-0", -0.0));
+    EXPECT_TRUE(IsNumber("9007199254740992", 9007199254740992.0));
+    EXPECT_TRUE(IsNumber("9007199254740993", 9007199254740992.0));
+    EXPECT_TRUE(IsNumber("9007199254740995", 9007199254740996.0));
+    EXPECT_TRUE(IsNumber("1e22", 1e22));
+    EXPECT_TRUE(IsNumber("1e23", 1e23));
+    EXPECT_TRUE(IsNumber("1e-22", 1e-22));
+    EXPECT_TRUE(IsNumber("1e-23", 1e-23));
+    EXPECT_TRUE(IsNumber("123e30", 123e30));
+    EXPECT_TRUE(IsNumber("0.1", 0.1));
+    EXPECT_TRUE(IsNumber(".5", 0.5));
+    EXPECT_TRUE(IsNumber("5.", 5.0));
+    EXPECT_TRUE(IsNumber("000123.4500", 123.45));
+    EXPECT_TRUE(IsNumber("0.000000000000000000000000001", 1e-27));
+
+    // 19 digits and more, and numbers out of range are converted by
+    // strtod
+    EXPECT_TRUE(IsNumber("1234567890123456789", 1234567890123456789.0));
+    EXPECT_TRUE(IsNumber("12345678901234567890", 12345678901234567890.0));
+    EXPECT_TRUE(IsNumber("3.14159265358979323846264338327950288",
+                         3.14159265358979323846264338327950288));
+    EXPECT_TRUE(IsNumber("2.2250738585072011e-308", 2.2250738585072011e-308));
+    EXPECT_TRUE(IsNumber("4.9e-324", 4.9e-324));
+    EXPECT_TRUE(IsNumber("1.7976931348623157e308", DBL_MAX));
+    EXPECT_TRUE(IsNumber("1e400", std::numeric_limits<double>::infinity()));
+    EXPECT_TRUE(IsNumber("1e-400", 0.0));
+
+    // Hexadecimal numbers, signs and spaces
+    EXPECT_TRUE(IsNumber("0x10", 16.0));
+    EXPECT_TRUE(IsNumber("0XfF", 255.0));
+    EXPECT_TRUE(IsNumber("0x.8", 0.5));
+    EXPECT_TRUE(IsNumber("0x1p4", 16.0));
+    EXPECT_TRUE(IsNumber("0x1P-1", 0.5));
+    EXPECT_TRUE(IsNumber("-0x10", -16.0));
+    EXPECT_TRUE(IsNumber("0xFFFFFFFFFFFFFFFFF", 295147905179352825855.0));
+
+    // Hexadecimal significands are rounded once to nearest even, digits
+    // beyond 60 bits are sticky
+    EXPECT_TRUE(IsNumber("0x1.000000000000080000000001p0", 1.0000000000000002));
+    EXPECT_TRUE(IsNumber("0x1.000000000000080000000000p0", 1.0));
+    EXPECT_TRUE(IsNumber("0x1.000000000000180p0", 1.0 + std::ldexp(1.0, -51)));
+    EXPECT_TRUE(IsNumber("0x10000000000000800000001",
+                         std::ldexp(1.0, 88) + std::ldexp(1.0, 36)));
+    EXPECT_TRUE(IsNumber("0x10000000000000800000000", std::ldexp(1.0, 88)));
+    EXPECT_TRUE(IsNumber("0x1.8p-1074", std::ldexp(1.0, -1073)));
+    EXPECT_TRUE(IsNumber("0x1p-1075", 0.0));
+    EXPECT_TRUE(IsNumber("0x1.00000000000000001p-1075", std::ldexp(1.0, -1074)));
+    EXPECT_TRUE(IsNumber("0x1.ffffffffffffffp-1023", std::ldexp(1.0, -1022)));
+    EXPECT_TRUE(IsNumber("0x1.fffffffffffff8p1023",
+                         std::numeric_limits<double>::infinity()));
+    EXPECT_TRUE(IsNumber(" \t\n+12 \r", 12.0));
+    EXPECT_TRUE(IsNumber("-1.5e+2", -150.0));
+
+    // Malformed numbers
+    EXPECT_TRUE(IsNotNumber(""));
+    EXPECT_TRUE(IsNotNumber("   "));
+    EXPECT_TRUE(IsNotNumber("-"));
+    EXPECT_TRUE(IsNotNumber("."));
+    EXPECT_TRUE(IsNotNumber("0x"));
+    EXPECT_TRUE(IsNotNumber("0x.p1"));
+    EXPECT_TRUE(IsNotNumber("1e"));
+    EXPECT_TRUE(IsNotNumber("1e+"));
+    EXPECT_TRUE(IsNotNumber("0x1p"));
+    EXPECT_TRUE(IsNotNumber("1.2.3"));
+    EXPECT_TRUE(IsNotNumber("1 2"));
+    EXPECT_TRUE(IsNotNumber("--1"));
+    EXPECT_TRUE(IsNotNumber("12a"));
+    EXPECT_TRUE(IsNotNumber("0x1g"));
+    EXPECT_TRUE(IsNotNumber("inf"));
+    EXPECT_TRUE(IsNotNumber("nan"));
+    EXPECT_TRUE(IsNotNumber(std::string("1\0", 2)));
+}
+
+TEST_CASE(number4)
+{
+    // Random decimal strings are converted the same as strtod
+    std::mt19937_64 rng(0x5EED);
+    char buffer[64];
+    for (int i = 0; i < 100000; ++i)
+    {
+        auto r = rng();
+        int digits = 1 + r % 25;
+        int exp = static_cast<int>((r >> 8) % 700) - 350;
+        auto len = 0;
+        for (int d = 0; d < digits; ++d)
+        {
+            buffer[len++] = '0' + rng() % 10;
+            if (d == 0 && digits > 1 && (r >> 20) % 2)
+                buffer[len++] = '.';
+        }
+        len += snprintf(buffer + len, sizeof(buffer) - len, "e%d", exp);
+
+        double expect = strtod(buffer, nullptr);
+        if (!IsNumber(buffer, expect))
+        {
+            EXPECT_TRUE(IsNumber(buffer, expect));
+            break;
+        }
+    }
+}
+
+TEST_CASE(number5)
+{
+    double num = 0.0;
+    EXPECT_TRUE(luna::StringToInteger("ff", 2, 16, &num) && num == 255.0);
+    EXPECT_TRUE(luna::StringToInteger(" -101 ", 6, 2, &num) && num == -5.0);
+    EXPECT_TRUE(luna::StringToInteger("zz", 2, 36, &num) && num == 1295.0);
+    EXPECT_TRUE(!luna::StringToInteger("12", 2, 2, &num));
+    EXPECT_TRUE(!luna::StringToInteger("", 0, 10, &num));
+    EXPECT_TRUE(!luna::StringToInteger("+1", 2, 10, &num));
+
+    // Numbers of source code and tonumber use the same conversion
+    ScriptRunner runner;
+    runner.Run(R"(
+        a = 0x1p4 + 1e2 + .5
+        b = tonumber("  0x10  ")
+        c = tonumber("1e")
+        d = tonumber("0x")
+        e = tonumber("10", 16)
+        f = tonumber("z", 36)
+        g = tonumber("8", 8)
+        h = tonumber(" 1e-3 ")
+    )");
+    EXPECT_TRUE(runner.GetNumber("a") == 116.5);
+    EXPECT_TRUE(runner.GetNumber("b") == 16.0);
+    EXPECT_TRUE(runner.GetGlobal("c").type_ == luna::ValueT_Nil);
+    EXPECT_TRUE(runner.GetGlobal("d").type_ == luna::ValueT_Nil);
+    EXPECT_TRUE(runner.GetNumber("e") == 16.0);
+    EXPECT_TRUE(runner.GetNumber("f") == 35.0);
+    EXPECT_TRUE(runner.GetGlobal("g").type_ == luna::ValueT_Nil);
+    EXPECT_TRUE(runner.GetNumber("h") == 0.001);
+
+    EXPECT_EXCEPTION(luna::LexException, {
+        runner.Run("x = 1e");
+    });
+    EXPECT_EXCEPTION(luna::LexException, {
+        runner.Run("x = 0x");
+    });
+}
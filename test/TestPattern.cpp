@@ -0,0 +1,127 @@
+#include "UnitTest.h"
+#include "TestCommon.h"
+#include "../src/Pattern.h"
+#include <string>
+
+namespace
+{
+    // Find 'pattern' in 'src', return the match or "nil"
+    std::string FindMatch(const std::string &src, const std::string &pattern)
+    {
+        luna::Pattern p(pattern.c_str(), pattern.size());
+        luna::PatternMatcher matcher(&p, src.c_str(), src.size());
+
+        const char *start = nullptr;
+        auto end = matcher.Find(src.c_str(), &start);
+        if (!end)
+            return "nil";
+        return std::string(start, end);
+    }
+
+    // Capture 'i' of the first match of 'pattern' in 'src'
+    std::string FindCapture(const std::string &src,
+                            const std::string &pattern, int i)
+    {
+        luna::Pattern p(pattern.c_str(), pattern.size());
+        luna::PatternMatcher matcher(&p, src.c_str(), src.size());
+
+        const char *start = nullptr;
+        auto end = matcher.Find(src.c_str(), &start);
+        if (!end)
+            return "nil";
+
+        const char *str = nullptr;
+        std::size_t len = 0;
+        if (!matcher.GetCapture(i, start, end, &str, &len))
+            return std::to_string(str - src.c_str() + 1);
+        return std::string(str, len);
+    }
+} // namespace
+
+TEST_CASE(pattern1)
+{
+    EXPECT_TRUE(FindMatch("hello world", "o w") == "o w");
+    EXPECT_TRUE(FindMatch("hello world", "%a+") == "hello");
+    EXPECT_TRUE(FindMatch("hello world", "^world") == "nil");
+    EXPECT_TRUE(FindMatch("hello world", "world$") == "world");
+    EXPECT_TRUE(FindMatch("hello world", "l+") == "ll");
+    EXPECT_TRUE(FindMatch("hello world", "l-o") == "llo");
+    EXPECT_TRUE(FindMatch("hello world", "[^%s]*$") == "world");
+    EXPECT_TRUE(FindMatch("a]b]c", "[]b]+") == "]b]");
+    EXPECT_TRUE(FindMatch("f(a(b)c)d", "%b()") == "(a(b)c)");
+    EXPECT_TRUE(FindMatch("THE (quick) fox", "%f[%a]%a+") == "THE");
+    EXPECT_TRUE(FindMatch("abcabc", "(abc)%1") == "abcabc");
+    EXPECT_TRUE(FindMatch("", "") == "");
+    EXPECT_TRUE(FindMatch("abc", "x*") == "");
+}
+
+TEST_CASE(pattern2)
+{
+    EXPECT_TRUE(FindCapture("key = value", "(%w+)%s*=%s*(%w+)", 0) == "key");
+    EXPECT_TRUE(FindCapture("key = value", "(%w+)%s*=%s*(%w+)", 1) == "value");
+    EXPECT_TRUE(FindCapture("hello", "()ll()", 0) == "3");
+    EXPECT_TRUE(FindCapture("hello", "()ll()", 1) == "5");
+    EXPECT_TRUE(FindCapture("  trim  ", "^%s*(.-)%s*$", 0) == "trim");
+    EXPECT_TRUE(FindCapture("hello", "l+", 0) == "ll");
+}
+
+TEST_CASE(pattern3)
+{
+    EXPECT_EXCEPTION(luna::PatternError, {
+        luna::Pattern p("(a", 2);
+    });
+
+    EXPECT_EXCEPTION(luna::PatternError, {
+        luna::Pattern p("a)", 2);
+    });
+
+    EXPECT_EXCEPTION(luna::PatternError, {
+        luna::Pattern p("[a", 2);
+    });
+
+    EXPECT_EXCEPTION(luna::PatternError, {
+        luna::Pattern p("a%", 2);
+    });
+
+    EXPECT_EXCEPTION(luna::PatternError, {
+        luna::Pattern p("%b(", 3);
+    });
+
+    EXPECT_EXCEPTION(luna::PatternError, {
+        luna::Pattern p("(a)%2", 5);
+    });
+
+    EXPECT_EXCEPTION(luna::PatternError, {
+        luna::Pattern p("%f%a", 4);
+    });
+}
+
+TEST_CASE(pattern4)
+{
+    luna::PatternCache cache(2);
+    auto p1 = MakeString("%a+");
+    auto p2 = MakeString("%d+");
+    auto p3 = MakeString("%s+");
+
+    auto c1 = cache.GetPattern(p1.get());
+    EXPECT_TRUE(cache.GetPattern(p1.get()) == c1);
+
+    auto c2 = cache.GetPattern(p2.get());
+    EXPECT_TRUE(c2 != c1);
+
+    // 'p1' is more recently used than 'p2', so 'p2' is evicted
+    EXPECT_TRUE(cache.GetPattern(p1.get()) == c1);
+    cache.GetPattern(p3.get());
+    EXPECT_TRUE(cache.GetPattern(p1.get()) == c1);
+    EXPECT_TRUE(cache.GetPattern(p2.get()) != c2);
+
+    // Evicted pattern is still alive while it is in use
+    const char *src = "123";
+    luna::PatternMatcher matcher(c2.get(), src, 3);
+    EXPECT_TRUE(matcher.Match(src) == src + 3);
+
+    auto bad = MakeString("(");
+    EXPECT_EXCEPTION(luna::PatternError, {
+        cache.GetPattern(bad.get());
+    });
+}
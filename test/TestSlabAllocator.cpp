@@ -0,0 +1,41 @@
+#include "UnitTest.h"
+#include "../src/SlabAllocator.h"
+#include <stdint.h>
+#include <set>
+#include <vector>
+
+TEST_CASE(slab1)
+{
+    luna::SlabAllocator slab(40);
+    EXPECT_TRUE(slab.GetBlockSize() == 48);
+
+    // Blocks are aligned and not overlapped
+    std::vector<void *> blocks;
+    std::set<void *> unique;
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto p = slab.Alloc();
+        EXPECT_TRUE(reinterpret_cast<uintptr_t>(p) % 16 == 0);
+        blocks.push_back(p);
+        unique.insert(p);
+    }
+    EXPECT_TRUE(unique.size() == blocks.size());
+    auto slab_count = slab.GetSlabCount();
+    EXPECT_TRUE(slab_count > 1);
+
+    // Freed block is reused
+    auto p = blocks.back();
+    slab.Free(p);
+    EXPECT_TRUE(slab.Alloc() == p);
+
+    // Empty slabs are released, except the one kept for reuse
+    for (auto b : blocks)
+        slab.Free(b);
+    EXPECT_TRUE(slab.GetSlabCount() == 1);
+
+    for (int i = 0; i < 1000; ++i)
+        blocks[i] = slab.Alloc();
+    EXPECT_TRUE(slab.GetSlabCount() == slab_count);
+    for (auto b : blocks)
+        slab.Free(b);
+}
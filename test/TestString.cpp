@@ -1,65 +1,70 @@
 #include "UnitTest.h"
+#include "TestCommon.h"
 #include "../src/String.h"
 #include "../src/StringPool.h"
+#include "../src/State.h"
+#include "../src/Table.h"
+#include <string>
+#include <vector>
 
 TEST_CASE(string1)
 {
-    luna::String str1("abc");
-    luna::String str2("abc");
-
-    EXPECT_TRUE(str1 == str2);
-    EXPECT_TRUE(str1 <= str2);
-    EXPECT_TRUE(str1 >= str2);
-    EXPECT_TRUE(str1.GetHash() == str2.GetHash());
-    EXPECT_TRUE(str1.GetLength() == str2.GetLength());
-    EXPECT_TRUE(str1.GetStdString() == str2.GetStdString());
-
-    str1.SetValue("abcdefghijklmn");
-    str2.SetValue("abcdefghijklmnopqrst");
-    EXPECT_TRUE(str1 != str2);
-    EXPECT_TRUE(str1 < str2);
-    EXPECT_TRUE(str2 > str1);
-    EXPECT_TRUE(str1.GetLength() < str2.GetLength());
-    EXPECT_TRUE(str1.GetStdString() != str2.GetStdString());
-
-    str1.SetValue("abc");
-    str2.SetValue("def");
-    EXPECT_TRUE(str1 != str2);
-    EXPECT_TRUE(str1 < str2);
-    EXPECT_TRUE(str2 > str1);
-    EXPECT_TRUE(str1.GetLength() == str2.GetLength());
-    EXPECT_TRUE(str1.GetStdString() != str2.GetStdString());
+    auto str1 = MakeString("abc");
+    auto str2 = MakeString("abc");
+
+    EXPECT_TRUE(*str1 == *str2);
+    EXPECT_TRUE(*str1 <= *str2);
+    EXPECT_TRUE(*str1 >= *str2);
+    EXPECT_TRUE(str1->GetHash() == str2->GetHash());
+    EXPECT_TRUE(str1->GetLength() == str2->GetLength());
+    EXPECT_TRUE(str1->GetStdString() == str2->GetStdString());
+
+    str1 = MakeString("abcdefghijklmn");
+    str2 = MakeString("abcdefghijklmnopqrst");
+    EXPECT_TRUE(*str1 != *str2);
+    EXPECT_TRUE(*str1 < *str2);
+    EXPECT_TRUE(*str2 > *str1);
+    EXPECT_TRUE(str1->GetLength() < str2->GetLength());
+    EXPECT_TRUE(str1->GetStdString() != str2->GetStdString());
+
+    str1 = MakeString("abc");
+    str2 = MakeString("def");
+    EXPECT_TRUE(*str1 != *str2);
+    EXPECT_TRUE(*str1 < *str2);
+    EXPECT_TRUE(*str2 > *str1);
+    EXPECT_TRUE(str1->GetLength() == str2->GetLength());
+    EXPECT_TRUE(str1->GetStdString() != str2->GetStdString());
 }
 
 TEST_CASE(string2)
 {
-    luna::String str1("abc");
-    luna::String str2("def");
-    luna::String str3("abcdefghijklmn");
-    luna::String str4("abcdefghijklmnopqrst");
+    auto str1 = MakeString("abc");
+    auto str2 = MakeString("def");
+    auto str3 = MakeString("abcdefghijklmn");
+    auto str4 = MakeString("abcdefghijklmnopqrst");
     luna::StringPool pool;
 
-    pool.AddString(&str1);
-    pool.AddString(&str2);
-    pool.AddString(&str3);
-    pool.AddString(&str4);
+    pool.AddString(str1.get());
+    pool.AddString(str2.get());
+    pool.AddString(str3.get());
+    pool.AddString(str4.get());
 
     auto s1 = pool.GetString("abc");
     auto s2 = pool.GetString("def");
     auto s3 = pool.GetString("abcdefghijklmn");
     auto s4 = pool.GetString("abcdefghijklmnopqrst");
-    EXPECT_TRUE(s1 == &str1);
-    EXPECT_TRUE(s2 == &str2);
-    EXPECT_TRUE(s3 == &str3);
-    EXPECT_TRUE(s4 == &str4);
+    EXPECT_TRUE(s1 == str1.get());
+    EXPECT_TRUE(s2 == str2.get());
+    EXPECT_TRUE(s3 == str3.get());
+    EXPECT_TRUE(s4 == str4.get());
 
     auto s5 = pool.GetString("abcdef");
     EXPECT_TRUE(!s5);
 
-    pool.DeleteString(&str1);
-    pool.DeleteString(&str2);
-    pool.DeleteString(&str3);
-    pool.DeleteString(&str4);
+    pool.DeleteString(str1.get());
+    pool.DeleteString(str2.get());
+    pool.DeleteString(str3.get());
+    pool.DeleteString(str4.get());
 
     s1 = pool.GetString("abc");
     s2 = pool.GetString("def");
@@ -70,3 +75,162 @@ TEST_CASE(string2)
     EXPECT_TRUE(!s3);
     EXPECT_TRUE(!s4);
 }
+
+TEST_CASE(string3)
+{
+    // Embedded zeros are part of the string
+    std::string a("abc\0def", 7);
+    std::string b("abc\0xyz", 7);
+    auto str1 = MakeString(a);
+    auto str2 = MakeString(b);
+    EXPECT_TRUE(str1->GetLength() == 7);
+    EXPECT_TRUE(*str1 != *str2);
+    EXPECT_TRUE(str1->GetHash() != str2->GetHash());
+
+    luna::StringPool pool;
+    pool.AddString(str1.get());
+    EXPECT_TRUE(pool.GetString(a) == str1.get());
+    EXPECT_TRUE(!pool.GetString(b));
+    EXPECT_TRUE(!pool.GetString("abc"));
+    pool.DeleteString(str1.get());
+
+    // Strings with the same prefix and different length
+    std::string zeros(16, '\0');
+    for (std::size_t i = 1; i < zeros.size(); ++i)
+    {
+        auto h1 = luna::String::Hash(zeros.c_str(), i - 1, 0);
+        auto h2 = luna::String::Hash(zeros.c_str(), i, 0);
+        EXPECT_TRUE(h1 != h2);
+    }
+
+    // Seed changes hash
+    auto h1 = luna::String::Hash("abcdef", 6, 1);
+    auto h2 = luna::String::Hash("abcdef", 6, 2);
+    EXPECT_TRUE(h1 != h2);
+
+    // Long strings which differ at head or tail
+    std::string l1(1024 * 1024, 'x');
+    std::string l2 = l1;
+    std::string l3 = l1;
+    l2[0] = 'y';
+    l3[l3.size() - 1] = 'y';
+    auto lh1 = luna::String::Hash(l1.c_str(), l1.size(), 0);
+    auto lh2 = luna::String::Hash(l2.c_str(), l2.size(), 0);
+    auto lh3 = luna::String::Hash(l3.c_str(), l3.size(), 0);
+    EXPECT_TRUE(lh1 != lh2);
+    EXPECT_TRUE(lh1 != lh3);
+    EXPECT_TRUE(lh2 != lh3);
+
+    // Numbered keys like "key1", "key2", ... should spread well
+    const std::size_t kCount = 10000;
+    const std::size_t kBuckets = 16384;
+    std::vector<int> buckets(kBuckets);
+    std::size_t collisions = 0;
+    for (std::size_t i = 0; i < kCount; ++i)
+    {
+        auto key = "key" + std::to_string(i);
+        auto h = luna::String::Hash(key.c_str(), key.size(), 0);
+        if (buckets[h & (kBuckets - 1)]++)
+            ++collisions;
+    }
+    // Expectation of random hash is about 2400
+    EXPECT_TRUE(collisions < 3000);
+}
+
+TEST_CASE(string4)
+{
+    luna::State state;
+
+    // Short strings are interned
+    auto s1 = state.GetString("short string");
+    auto s2 = state.GetString("short string");
+    EXPECT_TRUE(s1 == s2);
+    EXPECT_TRUE(!s1->IsLong());
+
+    // Long strings are not interned, but equal by content
+    std::string str(100, 'x');
+    auto l1 = state.GetString(str);
+    auto l2 = state.GetString(str);
+    EXPECT_TRUE(l1 != l2);
+    EXPECT_TRUE(l1->IsLong());
+    EXPECT_TRUE(!l1->IsInterned());
+    EXPECT_TRUE(*l1 == *l2);
+
+    luna::Value v1;
+    luna::Value v2;
+    v1.type_ = luna::ValueT_String;
+    v1.str_ = l1;
+    v2.type_ = luna::ValueT_String;
+    v2.str_ = l2;
+    EXPECT_TRUE(v1 == v2);
+    EXPECT_TRUE(std::hash<luna::Value>()(v1) == std::hash<luna::Value>()(v2));
+
+    luna::Table t;
+    luna::Value value;
+    value.SetBool(true);
+    t.SetValue(v1, value);
+    EXPECT_TRUE(t.GetValue(v2).type_ == luna::ValueT_Bool);
+
+    // Long names of source are interned
+    auto n1 = state.InternString(str.c_str(), str.size());
+    auto n2 = state.InternString(str.c_str(), str.size());
+    EXPECT_TRUE(n1 == n2);
+    EXPECT_TRUE(n1->IsInterned());
+    EXPECT_TRUE(n1->GetHash() == l1->GetHash());
+}
+
+TEST_CASE(string5)
+{
+    luna::StringPool pool;
+    std::vector<std::unique_ptr<luna::String>> strings;
+
+    // Add strings until pool is rehashing
+    while (!pool.IsRehashing())
+    {
+        strings.push_back(MakeString("s" + std::to_string(strings.size())));
+        pool.AddString(strings.back().get());
+    }
+
+    // Strings are found in old and new buckets while rehashing
+    for (std::size_t i = 0; i < strings.size(); ++i)
+        EXPECT_TRUE(pool.GetString("s" + std::to_string(i)) == strings[i].get());
+
+    // Delete strings while rehashing
+    for (std::size_t i = 0; i < strings.size(); i += 2)
+        pool.DeleteString(strings[i].get());
+    EXPECT_TRUE(pool.GetSize() == strings.size() / 2);
+
+    for (std::size_t i = 0; i < 10000; ++i)
+    {
+        strings.push_back(MakeString("s" + std::to_string(strings.size())));
+        pool.AddString(strings.back().get());
+    }
+
+    for (std::size_t i = 0; i < strings.size(); ++i)
+    {
+        auto s = pool.GetString("s" + std::to_string(i));
+        EXPECT_TRUE(s == (strings[i]->IsInterned() ? strings[i].get() : nullptr));
+    }
+
+    for (const auto &s : strings)
+        pool.DeleteString(s.get());
+    EXPECT_TRUE(pool.GetSize() == 0);
+}
+
+TEST_CASE(string6)
+{
+    // Every byte of long strings changes the hash
+    std::string base(200, 'a');
+    auto hash = luna::String::Hash(base.c_str(), base.size(), 0);
+    for (std::size_t i = 0; i < base.size(); ++i)
+    {
+        std::string str = base;
+        str[i] = 'b';
+        EXPECT_TRUE(luna::String::Hash(str.c_str(), str.size(), 0) != hash);
+    }
+
+    std::string str1 = std::string(100, 'x') + "1" + std::string(99, 'x');
+    std::string str2 = std::string(100, 'x') + "2" + std::string(99, 'x');
+    EXPECT_TRUE(luna::String::Hash(str1.c_str(), str1.size(), 7) !=
+                luna::String::Hash(str2.c_str(), str2.size(), 7));
+}
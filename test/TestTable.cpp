@@ -1,6 +1,8 @@
 #include "UnitTest.h"
+#include "TestCommon.h"
 #include "../src/Table.h"
 #include "../src/String.h"
+#include <vector>
 
 TEST_CASE(table1)
 {
@@ -44,33 +46,33 @@ TEST_CASE(table1)
 TEST_CASE(table2)
 {
     luna::Table t;
-    luna::String key_str("key");
-    luna::String value_str("value");
+    auto key_str = MakeString("key");
+    auto value_str = MakeString("value");
 
     luna::Value key;
     luna::Value value;
 
     key.type_ = luna::ValueT_Obj;
-    key.obj_ = &key_str;
+    key.obj_ = key_str.get();
     value.type_ = luna::ValueT_Obj;
-    value.obj_ = &value_str;
+    value.obj_ = value_str.get();
 
     t.SetValue(key, value);
     value = t.GetValue(key);
 
     EXPECT_TRUE(value.type_ == luna::ValueT_Obj);
-    EXPECT_TRUE(value.obj_ == &value_str);
+    EXPECT_TRUE(value.obj_ == value_str.get());
 
     luna::Value key_not_existed;
     key_not_existed.type_ = luna::ValueT_Obj;
-    key_not_existed.obj_ = &value_str;
+    key_not_existed.obj_ = value_str.get();
 
     value = t.GetValue(key_not_existed);
     EXPECT_TRUE(value.type_ == luna::ValueT_Nil);
 
     EXPECT_TRUE(t.FirstKeyValue(key, value));
-    EXPECT_TRUE(key.obj_ == &key_str);
-    EXPECT_TRUE(value.obj_ == &value_str);
+    EXPECT_TRUE(key.obj_ == key_str.get());
+    EXPECT_TRUE(value.obj_ == value_str.get());
 
     EXPECT_TRUE(!t.NextKeyValue(key, key, value));
 }
@@ -101,3 +103,175 @@ TEST_CASE(table3)
     value = t.GetValue(nil);
     EXPECT_TRUE(value.type_ == luna::ValueT_Nil);
 }
+
+TEST_CASE(table4)
+{
+    luna::Table t;
+    luna::Value value;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        value.num_ = i + 1;
+        value.type_ = luna::ValueT_Number;
+        EXPECT_TRUE(t.SetArrayValue(i + 1, value));
+    }
+
+    // All numbers, array part is packed
+    EXPECT_TRUE(t.GetNumberArray() != nullptr);
+    EXPECT_TRUE(t.GetNumberArray()[3] == 4.0);
+
+    luna::Value key;
+    key.num_ = 2;
+    key.type_ = luna::ValueT_Number;
+    value.SetBool(true);
+    t.SetValue(key, value);
+
+    // Array part falls back to boxed values
+    EXPECT_TRUE(t.GetNumberArray() == nullptr);
+    EXPECT_TRUE(t.ArraySize() == 4);
+
+    value = t.GetValue(key);
+    EXPECT_TRUE(value.type_ == luna::ValueT_Bool);
+
+    key.num_ = 4;
+    value = t.GetValue(key);
+    EXPECT_TRUE(value.type_ == luna::ValueT_Number);
+    EXPECT_TRUE(value.num_ == 4.0);
+}
+
+TEST_CASE(table5)
+{
+    luna::GC gc;
+    std::vector<luna::Table *> roots;
+    auto root = [&](luna::GCObjectVisitor *v) {
+        for (auto t : roots)
+            t->Accept(v);
+    };
+    gc.SetRootTraveller(root, root);
+
+    auto NewTable = [&]() {
+        luna::Value value;
+        value.table_ = gc.NewTable();
+        value.type_ = luna::ValueT_Table;
+        return value;
+    };
+
+    luna::Value weak_key = NewTable();
+    luna::Value weak_value = NewTable();
+    luna::Value alive = NewTable();
+    weak_key.table_->SetWeakMode(luna::WeakMode_Key);
+    weak_value.table_->SetWeakMode(luna::WeakMode_Value);
+    roots.push_back(weak_key.table_);
+    roots.push_back(weak_value.table_);
+    roots.push_back(alive.table_);
+
+    // Value of alive key is kept, entry of dead key is removed
+    luna::Value ephemeron = NewTable();
+    weak_key.table_->SetValue(alive, ephemeron);
+    weak_key.table_->SetValue(NewTable(), alive);
+
+    // Dead values are removed
+    weak_value.table_->SetArrayValue(1, NewTable());
+    weak_value.table_->SetArrayValue(2, alive);
+    weak_value.table_->SetValue(alive, NewTable());
+
+    // Alloc enough objects to run GC
+    for (int i = 0; i < 1024; ++i)
+        gc.NewTable();
+    gc.CheckGC();
+
+    luna::Value key;
+    luna::Value value;
+    EXPECT_TRUE(weak_key.table_->FirstKeyValue(key, value));
+    EXPECT_TRUE(key == alive && value == ephemeron);
+    EXPECT_TRUE(!weak_key.table_->NextKeyValue(key, key, value));
+
+    EXPECT_TRUE(weak_value.table_->ArraySize() == 2);
+    EXPECT_TRUE(weak_value.table_->GetValue(alive).type_ == luna::ValueT_Nil);
+
+    key.num_ = 1;
+    key.type_ = luna::ValueT_Number;
+    EXPECT_TRUE(weak_value.table_->GetValue(key).type_ == luna::ValueT_Nil);
+    key.num_ = 2;
+    EXPECT_TRUE(weak_value.table_->GetValue(key) == alive);
+}
+
+TEST_CASE(table6)
+{
+    luna::Table t;
+    luna::Value key;
+    luna::Value value;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        key.num_ = i + 1;
+        key.type_ = luna::ValueT_Number;
+        value.num_ = i;
+        value.type_ = luna::ValueT_Number;
+        t.SetValue(key, value);
+
+        // Not integer keys are in hash part
+        key.num_ = i + 0.5;
+        t.SetValue(key, value);
+    }
+
+    t.Freeze();
+    EXPECT_TRUE(t.IsFrozen());
+    EXPECT_TRUE(t.ArraySize() == 1000);
+
+    bool all_found = true;
+    for (int i = 0; i < 1000; ++i)
+    {
+        key.num_ = i + 0.5;
+        key.type_ = luna::ValueT_Number;
+        value = t.GetValue(key);
+        all_found = all_found && value.type_ == luna::ValueT_Number &&
+                    value.num_ == i;
+    }
+    EXPECT_TRUE(all_found);
+
+    key.num_ = 1000.5;
+    EXPECT_TRUE(t.GetValue(key).type_ == luna::ValueT_Nil);
+
+    // Frozen table can not be modified
+    value.SetBool(true);
+    t.SetValue(key, value);
+    EXPECT_TRUE(t.GetValue(key).type_ == luna::ValueT_Nil);
+    EXPECT_TRUE(!t.SetArrayValue(1, value));
+
+    // Iterate all key-value pairs
+    int count = 0;
+    bool has_next = t.FirstKeyValue(key, value);
+    while (has_next)
+    {
+        ++count;
+        has_next = t.NextKeyValue(key, key, value);
+    }
+    EXPECT_TRUE(count == 2000);
+}
+
+TEST_CASE(table7)
+{
+    luna::Table mt;
+    auto index_name = MakeString("__index");
+    EXPECT_TRUE(!mt.IsMetaEventAbsent(luna::MetaEvent_Index));
+
+    // Absence of metamethod is cached
+    auto method = mt.GetMetamethod(luna::MetaEvent_Index, index_name.get());
+    EXPECT_TRUE(method.type_ == luna::ValueT_Nil);
+    EXPECT_TRUE(mt.IsMetaEventAbsent(luna::MetaEvent_Index));
+    EXPECT_TRUE(!mt.IsMetaEventAbsent(luna::MetaEvent_Call));
+
+    // Writing metatable invalidates the cache
+    luna::Value key;
+    key.type_ = luna::ValueT_String;
+    key.str_ = index_name.get();
+    luna::Value value;
+    value.SetBool(true);
+    mt.SetValue(key, value);
+    EXPECT_TRUE(!mt.IsMetaEventAbsent(luna::MetaEvent_Index));
+
+    method = mt.GetMetamethod(luna::MetaEvent_Index, index_name.get());
+    EXPECT_TRUE(method.type_ == luna::ValueT_Bool);
+    EXPECT_TRUE(!mt.IsMetaEventAbsent(luna::MetaEvent_Index));
+}